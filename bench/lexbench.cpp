@@ -0,0 +1,95 @@
+/** \file lexbench.cpp
+
+    Lexing throughput: a generated source in the style of scripts/bigproc.sp (many small
+    procedures and their calls) or the given files are lexed repeatedly and the best
+    time is reported in MB and tokens per second.
+
+    usage: lexbench [--size megabytes] [--repeat n] [files...]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "lexer.hpp"
+
+using statpascal::TLexer;
+using statpascal::TToken;
+
+namespace {
+
+struct TOptions {
+    std::size_t megabytes = 32, repeat = 5;
+    std::vector<std::string> files;
+};
+
+TOptions parseOptions (int argc, char **argv) {
+    TOptions options;
+    for (int i = 1; i < argc; ++i)
+        if (!std::strcmp (argv [i], "--size") && i + 1 < argc)
+            options.megabytes = std::stoul (argv [++i]);
+        else if (!std::strcmp (argv [i], "--repeat") && i + 1 < argc)
+            options.repeat = std::stoul (argv [++i]);
+        else
+            options.files.push_back (argv [i]);
+    return options;
+}
+
+std::string createSource (const std::string &fn, std::size_t bytes) {
+    std::ofstream f (fn);
+    f << "program bigproc;\nvar i: integer;\n";
+    std::size_t n = 0;
+    for (; static_cast<std::size_t> (f.tellp ()) < bytes / 16 * 15; ++n)
+        f << "procedure p" << n << ";\n(* generated *)\nbegin\n    i := i + " << n << " * $10 - 'x'' '#65;\n    if i >= 3.5e2 then\n        Writeln ('Large: ', i)\nend;\n";
+    f << "begin\n    i := 0;\n";
+    for (std::size_t i = 0; i < n; ++i)
+        f << "    p" << i << ";\n";
+    f << "    writeln (i)\nend.\n";
+    return fn;
+}
+
+struct TResult {
+    double seconds;
+    std::size_t tokens;
+};
+
+TResult lexFile (const std::string &fn) {
+    const auto start = std::chrono::steady_clock::now ();
+    TLexer lexer;
+    lexer.setFilename (fn);
+    std::size_t tokens = 0;
+    for (; lexer.getToken () != TToken::Terminator; ++tokens)
+        lexer.getNextToken ();
+    return {std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count (), tokens};
+}
+
+}
+
+int main (int argc, char **argv) {
+    TOptions options = parseOptions (argc, argv);
+    std::string generated;
+    if (options.files.empty ()) {
+        generated = "/tmp/lexbench-" + std::to_string (getpid ()) + ".sp";
+        options.files.push_back (createSource (generated, options.megabytes << 20));
+    }
+    for (const std::string &fn: options.files) {
+        std::ifstream f (fn, std::ios::binary | std::ios::ate);
+        const double megabytes = static_cast<double> (f.tellg ()) / (1 << 20);
+        TResult best {1e30, 0};
+        for (std::size_t i = 0; i < options.repeat; ++i) {
+            const TResult result = lexFile (fn);
+            if (result.seconds < best.seconds)
+                best = result;
+        }
+        printf ("%s: %.1f MB, %zu tokens, %.3f s, %.1f MB/s, %.2f Mtokens/s\n", fn.c_str (), megabytes, best.tokens, best.seconds,
+                megabytes / best.seconds, best.tokens / best.seconds / 1e6);
+    }
+    if (!generated.empty ())
+        std::remove (generated.c_str ());
+}
@@ -0,0 +1,134 @@
+/** \file refbench.cpp
+
+    Benchmark of TAnyValue reference counting in the style of tests/other/threadtest.sp:
+    a number of threads copy and release strings which are either private to the thread,
+    shared by all threads or created by one thread and released by another. The local
+    workload is run with plain and thread safe reference counting.
+
+    usage: refbench [--threads n] [--iterations n]
+*/
+
+#include <barrier>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "anyvalue.hpp"
+
+using statpascal::TAnyValue;
+
+namespace {
+
+struct TOptions {
+    std::size_t threads = 16, iterations = 2000000;
+};
+
+std::atomic<std::size_t> destroyed;
+
+// payload counting its destructions to verify that every value is released exactly once
+class TPayload {
+public:
+    TPayload (const std::string &s): s (s), live (true) {}
+    TPayload (const TPayload &other): s (other.s), live (other.live) {}
+    TPayload (TPayload &&other): s (std::move (other.s)), live (other.live) { other.live = false; }
+    ~TPayload () { if (live) ++destroyed; }
+private:
+    std::string s;
+    bool live;
+};
+
+volatile std::size_t sink;
+
+template<typename F> double runThreads (std::size_t threads, F f) {
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now ();
+    for (std::size_t t = 0; t < threads; ++t)
+        workers.emplace_back (f, t);
+    for (std::thread &worker: workers)
+        worker.join ();
+    TAnyValue::processQueuedReleases ();
+    return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+}
+
+void copyLoop (const TAnyValue &v, std::size_t iterations) {
+    for (std::size_t i = 0; i < iterations; ++i) {
+        TAnyValue copy (v);
+        sink = copy.hasValue ();
+    }
+}
+
+double benchLocal (const TOptions &options) {
+    return runThreads (options.threads, [&options] (std::size_t) {
+        TAnyValue v (std::string ("thread local string"));
+        copyLoop (v, options.iterations);
+    });
+}
+
+double benchShared (const TOptions &options) {
+    TAnyValue v (std::string ("string shared by all threads"));
+    return runThreads (options.threads, [&options, &v] (std::size_t) {
+        copyLoop (v, options.iterations);
+    });
+}
+
+// every thread creates values and releases those created by its neighbour
+
+double benchHandoff (const TOptions &options, bool &valid) {
+    const std::size_t n = options.threads, count = options.iterations / 16;
+    std::vector<std::vector<TAnyValue>> values (n, std::vector<TAnyValue> (count));
+    std::barrier sync (n);
+    destroyed = 0;
+    const double ns = runThreads (n, [&] (std::size_t t) {
+        for (TAnyValue &v: values [t])
+            v = TPayload ("handed over to another thread");
+        sync.arrive_and_wait ();
+        for (TAnyValue &v: values [(t + 1) % n])
+            v = TAnyValue ();
+        sync.arrive_and_wait ();
+        TAnyValue::processQueuedReleases ();
+    });
+    valid = destroyed == n * count;
+    return ns;
+}
+
+void report (bool &first, const std::string &name, const std::string &mode, const TOptions &options, std::size_t ops, double ns, bool valid = true) {
+    std::cout << (first ? "  " : ", ")
+              << "{\"name\": \"" << name << "\", \"mode\": \"" << mode << "\", \"threads\": " << options.threads
+              << ", \"operations\": " << ops << ", \"ms\": " << ns / 1e6 << ", \"ns_per_op\": " << ns / ops
+              << ", \"valid\": " << (valid ? "true" : "false") << "}" << std::endl;
+    first = false;
+}
+
+}
+
+int main (int argc, char **argv) {
+    TOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv [i];
+        if (arg == "--threads")
+            options.threads = std::stoull (argv [i + 1]);
+        else if (arg == "--iterations")
+            options.iterations = std::stoull (argv [i + 1]);
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // each copy loop iteration performs one increment and one decrement
+    const std::size_t ops = 2 * options.threads * options.iterations;
+    bool first = true, valid;
+    std::cout << "{\"benchmarks\": [" << std::endl;
+    // plain reference counting is only correct for values not shared between threads
+    report (first, "local", "plain", options, ops, benchLocal (options));
+    TAnyValue::enableThreadSafety ();
+    report (first, "local", "thread-safe", options, ops, benchLocal (options));
+    report (first, "shared", "thread-safe", options, ops, benchShared (options));
+    const double ns = benchHandoff (options, valid);
+    report (first, "handoff", "thread-safe", options, 2 * options.threads * (options.iterations / 16), ns, valid);
+    std::cout << "]}" << std::endl;
+    return !valid;
+}
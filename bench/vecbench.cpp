@@ -0,0 +1,479 @@
+/** \file vecbench.cpp
+
+    Microbenchmark of the vector runtime: times the rt_* entry points against hand
+    written loops and writes the results as JSON to stdout.
+
+    Covered are the element-wise operations and comparisons (including their _first
+    and _which searches), the realvector functions, conversion, indexing, combine,
+    rev, resize, sort and the reductions. The generators (intvec, realvec, random*,
+    makevec) are not timed.
+
+    usage: vecbench [--min-size n] [--max-size n] [--budget elements] [--filter name]
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "anyvalue.hpp"
+#include "anymanager.hpp"
+#include "vectordata.hpp"
+#include "datatypes.hpp"
+#include "runtime.hpp"
+
+using statpascal::TAnyValue;
+using statpascal::TVectorData;
+using TTypeCode = statpascal::TStdType::TScalarTypeCode;
+
+extern "C" {
+TAnyValue rt_vec_add (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_sub (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_mul (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_div (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_mod (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_and (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_or (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_xor (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_shl (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_shr (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_equal (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_not_equal (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_less (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_less_equal (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_greater (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_greater_equal (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+std::int64_t rt_vec_equal_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+std::int64_t rt_vec_not_equal_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+std::int64_t rt_vec_less_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+std::int64_t rt_vec_less_equal_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+std::int64_t rt_vec_greater_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+std::int64_t rt_vec_greater_equal_first (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool);
+TAnyValue rt_vec_equal_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_not_equal_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_less_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_less_equal_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_greater_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_greater_equal_which (TAnyValue, TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vec_conv (TAnyValue, std::int64_t, std::int64_t);
+TAnyValue rt_vdbl_sqr (TAnyValue);
+TAnyValue rt_vdbl_sqrt (TAnyValue);
+TAnyValue rt_vdbl_sin (TAnyValue);
+TAnyValue rt_vdbl_cos (TAnyValue);
+TAnyValue rt_vdbl_log (TAnyValue);
+TAnyValue rt_vdbl_pow (TAnyValue, double);
+void *rt_vec_index_int (TAnyValue, std::int64_t);
+TAnyValue rt_vec_index_vint (TAnyValue, TAnyValue);
+TAnyValue rt_vec_index_vbool (TAnyValue, TAnyValue);
+TAnyValue rt_combinevec_2 (TAnyValue, TAnyValue);
+TAnyValue rt_combinevec_3 (TAnyValue, TAnyValue, TAnyValue);
+TAnyValue rt_combinevec_4 (TAnyValue, TAnyValue, TAnyValue, TAnyValue);
+TAnyValue rt_revvec (TAnyValue);
+void rt_resizevec (std::int64_t, statpascal::TRuntimeData *, std::int64_t, TAnyValue &, std::int64_t);
+TAnyValue rt_vint_sort (TAnyValue);
+TAnyValue rt_vdbl_sort (TAnyValue);
+std::int64_t rt_vint_sum (TAnyValue);
+double rt_vdbl_sum (TAnyValue);
+std::int64_t rt_vbool_count (TAnyValue);
+TAnyValue rt_vbool_which (TAnyValue);
+TAnyValue rt_vint_cumsum (TAnyValue);
+TAnyValue rt_vdbl_cumsum (TAnyValue);
+}
+
+namespace {
+
+struct TOptions {
+    std::size_t minSize = 10, maxSize = 100000000, budget = 20000000;
+    std::string filter;
+};
+
+// keeps results alive so that the baselines are not optimized away
+volatile double sink;
+
+// provides the (empty) any manager for rt_resizevec
+statpascal::TRuntimeData runtimeData;
+
+template<typename T> TAnyValue makeVector (std::size_t n, std::function<T (std::size_t)> gen) {
+    TVectorData v (sizeof (T), n, nullptr, false);
+    for (std::size_t i = 0; i < n; ++i)
+        v.get<T> (i) = gen (i);
+    return std::move (v);
+}
+
+template<typename T> const T *data (const TAnyValue &v) {
+    return &v.get<TVectorData> ().get<T> (0);
+}
+
+struct TCase {
+    std::string name, type;
+    std::size_t bytesPerElement;	// bytes read and written per element
+    std::function<void ()> runtime, baseline;
+};
+
+double measure (const std::function<void ()> &f, std::size_t reps) {
+    f ();
+    const auto start = std::chrono::steady_clock::now ();
+    for (std::size_t i = 0; i < reps; ++i)
+        f ();
+    return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count () / reps;
+}
+
+// element-wise kernels on typed vectors sharing one pair of input vectors per element type
+
+template<typename T> struct TInput {
+    std::size_t n;
+    TTypeCode tc;
+    TAnyValue a, b, zero;
+};
+
+template<typename T> TInput<T> makeInput (TTypeCode tc, std::size_t n) {
+    return {n, tc,
+            makeVector<T> (n, [] (std::size_t i) { return static_cast<T> (i % 100 + 1); }),
+            makeVector<T> (n, [] (std::size_t i) { return static_cast<T> (i % 7 + 1); }),
+            makeVector<T> (1, [] (std::size_t) { return static_cast<T> (0); })};
+}
+
+template<typename T, typename TRes, typename TOp> void addBinary (std::vector<TCase> &cases, const std::string &name, const std::string &type, const TInput<T> &in,
+                                                                  TAnyValue (*rtfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t), TOp op) {
+    const std::size_t n = in.n;
+    const TTypeCode tc = in.tc;
+    const TAnyValue a = in.a, b = in.b;
+    cases.push_back ({name, type, 2 * sizeof (T) + sizeof (TRes),
+        [=] () { TAnyValue r = rtfunc (a, b, tc, tc); },
+        [=] () {
+            const T *p = data<T> (a), *q = data<T> (b);
+            TRes *r = new TRes [n];
+            for (std::size_t i = 0; i < n; ++i)
+                r [i] = op (p [i], q [i]);
+            sink = r [n - 1];
+            delete [] r;
+        }});
+}
+
+// the scalar 0 is below all elements, so the search scans the whole vector
+
+template<typename T, typename TOp> void addFirst (std::vector<TCase> &cases, const std::string &name, const std::string &type, const TInput<T> &in,
+                                                  std::int64_t (*rtfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool), TOp op) {
+    const std::size_t n = in.n;
+    const TTypeCode tc = in.tc;
+    const TAnyValue a = in.a, zero = in.zero;
+    const bool value = !op (T (1), T (0));
+    cases.push_back ({name, type, sizeof (T),
+        [=] () { sink = rtfunc (a, zero, tc, tc, value); },
+        [=] () {
+            const T *p = data<T> (a);
+            std::size_t i = 0;
+            while (i < n && op (p [i], T (0)) != value)
+                ++i;
+            sink = i;
+        }});
+}
+
+template<typename T, typename TOp> void addWhich (std::vector<TCase> &cases, const std::string &name, const std::string &type, const TInput<T> &in,
+                                                  TAnyValue (*rtfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t), TOp op) {
+    const std::size_t n = in.n;
+    const TTypeCode tc = in.tc;
+    const TAnyValue a = in.a, b = in.b;
+    cases.push_back ({name, type, 2 * sizeof (T),
+        [=] () { TAnyValue r = rtfunc (a, b, tc, tc); },
+        [=] () {
+            const T *p = data<T> (a), *q = data<T> (b);
+            std::vector<std::int64_t> r;
+            for (std::size_t i = 0; i < n; ++i)
+                if (op (p [i], q [i]))
+                    r.push_back (i + 1);
+            sink = r.size ();
+        }});
+}
+
+template<typename T, template<typename> class TOp> void addComparison (std::vector<TCase> &cases, const std::string &name, const std::string &type, const TInput<T> &in,
+                                                                       TAnyValue (*rtfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t),
+                                                                       std::int64_t (*firstfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t, bool),
+                                                                       TAnyValue (*whichfunc) (TAnyValue, TAnyValue, std::int64_t, std::int64_t)) {
+    addBinary<T, bool> (cases, name, type, in, rtfunc, TOp<T> ());
+    addFirst<T> (cases, name + "_first", type, in, firstfunc, TOp<T> ());
+    addWhich<T> (cases, name + "_which", type, in, whichfunc, TOp<T> ());
+}
+
+template<typename T> void addArithmetic (std::vector<TCase> &cases, const std::string &type, TTypeCode tc, std::size_t n) {
+    // integer results are widened to int64 by the runtime
+    using TRes = std::conditional_t<std::is_floating_point_v<T>, T, std::int64_t>;
+    const TInput<T> in = makeInput<T> (tc, n);
+    addBinary<T, TRes> (cases, "rt_vec_add", type, in, rt_vec_add, std::plus<TRes> ());
+    addBinary<T, TRes> (cases, "rt_vec_sub", type, in, rt_vec_sub, std::minus<TRes> ());
+    addBinary<T, TRes> (cases, "rt_vec_mul", type, in, rt_vec_mul, std::multiplies<TRes> ());
+    addBinary<T, TRes> (cases, "rt_vec_div", type, in, rt_vec_div, std::divides<TRes> ());
+    addComparison<T, std::equal_to> (cases, "rt_vec_equal", type, in, rt_vec_equal, rt_vec_equal_first, rt_vec_equal_which);
+    addComparison<T, std::not_equal_to> (cases, "rt_vec_not_equal", type, in, rt_vec_not_equal, rt_vec_not_equal_first, rt_vec_not_equal_which);
+    addComparison<T, std::less> (cases, "rt_vec_less", type, in, rt_vec_less, rt_vec_less_first, rt_vec_less_which);
+    addComparison<T, std::less_equal> (cases, "rt_vec_less_equal", type, in, rt_vec_less_equal, rt_vec_less_equal_first, rt_vec_less_equal_which);
+    addComparison<T, std::greater> (cases, "rt_vec_greater", type, in, rt_vec_greater, rt_vec_greater_first, rt_vec_greater_which);
+    addComparison<T, std::greater_equal> (cases, "rt_vec_greater_equal", type, in, rt_vec_greater_equal, rt_vec_greater_equal_first, rt_vec_greater_equal_which);
+    if constexpr (!std::is_floating_point_v<T>) {
+        addBinary<T, TRes> (cases, "rt_vec_mod", type, in, rt_vec_mod, std::modulus<TRes> ());
+        addBinary<T, TRes> (cases, "rt_vec_shl", type, in, rt_vec_shl, [] (TRes x, TRes y) { return x << y; });
+        addBinary<T, TRes> (cases, "rt_vec_shr", type, in, rt_vec_shr, [] (TRes x, TRes y) { return x >> y; });
+        addBinary<T, T> (cases, "rt_vec_and", type, in, rt_vec_and, std::bit_and<T> ());
+        addBinary<T, T> (cases, "rt_vec_or", type, in, rt_vec_or, std::bit_or<T> ());
+        addBinary<T, T> (cases, "rt_vec_xor", type, in, rt_vec_xor, std::bit_xor<T> ());
+    }
+}
+
+void addUnaryReal (std::vector<TCase> &cases, const std::string &name, TAnyValue (*rtfunc) (TAnyValue), double (*f) (double), std::size_t n) {
+    TAnyValue a = makeVector<double> (n, [] (std::size_t i) { return 1.0 + i % 1000; });
+    cases.push_back ({name, "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rtfunc (a); },
+        [=] () {
+            const double *p = data<double> (a);
+            double *r = new double [n];
+            for (std::size_t i = 0; i < n; ++i)
+                r [i] = f (p [i]);
+            sink = r [n - 1];
+            delete [] r;
+        }});
+}
+
+std::vector<TCase> createCases (std::size_t n) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    std::vector<TCase> cases;
+
+    addArithmetic<std::int64_t> (cases, "s64", s64, n);
+    addArithmetic<double> (cases, "real", real, n);
+    addArithmetic<std::int32_t> (cases, "s32", s32, n);
+    addArithmetic<float> (cases, "single", single, n);
+    addArithmetic<std::int16_t> (cases, "s16", s16, n);
+    addArithmetic<std::int8_t> (cases, "s8", s8, n);
+
+    TAnyValue vint = makeVector<std::int64_t> (n, [n] (std::size_t i) { return static_cast<std::int64_t> ((i * 7919) % n); }),
+              vdbl = makeVector<double> (n, [] (std::size_t i) { return std::sin (static_cast<double> (i)); }),
+              vbool = makeVector<bool> (n, [] (std::size_t i) { return i % 3 == 0; }),
+              index = makeVector<std::int64_t> (n, [n] (std::size_t i) { return static_cast<std::int64_t> ((i * 7919) % n + 1); });
+
+    cases.push_back ({"rt_vec_conv", "s64->real", sizeof (std::int64_t) + sizeof (double),
+        [=] () { TAnyValue r = rt_vec_conv (vint, s64, real); },
+        [=] () {
+            const std::int64_t *p = data<std::int64_t> (vint);
+            double *r = new double [n];
+            for (std::size_t i = 0; i < n; ++i)
+                r [i] = p [i];
+            sink = r [n - 1];
+            delete [] r;
+        }});
+
+    addUnaryReal (cases, "rt_vdbl_sqr", rt_vdbl_sqr, [] (double x) { return x * x; }, n);
+    addUnaryReal (cases, "rt_vdbl_sqrt", rt_vdbl_sqrt, [] (double x) { return std::sqrt (x); }, n);
+    addUnaryReal (cases, "rt_vdbl_sin", rt_vdbl_sin, [] (double x) { return std::sin (x); }, n);
+    addUnaryReal (cases, "rt_vdbl_cos", rt_vdbl_cos, [] (double x) { return std::cos (x); }, n);
+    addUnaryReal (cases, "rt_vdbl_log", rt_vdbl_log, [] (double x) { return std::log (x); }, n);
+    addUnaryReal (cases, "rt_vdbl_pow", [] (TAnyValue a) { return rt_vdbl_pow (a, 1.5); }, [] (double x) { return std::pow (x, 1.5); }, n);
+
+    cases.push_back ({"rt_vec_index_int", "s64", sizeof (std::int64_t),
+        [=] () {
+            std::int64_t s = 0;
+            for (std::size_t i = 1; i <= n; ++i)
+                s += *static_cast<std::int64_t *> (rt_vec_index_int (vint, i));
+            sink = s;
+        },
+        [=] () {
+            const std::int64_t *p = data<std::int64_t> (vint);
+            std::int64_t s = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                s += p [i];
+            sink = s;
+        }});
+    cases.push_back ({"rt_vec_index_vint", "real", 2 * sizeof (double) + sizeof (std::int64_t),
+        [=] () { TAnyValue r = rt_vec_index_vint (vdbl, index); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            const std::int64_t *q = data<std::int64_t> (index);
+            double *r = new double [n];
+            for (std::size_t i = 0; i < n; ++i)
+                r [i] = p [q [i] - 1];
+            sink = r [n - 1];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_vec_index_vbool", "real", 2 * sizeof (double) + sizeof (bool),
+        [=] () { TAnyValue r = rt_vec_index_vbool (vdbl, vbool); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            const bool *q = data<bool> (vbool);
+            std::size_t count = std::count (q, q + n, true), j = 0;
+            double *r = new double [count];
+            for (std::size_t i = 0; i < n; ++i)
+                if (q [i])
+                    r [j++] = p [i];
+            sink = count ? r [0] : 0;
+            delete [] r;
+        }});
+    cases.push_back ({"rt_combinevec_2", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_combinevec_2 (vdbl, vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [2 * n];
+            std::memcpy (r, p, n * sizeof (double));
+            std::memcpy (r + n, p, n * sizeof (double));
+            sink = r [n];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_combinevec_3", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_combinevec_3 (vdbl, vdbl, vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [3 * n];
+            for (std::size_t i = 0; i < 3; ++i)
+                std::memcpy (r + i * n, p, n * sizeof (double));
+            sink = r [n];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_combinevec_4", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_combinevec_4 (vdbl, vdbl, vdbl, vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [4 * n];
+            for (std::size_t i = 0; i < 4; ++i)
+                std::memcpy (r + i * n, p, n * sizeof (double));
+            sink = r [n];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_revvec", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_revvec (vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [n];
+            std::reverse_copy (p, p + n, r);
+            sink = r [0];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_resizevec", "real", 2 * sizeof (double),
+        [=] () {
+            TAnyValue r = vdbl;
+            rt_resizevec (0, &runtimeData, sizeof (double), r, 2 * n);
+        },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [2 * n] ();
+            std::memcpy (r, p, n * sizeof (double));
+            sink = r [0];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_vint_sort", "s64", 2 * sizeof (std::int64_t),
+        [=] () { TAnyValue r = rt_vint_sort (vint); },
+        [=] () {
+            const std::int64_t *p = data<std::int64_t> (vint);
+            std::vector<std::int64_t> r (p, p + n);
+            std::sort (r.begin (), r.end ());
+            sink = r [0];
+        }});
+    cases.push_back ({"rt_vdbl_sort", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_vdbl_sort (vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            std::vector<double> r (p, p + n);
+            std::sort (r.begin (), r.end ());
+            sink = r [0];
+        }});
+    cases.push_back ({"rt_vint_sum", "s64", sizeof (std::int64_t),
+        [=] () { sink = rt_vint_sum (vint); },
+        [=] () {
+            const std::int64_t *p = data<std::int64_t> (vint);
+            std::int64_t s = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                s += p [i];
+            sink = s;
+        }});
+    cases.push_back ({"rt_vdbl_sum", "real", sizeof (double),
+        [=] () { sink = rt_vdbl_sum (vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double s = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                s += p [i];
+            sink = s;
+        }});
+    cases.push_back ({"rt_vbool_count", "bool", sizeof (bool),
+        [=] () { sink = rt_vbool_count (vbool); },
+        [=] () {
+            const bool *p = data<bool> (vbool);
+            std::int64_t s = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                s += p [i];
+            sink = s;
+        }});
+    cases.push_back ({"rt_vbool_which", "bool", sizeof (bool),
+        [=] () { TAnyValue r = rt_vbool_which (vbool); },
+        [=] () {
+            const bool *p = data<bool> (vbool);
+            std::vector<std::int64_t> r;
+            for (std::size_t i = 0; i < n; ++i)
+                if (p [i])
+                    r.push_back (i + 1);
+            sink = r.size ();
+        }});
+    cases.push_back ({"rt_vint_cumsum", "s64", 2 * sizeof (std::int64_t),
+        [=] () { TAnyValue r = rt_vint_cumsum (vint); },
+        [=] () {
+            const std::int64_t *p = data<std::int64_t> (vint);
+            std::int64_t *r = new std::int64_t [n];
+            std::partial_sum (p, p + n, r);
+            sink = r [n - 1];
+            delete [] r;
+        }});
+    cases.push_back ({"rt_vdbl_cumsum", "real", 2 * sizeof (double),
+        [=] () { TAnyValue r = rt_vdbl_cumsum (vdbl); },
+        [=] () {
+            const double *p = data<double> (vdbl);
+            double *r = new double [n];
+            std::partial_sum (p, p + n, r);
+            sink = r [n - 1];
+            delete [] r;
+        }});
+    return cases;
+}
+
+void runBenchmarks (const TOptions &options) {
+    bool first = true;
+    std::cout << "{\"benchmarks\": [" << std::endl;
+    for (std::size_t n = options.minSize; n <= options.maxSize; n *= 10) {
+        const std::size_t reps = std::max<std::size_t> (1, options.budget / n);
+        for (const TCase &c: createCases (n)) {
+            if (!options.filter.empty () && c.name.find (options.filter) == std::string::npos)
+                continue;
+            const double runtimeNs = measure (c.runtime, reps), baselineNs = measure (c.baseline, reps);
+            std::cout << (first ? "  " : ", ")
+                      << "{\"name\": \"" << c.name << "\", \"type\": \"" << c.type << "\", \"size\": " << n << ", \"reps\": " << reps
+                      << ", \"ns_per_call\": " << runtimeNs << ", \"elements_per_ns\": " << n / runtimeNs << ", \"gb_per_s\": " << n * c.bytesPerElement / runtimeNs
+                      << ", \"baseline_ns_per_call\": " << baselineNs << ", \"baseline_elements_per_ns\": " << n / baselineNs << ", \"baseline_gb_per_s\": " << n * c.bytesPerElement / baselineNs
+                      << ", \"ratio\": " << runtimeNs / baselineNs << "}" << std::endl;
+            first = false;
+        }
+    }
+    std::cout << "]}" << std::endl;
+}
+
+}
+
+int main (int argc, char **argv) {
+    TOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv [i];
+        if (arg == "--min-size")
+            options.minSize = std::stoull (argv [i + 1]);
+        else if (arg == "--max-size")
+            options.maxSize = std::stoull (argv [i + 1]);
+        else if (arg == "--budget")
+            options.budget = std::stoull (argv [i + 1]);
+        else if (arg == "--filter")
+            options.filter = argv [i + 1];
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    runBenchmarks (options);
+}
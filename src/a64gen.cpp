@@ -2035,9 +2035,10 @@ void TA64Generator::externalRoutine (TSymbol &s) {
 }
 
 void TA64Generator::beginRoutineBody (const std::string &routineName, std::size_t level, TSymbolList &symbolList, const std::vector<TA64Reg> &saveRegs, bool hasStackFrame) {
-    if (level > 1) {    
+    const std::vector<std::string> header = level > 1 ? createSymbolList (routineName, level, symbolList, a64RegName) : createInlinedList (symbolList);
+    if (!header.empty ()) {    
         outputComment (std::string ());
-        for (const std::string &s: createSymbolList (routineName, level, symbolList, a64RegName))
+        for (const std::string &s: header)
             outputComment (s);
         outputComment (std::string ());
     }
@@ -0,0 +1,136 @@
+#include "anyvalue.hpp"
+
+#include <mutex>
+#include <vector>
+
+namespace statpascal {
+
+// per thread record identifying the owner of values and collecting values released by other threads
+
+class TAnyValue::TOwner {
+public:
+    std::mutex mutex;
+    std::vector<TValue *> queue;
+    std::atomic<bool> pending = false;
+    bool alive = true;
+};
+
+TAnyValue::TOwner TAnyValue::detached, TAnyValue::immortal;
+
+void TAnyValue::enableThreadSafety () {
+    threadSafe = true;
+}
+
+TAnyValue::TOwner *TAnyValue::createLocalOwner () {
+    // records are never freed as values may still refer to them after their thread has terminated
+    localOwner = new TOwner;
+    
+    struct TThreadExit {
+        ~TThreadExit () {
+            {
+                std::lock_guard<std::mutex> lock (localOwner->mutex);
+                localOwner->alive = false;
+            }
+            // other threads merge their releases themselves from now on
+            processQueuedReleases ();
+        }
+    };
+    static thread_local TThreadExit threadExit;
+    (void) threadExit;
+    return localOwner;
+}
+
+void TAnyValue::processQueuedReleases () {
+    if (!localOwner || !localOwner->pending.load (std::memory_order_relaxed))
+        return;
+    std::vector<TValue *> values;
+    {
+        std::lock_guard<std::mutex> lock (localOwner->mutex);
+        values.swap (localOwner->queue);
+        localOwner->pending = false;
+    }
+    for (TValue *value: values)
+        if (value->mergeQueued ())
+            delete value;
+}
+
+const bool *TAnyValue::getThreadSafeFlag () {
+    return &threadSafe;
+}
+
+std::size_t TAnyValue::getCounterOffset () {
+    return TValue::getCounterOffset ();
+}
+
+void TAnyValue::retainValue (void *p) {
+    static_cast<TValue *> (p)->addRef ();
+}
+
+void TAnyValue::releaseValue (void *p) {
+    TValue *value = static_cast<TValue *> (p);
+    if (value->release ())
+        delete value;
+}
+
+void TAnyValue::deleteValue (void *p) {
+    delete static_cast<TValue *> (p);
+}
+
+std::size_t TAnyValue::TValue::getCounterOffset () {
+    TConcreteValue<bool> value (false);
+    return reinterpret_cast<char *> (&value.biased) - reinterpret_cast<char *> (static_cast<TValue *> (&value));
+}
+
+bool TAnyValue::TValue::mergeQueued () {
+    std::int64_t delta = -queued;
+    if (owner.load (std::memory_order_relaxed) != &detached) {
+        delta += static_cast<std::int64_t> (biased) * one + merged;
+        biased = 0;
+        owner.store (&detached, std::memory_order_release);
+    }
+    return shared.fetch_add (delta, std::memory_order_acq_rel) + delta == merged;
+}
+
+bool TAnyValue::TValue::releaseOwned () {
+    // called when biased has dropped to zero
+    bool unreferenced = true;
+    if (shared.load (std::memory_order_acquire)) {
+        owner.store (&detached, std::memory_order_release);
+        unreferenced = shared.fetch_add (merged, std::memory_order_acq_rel) + merged == merged;
+    }
+    if (localOwner->pending.load (std::memory_order_relaxed))
+        processQueuedReleases ();
+    return unreferenced;
+}
+
+bool TAnyValue::TValue::releaseShared () {
+    std::int64_t old = shared.load (std::memory_order_relaxed), next;
+    do {
+        next = old - one;
+        // a negative count before the merge means that the owner holds the last references 
+        if (!(next & (merged | queued)) && next < 0)
+            next |= queued;
+    } while (!shared.compare_exchange_weak (old, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (next & merged)
+        return next == merged;
+    if ((next & queued) && !(old & queued))
+        queueRelease ();
+    return false;
+}
+
+void TAnyValue::TValue::queueRelease () {
+    TOwner *o = owner.load (std::memory_order_acquire);
+    if (o != &detached) {
+        std::lock_guard<std::mutex> lock (o->mutex);
+        if (o->alive) {
+            o->queue.push_back (this);
+            o->pending = true;
+            return;
+        }
+    }
+    // the owner has terminated or merged the value itself
+    if (mergeQueued ())
+        delete this;
+}
+
+}
@@ -4,7 +4,18 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "heapprofile.hpp"
 
 namespace statpascal {
 
@@ -33,38 +44,222 @@ public:
     template<typename T> T &get ();
     template<typename T> const T &get () const;
     
+    /** Strings of up to inlineStringLength characters are stored in the handle itself 
+        and converted to a std::string when accessed with get. In both forms the characters
+        are followed by a zero byte. Unlike vectors, longer strings are not created with
+        trailing storage: get<std::string> gives external routines a modifiable std::string,
+        so characters beyond its small buffer take a second allocation. */
+    static constexpr std::size_t inlineStringLength = sizeof (void *) - 2;
+    
+    /** characters of a string value without conversion; no value is an empty string */
+    std::string_view getString () const;
+    /** writable characters of a string value (which must exist) */
+    char *getStringBuffer ();
+    
+    /** creates a value of type T followed by storageSize bytes in a single allocation. T is
+        constructed with a pointer to the storage as first argument. A type providing 
+        getStorageSize () is cloned the same way. */
+    template<typename T, typename... Args> static TAnyValue createWithStorage (std::size_t storageSize, Args &&...);
+    
+    /** excludes an unshared value from reference counting, e.g. for constants. It is
+        never deleted as copies may exist anywhere. */
+    void makeImmortal ();
+    
+    /** switches to thread safe reference counting. Must be called before a second 
+        thread accesses any value. */
+    static void enableThreadSafety ();
+    
+    /** releases values whose last reference was dropped by another thread. */
+    static void processQueuedReleases ();
+    
+    /** support for reference counting in generated code, which handles nil and inline values
+        itself: while the flag is false, the count of an allocated value is the word at 
+        getCounterOffset () and the value is deleted with deleteValue when it drops to zero. 
+        Otherwise retainValue and releaseValue must be used. */
+    static const bool *getThreadSafeFlag ();
+    static std::size_t getCounterOffset ();
+    static void retainValue (void *);
+    static void releaseValue (void *);
+    static void deleteValue (void *);
+    
 private:
+    class TOwner;
+    
+    /** Values use biased reference counting: the creating thread counts its references
+        in biased without atomic operations, other threads use the atomic shared counter.
+        Until enableThreadSafety is called only biased is used. */
     class TValue {
     public:
-        TValue (): refcount (1) {};
-        virtual ~TValue () = default;
+        TValue ();
+        virtual ~TValue ();
         virtual TValue *clone () = 0;
         
-        std::size_t refcount;
+        // values may have been allocated with trailing storage
+        static void *operator new (std::size_t size) { return ::operator new (size); }
+        static void *operator new (std::size_t, void *p) { return p; }
+        static void operator delete (void *p) { ::operator delete (p); }
+        
+        void addRef ();
+        /** returns true if the last reference was released */
+        bool release ();
+        bool isShared () const;
+        void makeImmortal ();
+        
+        /** merges a value taken from the queue of its owner; returns true if it is unreferenced */
+        bool mergeQueued ();
+        
+        static std::size_t getCounterOffset ();
+        
+    private:
+        bool isOwned () const;
+        bool releaseOwned ();
+        bool releaseShared ();
+        void queueRelease ();
+        
+        // shared holds the reference count of other threads (may become negative) and two flags
+        static constexpr int countShift = 2;
+        static constexpr std::int64_t merged = 1, queued = 2, one = 1 << countShift;
+        
+        std::atomic<TOwner *> owner;
+        std::size_t biased;
+        std::atomic<std::int64_t> shared;
     };
     
+    template<typename T, typename = void> struct THasStorageSize: std::false_type {};
+    
     template<typename T> class TConcreteValue: public TValue {
     public:
         TConcreteValue (const T &);
         TConcreteValue (T &&);
+        template<typename... Args> TConcreteValue (std::in_place_t, Args &&...);
         virtual ~TConcreteValue () = default;
         
         virtual TValue *clone () override;
+        
+        template<typename... Args> static TConcreteValue *createWithStorage (std::size_t storageSize, Args &&...);
 
         T concreteValue;
+        
+    private:
+        void profileAllocation ();
     };
     
-    TValue *value;
+    // changed by get<std::string> when an inline string is converted
+    mutable TValue *value;
+    
+    bool isInline () const;
+    bool isAllocated () const;
+    void setInlineString (std::string_view);
+    void materializeString () const;
+    
+    static TOwner *getLocalOwner ();
+    static TOwner *createLocalOwner ();
+    
+    static inline bool threadSafe = false;
+    static inline thread_local TOwner *localOwner = nullptr;
+    // owner of values whose biased count has been merged into the shared count
+    static TOwner detached;
+    // owner of values excluded from reference counting
+    static TOwner immortal;
 };
 
+/** Managed argument of a runtime routine. Generated code passes the address of the caller's
+    value without counting a reference, so the routine may read but not modify or keep it. */
+using TBorrowedValue = const TAnyValue &;
+
+inline TAnyValue::TValue::TValue ():
+  owner (getLocalOwner ()), biased (1), shared (0) {
+}
+
+inline TAnyValue::TValue::~TValue () {
+    if (THeapProfile::isEnabled ())
+        THeapProfile::release (this);
+}
+
+inline bool TAnyValue::TValue::isOwned () const {
+    return owner.load (std::memory_order_relaxed) == localOwner;
+}
+
+inline void TAnyValue::TValue::addRef () {
+    const TOwner *o = owner.load (std::memory_order_relaxed);
+    if (o == &immortal)
+        return;
+    if (!threadSafe || o == localOwner)
+        ++biased;
+    else
+        shared.fetch_add (one, std::memory_order_relaxed);
+}
+
+inline bool TAnyValue::TValue::release () {
+    const TOwner *o = owner.load (std::memory_order_relaxed);
+    if (o == &immortal)
+        return false;
+    if (!threadSafe)
+        return !--biased;
+    if (o == localOwner)
+        return !--biased && releaseOwned ();
+    return releaseShared ();
+}
+
+inline bool TAnyValue::TValue::isShared () const {
+    if (!threadSafe)
+        return biased > 1;
+    const std::int64_t s = shared.load (std::memory_order_acquire);
+    if (isOwned ())
+        return static_cast<std::int64_t> (biased) + (s >> countShift) > 1;
+    return s != (merged | one);
+}
+
+inline void TAnyValue::TValue::makeImmortal () {
+    // generated code still counts biased inline until thread safety is enabled, so it must never drop to zero
+    owner = &immortal;
+    biased = std::numeric_limits<std::size_t>::max () / 2;
+}
+
+inline TAnyValue::TOwner *TAnyValue::getLocalOwner () {
+    return localOwner ? localOwner : createLocalOwner ();
+}
+
+template<typename T> struct TAnyValue::THasStorageSize<T, std::void_t<decltype (std::declval<const T &> ().getStorageSize ())>>: std::true_type {};
+
 template<typename T> inline TAnyValue::TConcreteValue<T>::TConcreteValue (const T &val): concreteValue (val) {
+    profileAllocation ();
 }
 
 template<typename T> inline TAnyValue::TConcreteValue<T>::TConcreteValue (T &&val): concreteValue (std::move (val)) {
+    profileAllocation ();
+}
+
+template<typename T> template<typename... Args> inline TAnyValue::TConcreteValue<T>::TConcreteValue (std::in_place_t, Args &&...args): concreteValue (std::forward<Args> (args)...) {
+    profileAllocation ();
+}
+
+template<typename T> inline void TAnyValue::TConcreteValue<T>::profileAllocation () {
+    if (THeapProfile::isEnabled ()) {
+        if constexpr (std::is_same<T, std::string>::value) {
+            // characters of short strings are stored in the object itself
+            const char *p = concreteValue.data ();
+            const bool external = p < reinterpret_cast<const char *> (this) || p >= reinterpret_cast<const char *> (this + 1);
+            THeapProfile::allocate (static_cast<TValue *> (this), sizeof (TConcreteValue) + (external ? concreteValue.capacity () + 1 : 0), THeapProfile::TKind::String);
+        } else if constexpr (THasStorageSize<T>::value)
+            THeapProfile::allocate (static_cast<TValue *> (this), sizeof (TConcreteValue) + concreteValue.getStorageSize (), THeapProfile::TKind::Vector);
+        else
+            THeapProfile::allocate (static_cast<TValue *> (this), sizeof (TConcreteValue), THeapProfile::TKind::Value);
+    }
 }
 
 template<typename T> inline TAnyValue::TValue *TAnyValue::TConcreteValue<T>::clone () {
-    return new TConcreteValue (concreteValue);
+    if constexpr (THasStorageSize<T>::value)
+        return createWithStorage (concreteValue.getStorageSize (), std::as_const (concreteValue));
+    else
+        return new TConcreteValue (concreteValue);
+}
+
+template<typename T> template<typename... Args> inline TAnyValue::TConcreteValue<T> *TAnyValue::TConcreteValue<T>::createWithStorage (std::size_t storageSize, Args &&...args) {
+    constexpr std::size_t alignment = alignof (std::max_align_t), 
+                          offset = (sizeof (TConcreteValue) + alignment - 1) / alignment * alignment;
+    char *p = static_cast<char *> (::operator new (offset + storageSize));
+    return new (p) TConcreteValue (std::in_place, p + offset, std::forward<Args> (args)...);
 }
 
 inline TAnyValue::TAnyValue (): 
@@ -73,19 +268,19 @@ inline TAnyValue::TAnyValue ():
 
 inline TAnyValue::TAnyValue (void *p):
   value (static_cast<TValue *> (p)) {
-      if (value)
-          ++value->refcount;
+      if (isAllocated ())
+          value->addRef ();
 }
 
 inline TAnyValue::~TAnyValue () {
-    if (value && !--value->refcount)
+    if (isAllocated () && value->release ())
         delete value;
 }
 
 inline TAnyValue::TAnyValue (const TAnyValue &other):
   value (other.value) {
-    if (value)
-      ++value->refcount;
+    if (isAllocated ())
+      value->addRef ();
 
 }
 
@@ -94,8 +289,13 @@ inline TAnyValue::TAnyValue (TAnyValue &&other):
     other.value = nullptr;
 }
 
-template<typename T, typename U, typename V> inline TAnyValue::TAnyValue (T &&val):
-  value (new TConcreteValue<U> (std::forward<T> (val))) {
+template<typename T, typename U, typename V> inline TAnyValue::TAnyValue (T &&val) {
+    if constexpr (std::is_same<U, std::string>::value)
+        if (val.length () <= inlineStringLength) {
+            setInlineString (val);
+            return;
+        }
+    value = new TConcreteValue<U> (std::forward<T> (val));
 }
 
 inline TAnyValue &TAnyValue::operator = (TAnyValue other) {
@@ -107,21 +307,75 @@ inline TAnyValue &TAnyValue::swap (TAnyValue &other) {
     return *this;
 }
 
+template<typename T, typename... Args> inline TAnyValue TAnyValue::createWithStorage (std::size_t storageSize, Args &&...args) {
+    TAnyValue result;
+    result.value = TConcreteValue<T>::createWithStorage (storageSize, std::forward<Args> (args)...);
+    return result;
+}
+
 template<typename T> inline T &TAnyValue::get () {
+    if constexpr (std::is_same<T, std::string>::value)
+        materializeString ();
     return static_cast<TConcreteValue<T> *> (value)->concreteValue;
 }
 
 template<typename T> inline const T &TAnyValue::get () const {
+    if constexpr (std::is_same<T, std::string>::value)
+        materializeString ();
     return static_cast<const TConcreteValue<T> *> (value)->concreteValue;
 }
 
+inline bool TAnyValue::isInline () const {
+    return reinterpret_cast<std::uintptr_t> (value) & 1;
+}
+
+inline bool TAnyValue::isAllocated () const {
+    return value && !isInline ();
+}
+
+inline void TAnyValue::setInlineString (std::string_view s) {
+    // byte 0 holds the tag bit and the length
+    value = nullptr;
+    char *p = reinterpret_cast<char *> (&value);
+    p [0] = (s.length () << 1) | 1;
+    std::copy (s.begin (), s.end (), p + 1);
+}
+
+inline void TAnyValue::materializeString () const {
+    if (isInline ()) {
+        std::string s (getString ());
+        value = new TConcreteValue<std::string> (std::move (s));
+    }
+}
+
+inline std::string_view TAnyValue::getString () const {
+    if (isInline ()) {
+        const unsigned char *p = reinterpret_cast<const unsigned char *> (&value);
+        return std::string_view (reinterpret_cast<const char *> (p + 1), p [0] >> 1);
+    }
+    return value ? std::string_view (static_cast<const TConcreteValue<std::string> *> (value)->concreteValue) : std::string_view ();
+}
+
+inline char *TAnyValue::getStringBuffer () {
+    if (isInline ())
+        return reinterpret_cast<char *> (&value) + 1;
+    return static_cast<TConcreteValue<std::string> *> (value)->concreteValue.data ();
+}
+
 inline void TAnyValue::copyOnWrite () {
-    if (value && value->refcount > 1) {
-        --value->refcount;
-        value = value->clone ();
+    if (isAllocated () && value->isShared ()) {
+        TValue *copy = value->clone ();
+        if (value->release ())
+            delete value;
+        value = copy;
     }
 }
 
+inline void TAnyValue::makeImmortal () {
+    if (isAllocated ())
+        value->makeImmortal ();
+}
+
 inline bool TAnyValue::hasValue () const {
     return !!value;
 }
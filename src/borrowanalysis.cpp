@@ -0,0 +1,206 @@
+#include "borrowanalysis.hpp"
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+#include "config.hpp"
+
+#include <map>
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+struct TBlockEffects {
+    std::set<const TSymbol *> modified;		// own variables and parameters written to
+    std::vector<TBlock *> callees;
+    bool nonLocalWrite = false, unknownCall = false, writesResult = false, resultShared = false, localOnly = false;
+};
+
+using TEffectMap = std::map<TBlock *, TBlockEffects>;
+
+class TEffectCollector: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    TEffectCollector (TBlock &block, TEffectMap &effectMap, bool &indirectResultShared);
+
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TConstantValue &) override;
+    virtual void generateCode (TRoutineValue &) override;
+    virtual void generateCode (TPredefinedRoutine &) override;
+    virtual void generateCode (TAssignment &) override;
+
+private:
+    void modifies (TExpressionBase *lValue);
+    bool isRuntimeData (TExpressionBase *) const;
+
+    TEffectMap &effectMap;
+    TBlockEffects &effects;
+    const std::size_t level;
+    const TSymbol *resultSymbol;
+    bool &indirectResultShared;
+};
+
+TEffectCollector::TEffectCollector (TBlock &block, TEffectMap &effectMap, bool &indirectResultShared):
+  effectMap (effectMap), effects (effectMap [&block]), level (block.getSymbols ().getLevel ()), resultSymbol (nullptr), indirectResultShared (indirectResultShared) {
+    if (block.returnLValueDeref)
+        if (TVariable *result = dynamic_cast<TVariable *> (static_cast<TLValueDereference *> (block.returnLValueDeref)->getLValue ()))
+            resultSymbol = result->getSymbol ();
+}
+
+void TEffectCollector::modifies (TExpressionBase *lValue) {
+    for (;;)
+        if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (lValue))
+            lValue = arrayIndex->getBaseExpression ();
+        else if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (lValue))
+            lValue = recordComponent->getExpression ();
+        else if (TVectorIndex *vectorIndex = dynamic_cast<TVectorIndex *> (lValue))
+            lValue = vectorIndex->getBaseExpression ();
+        else if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (lValue))
+            lValue = typeCast->getExpression ();
+        else if (TLValueDereference *lValueDereference = dynamic_cast<TLValueDereference *> (lValue))
+            lValue = lValueDereference->getLValue ();
+        else
+            break;
+
+    if (TVariable *variable = dynamic_cast<TVariable *> (lValue)) {
+        const TSymbol *s = variable->getSymbol ();
+        if (s == resultSymbol)
+            effects.writesResult = true;
+        else if (!variable->isReference () && s->getLevel () == level && !s->checkSymbolFlag (TSymbol::Alias) && !s->checkSymbolFlag (TSymbol::Absolute) &&
+                 (s->checkSymbolFlag (TSymbol::Variable) || s->checkSymbolFlag (TSymbol::Parameter)))
+            effects.modified.insert (s);
+        else
+            effects.nonLocalWrite = true;
+    } else
+        // pointer dereference
+        effects.nonLocalWrite = true;
+}
+
+bool TEffectCollector::isRuntimeData (TExpressionBase *expr) const {
+    if (expr->isLValueDereference ())
+        expr = static_cast<TLValueDereference *> (expr)->getLValue ();
+    return expr->isSymbol () && static_cast<TVariable *> (expr)->getSymbol ()->getName () == TConfig::globalRuntimeDataPtr;
+}
+
+void TEffectCollector::generateCode (TFunctionCall &functionCall) {
+    TExpressionBase *function = functionCall.getFunction ();
+    TExpressionBase *returnStorage = functionCall.getReturnStorage ();
+    const bool storesResult = returnStorage && !functionCall.hasReturnTemp ();
+    bool isExternal = false;
+
+    if (function->isRoutine ()) {
+        TSymbol *s = static_cast<TRoutineValue *> (function)->getSymbol ();
+        if (s->checkSymbolFlag (TSymbol::External))
+            isExternal = true;
+        else if (TBlock *block = s->getBlock ()) {
+            effects.callees.push_back (block);
+            if (storesResult)
+                effectMap [block].resultShared = true;
+        } else
+            effects.unknownCall = true;
+    } else {
+        visit (function);
+        effects.unknownCall = true;
+        if (storesResult)
+            indirectResultShared = true;
+    }
+
+    const std::vector<TExpressionBase *> &args = functionCall.getArguments ();
+    std::vector<TExpressionBase *>::const_iterator it = args.begin ();
+    for (const TSymbol *parameter: static_cast<TRoutineType *> (function->getType ())->getParameter ()) {
+        if (it == args.end ())
+            break;
+        TType *type = parameter->getType ();
+        visit (*it);
+        if (type->isReference ())
+            modifies (*it);
+        else if (type->isRoutine ())
+            effects.unknownCall = true;
+        // external routines may write through pointers
+        else if (isExternal && type->isPointer () && !isRuntimeData (*it))
+            effects.nonLocalWrite = true;
+        ++it;
+    }
+
+    if (storesResult) {
+        visit (returnStorage);
+        modifies (returnStorage);
+    }
+}
+
+// routines used as values may be called from anywhere
+
+void TEffectCollector::generateCode (TConstantValue &constantValue) {
+    if (constantValue.getType ()->isRoutine ())
+        effects.unknownCall = true;
+}
+
+void TEffectCollector::generateCode (TRoutineValue &) {
+    effects.unknownCall = true;
+}
+
+void TEffectCollector::generateCode (TPredefinedRoutine &predefinedRoutine) {
+    inherited::generateCode (predefinedRoutine);
+    const std::vector<TExpressionBase *> &args = predefinedRoutine.getArguments ();
+    if ((predefinedRoutine.getRoutine () == TPredefinedRoutine::Inc || predefinedRoutine.getRoutine () == TPredefinedRoutine::Dec) && !args.empty ())
+        modifies (args [0]);
+}
+
+void TEffectCollector::generateCode (TAssignment &assignment) {
+    inherited::generateCode (assignment);
+    modifies (assignment.getLValue ());
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ()) {
+            blocks.push_back (s->getBlock ());
+            collectBlocks (*s->getBlock (), blocks);
+        }
+}
+
+}
+
+void TBorrowAnalysis::analyze (TBlock &programBlock) {
+    std::vector<TBlock *> blocks {&programBlock};
+    collectBlocks (programBlock, blocks);
+
+    TEffectMap effectMap;
+    bool indirectResultShared = false;
+    for (TBlock *block: blocks) {
+        TEffectCollector effectCollector (*block, effectMap, indirectResultShared);
+        effectCollector.visit (block);
+    }
+
+    // a routine has local effects only if all routines called have
+    for (TBlock *block: blocks) {
+        TBlockEffects &effects = effectMap [block];
+        effects.localOnly = !effects.nonLocalWrite && !effects.unknownCall;
+    }
+    bool changed;
+    do {
+        changed = false;
+        for (TBlock *block: blocks) {
+            TBlockEffects &effects = effectMap [block];
+            if (effects.localOnly)
+                for (TBlock *callee: effects.callees) {
+                    TEffectMap::iterator it = effectMap.find (callee);
+                    if (it == effectMap.end () || !it->second.localOnly) {
+                        effects.localOnly = false;
+                        changed = true;
+                        break;
+                    }
+                }
+        }
+    } while (changed);
+
+    for (TBlock *block: blocks) {
+        const TBlockEffects &effects = effectMap [block];
+        if (effects.localOnly && !(effects.writesResult && (effects.resultShared || indirectResultShared)))
+            for (TSymbol *s: block->getSymbols ())
+                if (s->checkSymbolFlag (TSymbol::Parameter) && (s->getType ()->isString () || s->getType ()->isVector ()) && !s->isAliased () && !effects.modified.count (s))
+                    s->setBorrowed ();
+    }
+}
+
+}
@@ -0,0 +1,26 @@
+/** \file borrowanalysis.hpp
+
+    Finds string and vector value parameters which a routine can borrow from its
+    caller: instead of taking a counted reference the routine uses the caller's
+    value directly and does not release it on exit.
+
+    A parameter is borrowed if the routine never modifies it or takes its address
+    and if the caller's argument cannot change during the call: the routine and all
+    routines it calls write only to their own local variables and results and do not
+    call through routine pointers. A function writing its result is excluded if its
+    result may be stored directly into a variable of the caller.
+*/
+
+#pragma once
+
+namespace statpascal {
+
+class TBlock;
+
+class TBorrowAnalysis final {
+public:
+    /** marks the borrowed parameters of all routines of the program */
+    static void analyze (TBlock &programBlock);
+};
+
+}
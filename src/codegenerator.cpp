@@ -220,7 +220,7 @@ TBaseGenerator::TTypeAnyManager TBaseGenerator::lookupAnyManager (const TType *t
 TAnyManager *TBaseGenerator::buildAnyManager (const TSymbolList &symbolList) {
     TAnyRecordManager *result = new TAnyRecordManager ();
     for (const TSymbol *s: symbolList)
-        if (s->checkSymbolFlag (TSymbol::Parameter) || s->checkSymbolFlag (TSymbol::Variable)) {
+        if ((s->checkSymbolFlag (TSymbol::Parameter) || s->checkSymbolFlag (TSymbol::Variable)) && !s->isBorrowed ()) {
             TType *type = s->getType ();
             if (TAnyManager *anyManager = buildAnyManager (type))
                 result->appendComponent (anyManager, s->getOffset ());
@@ -260,6 +260,37 @@ TAnyManager *TBaseGenerator::buildAnyManager (const TType *type) {
     return nullptr;
 }
 
+void TBaseGenerator::collectAnySlots (const TSymbolList &symbolList, ssize_t offset, TAnySlots &slots) {
+    for (const TSymbol *s: symbolList)
+        if ((s->checkSymbolFlag (TSymbol::Parameter) || s->checkSymbolFlag (TSymbol::Variable)) && !s->isBorrowed ())
+            collectAnySlots (s->getType (), offset + s->getOffset (), slots);
+}
+
+void TBaseGenerator::collectAnySlots (const TType *type, ssize_t offset, TAnySlots &slots) {
+    if (type->isString () || type->isVector ())
+        slots.offsets.push_back (offset);
+    else if (type->isRecord ())
+        collectAnySlots (*static_cast<const TRecordType *> (type)->getRecordFields ().components, offset, slots);
+    else if (type->isArray ()) {
+        std::size_t count = 1;
+        while (type->isArray ()) {
+            const TArrayType *arrayType = static_cast<const TArrayType *> (type);
+            count *= (arrayType->getIndexType ()->getMaxVal () - arrayType->getIndexType ()->getMinVal () + 1);
+            type = arrayType->getBaseType ();
+        }
+        TAnySlots element;
+        collectAnySlots (type, 0, element);
+        if (!element.specialized || !element.loops.empty ())
+            slots.specialized = false;
+        else if (count * element.offsets.size () <= maxUnrolledSlots) {
+            for (std::size_t i = 0; i < count; ++i)
+                for (ssize_t elementOffset: element.offsets)
+                    slots.offsets.push_back (offset + i * type->getSize () + elementOffset);
+        } else if (!element.offsets.empty ())
+            slots.loops.push_back ({offset, count, type->getSize (), std::move (element.offsets)});
+    }
+}
+
 void TCodeGenerator::visit (TSyntaxTreeNode *node) {
     if (node)
         node->acceptCodeGenerator (*this);
@@ -381,6 +412,8 @@ std::vector<std::string> TBaseGenerator::createSymbolList (const std::string &ro
                 ss << s->getName () << ": " << s->getType ()->getName ();;
                 if (s->checkSymbolFlag (TSymbol::Absolute))
                     ss << " (absolute)";
+                if (s->isBorrowed ())
+                    ss << " (borrowed)";
                 headerListing.push_back (ss.str ());
             }
         symbols = symbols->getPreviousLevel ();
@@ -389,15 +422,24 @@ std::vector<std::string> TBaseGenerator::createSymbolList (const std::string &ro
         std::sort (headerListing.begin () + 1, headerListing.end ());
         headerListing.erase (std::unique (headerListing.begin (), headerListing.end ()), headerListing.end ());
     }
+    std::vector<std::string> inlined = createInlinedList (symbolList);
+    headerListing.insert (headerListing.begin () + 1, inlined.begin (), inlined.end ());
     return headerListing;
 }
 
+std::vector<std::string> TBaseGenerator::createInlinedList (const TSymbolList &symbolList) {
+    std::vector<std::string> listing;
+    for (const std::pair<const std::string, std::size_t> &it: symbolList.getInlinedCalls ())
+        listing.push_back ("Inlined: " + it.first + " (" + std::to_string (it.second) + (it.second == 1 ? " call)" : " calls)"));
+    return listing;
+}
+
 void TBaseGenerator::makeUniqueLabelNames (TSymbolList &symbols) {
     for (TSymbol *s: symbols)
         if ((s->checkSymbolFlag (TSymbol::Label) || s->checkSymbolFlag (TSymbol::Routine)) && !s->checkSymbolFlag (TSymbol::External)) {
             const std::string t = s->getName ();
             if (!t.empty () && t [0] != '.')
-                s->setName (t + "_" + std::to_string (labelCount++));
+                symbols.renameSymbol (s, t + "_" + std::to_string (labelCount++));
         }
 }
 
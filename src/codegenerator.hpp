@@ -101,6 +101,24 @@ protected:
     TAnyManager *buildAnyManagerArray (const TType *type);
     TAnyManager *buildAnyManager (const TType *type);
     
+    /** TAnyValue slots of a managed type or of the variables of a routine, used to 
+        generate specialized copy and destroy code. Arrays with more than maxUnrolledSlots
+        slots become loops; types requiring nested loops are not specialized. */
+    struct TAnySlots {
+        struct TLoop {
+            ssize_t offset;
+            std::size_t count, size;
+            std::vector<ssize_t> offsets;
+        };
+        std::vector<ssize_t> offsets;
+        std::vector<TLoop> loops;
+        bool specialized = true;
+    };
+    static constexpr std::size_t maxUnrolledSlots = 16;
+    
+    void collectAnySlots (const TSymbolList &symbolList, ssize_t offset, TAnySlots &);
+    void collectAnySlots (const TType *type, ssize_t offset, TAnySlots &);
+    
     std::size_t registerAnyManager (TAnyManager *);
     std::size_t registerStringConstant (const std::string &);
     std::size_t registerData (const void *, std::size_t);
@@ -114,6 +132,7 @@ protected:
     bool getSetTypeLimit (const TExpressionBase *, std::int64_t &minval, std::int64_t &maxval);
     
     std::vector<std::string> createSymbolList (const std::string &routineName, std::size_t level, TSymbolList &, const std::vector<std::string> &regNames, int offset = 0);
+    std::vector<std::string> createInlinedList (const TSymbolList &);
 
     // TODO: private after A64 modificiation    
     void allocateGlobalDataArea (std::size_t n);
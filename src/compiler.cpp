@@ -2,6 +2,12 @@
 
 #include "expression.hpp"
 #include "codegenerator.hpp"
+#include "constantfolding.hpp"
+#include "inliner.hpp"
+#include "loopoptimizer.hpp"
+#include "valuenumbering.hpp"
+#include "deadroutines.hpp"
+#include "treedump.hpp"
 #include "tms9900gen.hpp"
 #include "config.hpp"
 
@@ -230,7 +236,7 @@ void TBlock::checkDefinitions () {
     if (symbols->getLevel () != 1) {            
         for (TSymbol *s: *symbols)
             if (s->checkSymbolFlag (TSymbol::StaticVariable)) {
-                s->setName ("$static_" + s->getName ());
+                symbols->renameSymbol (s, "$static_" + s->getName ());
                 s->setLevel (1);
             }
         TSymbolList *prev = symbols;
@@ -1265,6 +1271,7 @@ TCompilerImpl::TCompilerImpl (TCodeGenerator &codeGenerator):
   memoryPoolFactory (1024 * 1024),
   codeGenerator (codeGenerator),
   systemUnit (nullptr),
+  statistics {0, 0, 0},
   errorFlag (false),
   bankActive (false),
   bankCount (0) {
@@ -1332,6 +1339,10 @@ TCompiler::TCompileResult TCompilerImpl::compile () {
     return errorFlag ? TCompiler::Error : TCompiler::ProgramCompiled;
 }
 
+const TCompiler::TStatistics &TCompilerImpl::getStatistics () const {
+    return statistics;
+}
+
 void TCompilerImpl::errorMessage (TCompilerImpl::TErrorType errorType, const std::string &description) {
     errorFlag = true;
     std::cerr << getLexer ().getLexerPosition ().getFilename () << ":" << getLexer ().getLexerPosition ().getLineNumber () << ":" << getLexer ().getLexerPosition ().getLinePosition () << ": error: " << description << std::endl;
@@ -1365,6 +1376,10 @@ void TCompilerImpl::setUnitSearchPathes (const std::vector<std::string> &pathes)
     unitSearchPathes = pathes;
 }
 
+void TCompilerImpl::setTokenCacheDirectory (const std::string &directory, const std::string &compilerVersion) {
+    tokenCache.setDirectory (directory, compilerVersion);
+}
+
 std::string TCompilerImpl::searchUnitPathes (const std::string &s) {
     for (const std::string &path: unitSearchPathes) {
         const std::string fn = path + '/' + s;
@@ -1383,7 +1398,16 @@ TUnit *TCompilerImpl::loadUnit (const std::string &unitname) {
 //            const std::string fn = path + '/' + unitname + ".pas";
 //            if (std::filesystem::exists (fn)) {
                 lexerStack.push (&unitDescription.lexer);
-                unitDescription.lexer.setFilename (fn);
+                TTokenImage tokenImage;
+                if (tokenCache.isEnabled ())
+                    unitDescription.cacheEntry = tokenCache.getEntryFilename (fn);
+                if (!unitDescription.cacheEntry.empty () && tokenCache.load (unitDescription.cacheEntry, tokenImage))
+                    unitDescription.lexer.setTokenImage (fn, std::move (tokenImage));
+                else {
+                    unitDescription.lexer.setFilename (fn);
+                    if (!unitDescription.cacheEntry.empty ())
+                        unitDescription.lexer.recordTokens ();
+                }
                 unitDescription.unit = memoryPoolFactory.create<TUnit> (*this, predefinedSymbols);
                 if (allUnits.empty ())
                     allUnits.push_back (unitDescription.unit);
@@ -1421,10 +1445,23 @@ void TCompilerImpl::parseProgram () {
     } while (!allUnitsDone);
     
     if (!errorFlag) {
+        for (std::pair<const std::string, TUnitDescription> &it: unitMap)
+            if (it.second.lexer.isRecording ())
+                tokenCache.save (it.second.cacheEntry, it.second.lexer.getTokenImage ());
+
         for (std::vector<TUnit *>::reverse_iterator it = allUnits.rbegin (); it != allUnits.rend (); ++it)
             program.appendUnit (*it);
         program.getBlock ()->markUsedSymbols ();
-        program.getBlock ()->getSymbols ().removeUnusedSymbols ();
+        statistics.unusedRoutines = program.getBlock ()->getSymbols ().removeUnusedSymbols ();
+        TInliner::optimize (*program.getBlock ());
+        TConstantFolding::optimize (*program.getBlock ());
+        TLoopOptimizer::optimize (*program.getBlock ());
+        TValueNumbering::optimize (*program.getBlock ());
+        const TDeadRoutineElimination::TResult result = TDeadRoutineElimination::optimize (*program.getBlock ());
+        statistics.routines = result.routines;
+        statistics.unreachableRoutines = result.removed;
+        if (TConfig::dumpSyntaxTree)
+            TTreeDump::dump (*program.getBlock (), std::cout);
         program.acceptCodeGenerator (codeGenerator);
     }
 }
@@ -1475,10 +1512,18 @@ void TCompiler::setUnitSearchPathes (const std::vector<std::string> &pathes) {
     impl ()->setUnitSearchPathes (pathes);
 }
 
+void TCompiler::setTokenCacheDirectory (const std::string &directory, const std::string &compilerVersion) {
+    impl ()->setTokenCacheDirectory (directory, compilerVersion);
+}
+
 TCompiler::TCompileResult TCompiler::compile () {
     return impl ()->compile ();
 }
 
+const TCompiler::TStatistics &TCompiler::getStatistics () const {
+    return impl ()->getStatistics ();
+}
+
 const TCompilerImpl *TCompiler::impl () const {
     return pImpl.get ();
 }
@@ -6,6 +6,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <cstddef>
 
 namespace statpascal {
 
@@ -25,10 +26,18 @@ public:
     void setSource (std::string &&);
     void setFilename (const std::string &);
     void setUnitSearchPathes (const std::vector<std::string> &);
+    /** token images of units are cached in the directory; an empty directory disables the cache */
+    void setTokenCacheDirectory (const std::string &directory, const std::string &compilerVersion);
 
     enum TCompileResult {Error, UnitCompiled, ProgramCompiled};    
     TCompileResult compile ();
     
+    struct TStatistics {
+        std::size_t routines, unusedRoutines, unreachableRoutines;
+    };
+    /** routines generated, removed as unused after parsing and removed as unreachable after optimization */
+    const TStatistics &getStatistics () const;
+    
 private:
     std::unique_ptr<TCompilerImpl, TCompilerImplDeleter> pImpl;
     
@@ -10,6 +10,7 @@
 
 #include "compiler.hpp"
 #include "lexer.hpp"
+#include "tokencache.hpp"
 #include "datatypes.hpp"
 #include "syntaxtreenode.hpp"
 #include "statements.hpp"
@@ -209,6 +210,7 @@ public:
     std::size_t getBankNumber () const;
     
     TCompiler::TCompileResult compile ();
+    const TCompiler::TStatistics &getStatistics () const;
     
     TLexer &getLexer ();
     TCodeGenerator &getCodeGenerator ();
@@ -232,6 +234,7 @@ public:
     void checkAndSynchronize (TToken t, const std::string &errorMessage);
 
     void setUnitSearchPathes (const std::vector<std::string> &);    
+    void setTokenCacheDirectory (const std::string &directory, const std::string &compilerVersion);
     std::string searchUnitPathes (const std::string &);
     TUnit *loadUnit (const std::string &unitname);
     TUnit *getSystemUnit ();
@@ -254,13 +257,16 @@ private:
         TLexer lexer;
         TUnit *unit;
         bool complete;
+        std::string cacheEntry;
     };
     using TUnitMap = std::unordered_map<std::string, TUnitDescription>;
     TUnitMap unitMap;
     std::vector<TUnit *> allUnits;
     TUnit *systemUnit;
     std::vector<std::string> unitSearchPathes;
+    TTokenCache tokenCache;
     std::stack<TLexer *> lexerStack;
+    TCompiler::TStatistics statistics;
     
     bool errorFlag, bankActive;
     std::size_t bankCount;
@@ -11,6 +11,11 @@ const std::string
     
 std::uint16_t TConfig::startBank = 0;
 bool TConfig::omitHeader = false;
+std::size_t TConfig::inlineSize = 24;
+std::size_t TConfig::inlineArgumentSize = 6;
+bool TConfig::optimizeLoops = true;
+bool TConfig::optimizeCommonSubexpressions = true;
+bool TConfig::dumpSyntaxTree = false;
     
 TConfig::TTarget TConfig::target;
 
@@ -12,11 +12,16 @@ namespace statpascal {
 struct TConfig {
 #ifdef CREATE_9900
     static const std::size_t alignment = 2;
-    static std::uint16_t startBank;
-    static bool omitHeader;
 #else
     static const std::size_t alignment = std::min<std::size_t> (std::alignment_of<std::max_align_t> (), 8);
 #endif    
+    static std::uint16_t startBank;
+    static bool omitHeader;
+    static std::size_t inlineSize;		// max. number of nodes of an inlined routine body, 0 disables inlining
+    static std::size_t inlineArgumentSize;	// max. number of nodes of an argument used more than once in an inlined body
+    static bool optimizeLoops;			// moves invariant computations out of for loops
+    static bool optimizeCommonSubexpressions;	// evaluates repeated expressions of basic blocks once
+    static bool dumpSyntaxTree;			// writes the optimized syntax tree to standard output
     static const std::size_t setwords = 4;
     static const std::size_t setLimit = setwords * 8 * sizeof (std::int64_t);
     static const std::string globalRuntimeDataPtr; //  = "__globalruntimedata";
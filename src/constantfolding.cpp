@@ -0,0 +1,951 @@
+#include "constantfolding.hpp"
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+#include "predefined.hpp"
+#include "flowgraph.hpp"
+
+#include <bit>
+#include <map>
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+const std::size_t maxPasses = 8;
+
+// variable assigned, incremented or decremented by a statement
+
+TVariable *getStoredVariable (TStatement *statement) {
+    TExpressionBase *lValue = nullptr;
+    if (TAssignment *assignment = dynamic_cast<TAssignment *> (statement))
+        lValue = assignment->getLValue ();
+    else if (TRoutineCall *routineCall = dynamic_cast<TRoutineCall *> (statement))
+        if (TPredefinedRoutine *predefinedRoutine = dynamic_cast<TPredefinedRoutine *> (routineCall->getRoutineCall ()))
+            if (predefinedRoutine->getRoutine () == TPredefinedRoutine::Inc || predefinedRoutine->getRoutine () == TPredefinedRoutine::Dec)
+                lValue = predefinedRoutine->getArguments () [0];
+    return lValue && lValue->isSymbol () && !lValue->isReference () ? static_cast<TVariable *> (lValue) : nullptr;
+}
+
+// reads and writes of variables, labels and gotos in a part of a routine; a variable not
+// accessed through a dereference is written or has its address taken. Stores are the
+// writes by statements found by getStoredVariable.
+
+class TUsageCollector: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TReferenceVariable &) override;
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TRoutineCall &) override;
+    virtual void generateCode (TLabeledStatement &) override;
+    virtual void generateCode (TGotoStatement &) override;
+
+    std::map<const TSymbol *, std::size_t> reads, writes, stores, gotos;
+    std::set<const TSymbol *> labels;
+};
+
+void TUsageCollector::generateCode (TVariable &variable) {
+    ++writes [variable.getSymbol ()];
+}
+
+void TUsageCollector::generateCode (TReferenceVariable &referenceVariable) {
+    ++writes [referenceVariable.getSymbol ()];
+}
+
+void TUsageCollector::generateCode (TLValueDereference &lValueDereference) {
+    TExpressionBase *lValue = lValueDereference.getLValue ();
+    if (lValue->isSymbol ())
+        ++reads [static_cast<TVariable *> (lValue)->getSymbol ()];
+    else
+        inherited::generateCode (lValueDereference);
+}
+
+void TUsageCollector::generateCode (TAssignment &assignment) {
+    if (TVariable *variable = getStoredVariable (&assignment))
+        ++stores [variable->getSymbol ()];
+    inherited::generateCode (assignment);
+}
+
+void TUsageCollector::generateCode (TRoutineCall &routineCall) {
+    if (TVariable *variable = getStoredVariable (&routineCall))
+        ++stores [variable->getSymbol ()];
+    inherited::generateCode (routineCall);
+}
+
+void TUsageCollector::generateCode (TLabeledStatement &labeledStatement) {
+    labels.insert (labeledStatement.getLabel ());
+    inherited::generateCode (labeledStatement);
+}
+
+void TUsageCollector::generateCode (TGotoStatement &gotoStatement) {
+    ++gotos [gotoStatement.getLabel ()];
+    inherited::generateCode (gotoStatement);
+}
+
+
+// calls, pointer dereferences and integer divisions may have effects besides their value
+
+class TEffectFinder: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TPointerDereference &) override;
+    virtual void generateCode (TTerm &) override;
+
+    bool hasEffects = false;
+};
+
+void TEffectFinder::generateCode (TFunctionCall &) {
+    hasEffects = true;
+}
+
+void TEffectFinder::generateCode (TPointerDereference &) {
+    hasEffects = true;
+}
+
+void TEffectFinder::generateCode (TTerm &term) {
+    hasEffects |= term.getOperation () == TToken::DivInt || term.getOperation () == TToken::Mod;
+    inherited::generateCode (term);
+}
+
+
+// the size of integers depends on the target; real arithmetic is folded for IEEE doubles only
+
+std::size_t getIntegerBits () {
+    return 8 * stdType.Int64.getSize ();
+}
+
+bool isRealFolded () {
+    return TConfig::target == TConfig::TTarget::X64 || TConfig::target == TConfig::TTarget::AARCH64;
+}
+
+// shr is a logical shift on x64 and an arithmetic one on the other targets
+
+bool isShiftRightArithmetic () {
+    return TConfig::target != TConfig::TTarget::X64;
+}
+
+// x64 negates a real by subtracting it from zero: -(0.0) is 0.0 there
+
+double negateReal (double x) {
+    return TConfig::target == TConfig::TTarget::X64 ? 0.0 - x : -x;
+}
+
+std::int64_t normalizeInteger (std::uint64_t n) {
+    const std::size_t bits = getIntegerBits ();
+    if (bits < 64) {
+        const std::uint64_t mask = (std::uint64_t (1) << bits) - 1;
+        n &= mask;
+        if (n >> (bits - 1))
+            n |= ~mask;
+    }
+    return n;
+}
+
+bool foldInteger (TToken operation, std::int64_t a, std::int64_t b, std::int64_t &result) {
+    const std::size_t bits = getIntegerBits ();
+    const std::uint64_t ua = a, ub = b;
+    switch (operation) {
+        case TToken::Add:
+            result = normalizeInteger (ua + ub); break;
+        case TToken::Sub:
+            result = normalizeInteger (ua - ub); break;
+        case TToken::Mul:
+            result = normalizeInteger (ua * ub); break;
+        case TToken::And:
+            result = a & b; break;
+        case TToken::Or:
+            result = a | b; break;
+        case TToken::Xor:
+            result = a ^ b; break;
+        case TToken::DivInt:
+        case TToken::Mod:
+            // leave the run time error
+            if (!b || (b == -1 && a == normalizeInteger (std::uint64_t (1) << (bits - 1))))
+                return false;
+            result = operation == TToken::DivInt ? a / b : a % b;
+            break;
+        case TToken::Shl:
+        case TToken::Shr:
+            if (b < 0 || b >= static_cast<std::int64_t> (bits))
+                return false;
+            if (operation == TToken::Shl)
+                result = normalizeInteger (ua << b);
+            else if (isShiftRightArithmetic ())
+                result = a >> b;
+            else
+                result = normalizeInteger ((bits < 64 ? ua & ((std::uint64_t (1) << bits) - 1) : ua) >> b);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool foldReal (TToken operation, double a, double b, double &result) {
+    switch (operation) {
+        case TToken::Add:
+            result = a + b; break;
+        case TToken::Sub:
+            result = a - b; break;
+        case TToken::Mul:
+            result = a * b; break;
+        case TToken::Div:
+            result = a / b; break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+template<typename T> bool foldComparison (TToken operation, T a, T b, bool &result) {
+    switch (operation) {
+        case TToken::Equal:
+            result = a == b; break;
+        case TToken::NotEqual:
+            result = a != b; break;
+        case TToken::LessThan:
+            result = a < b; break;
+        case TToken::LessEqual:
+            result = a <= b; break;
+        case TToken::GreaterThan:
+            result = a > b; break;
+        case TToken::GreaterEqual:
+            result = a >= b; break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+const TSimpleConstant *getConstant (const TExpressionBase *expression) {
+    return expression && expression->isConstant () ? static_cast<const TConstantValue *> (expression)->getConstant () : nullptr;
+}
+
+// Int64 and its subranges like integer
+
+bool isIntegerType (const TType *type) {
+    return type == &stdType.Int64 || (type->isSubrange () && type->getBaseType () == &stdType.Int64);
+}
+
+bool isPropagatedType (const TType *type) {
+    return isIntegerType (type) || type == &stdType.Boolean || type == &stdType.Char || type == &stdType.Real;
+}
+
+
+// Conditional constant propagation over the flow graph of a routine: the values of the
+// variables at the start of each node are computed following only the branches which
+// may be taken with the values found so far. Reads of a variable with a constant value
+// are replaced. The variables must be changed by assignments, inc and dec only.
+
+const std::size_t maxPropagationSize = 1 << 20;	// nodes times variables
+
+class TConstantPropagator: public TSyntaxTreeRewriter {
+using inherited = TSyntaxTreeRewriter;
+public:
+    TConstantPropagator (TBlock &block, const std::vector<const TSymbol *> &variables);
+
+    // returns true if a read was replaced
+    bool optimize ();
+
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TPointerDereference &) override;
+
+protected:
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *) override;
+
+private:
+    // reals are kept as their bit pattern
+    struct TValue {
+        enum class TState {Undefined, Constant, Varying} state;
+        std::int64_t n;
+    };
+    using TValues = std::vector<TValue>;
+
+    static TValue createInteger (std::int64_t);
+    static TValue createReal (double);
+    static TValue createVarying ();
+
+    TValue evaluate (TExpressionBase *, const TValues &) const;
+    TValue evaluateOperation (TExpressionBase *left, TExpressionBase *right, TToken operation, const TType *type, const TValues &) const;
+    TValue evaluateComparison (TExpression &, const TValues &) const;
+    TValue evaluatePrefix (TPrefixedExpression &, const TValues &) const;
+    TValue evaluateTypeCast (TTypeCast &, const TValues &) const;
+    TValue evaluatePredefined (TPredefinedRoutine &, const TValues &) const;
+    TValue convert (TValue, const TType *type, const TType *sourceType) const;
+    const TValue *getValue (TExpressionBase *lValue, const TValues &) const;
+
+    void transfer (TStatement *, TValues &) const;
+    std::vector<std::size_t> getSuccessors (const TFlowGraph::TNode &, const TValues &) const;
+    static bool join (TValues &, const TValues &);
+    void rewriteNode (TStatement *);
+
+    TBlock &block;
+    std::map<const TSymbol *, std::size_t> variables;
+    TSharedExpressionCollector sharedExpressions;
+    const TValues *values;
+    bool changed;
+};
+
+TConstantPropagator::TConstantPropagator (TBlock &block, const std::vector<const TSymbol *> &variables):
+  block (block), values (nullptr), changed (false) {
+    for (const TSymbol *s: variables)
+        this->variables.insert ({s, this->variables.size ()});
+}
+
+bool TConstantPropagator::optimize () {
+    if (variables.empty ())
+        return false;
+    TFlowGraph flowGraph (block.getStatements ());
+    const std::vector<TFlowGraph::TNode> &nodes = flowGraph.getNodes ();
+    if (!flowGraph.isValid () || nodes.size () * variables.size () > maxPropagationSize)
+        return false;
+
+    // the values at the start of the nodes; empty if the node is not reached
+    std::vector<TValues> entries (nodes.size ());
+    std::vector<bool> queued (nodes.size ());
+    std::vector<std::size_t> worklist {flowGraph.getEntryNode ()};
+    entries [flowGraph.getEntryNode ()] = TValues (variables.size (), createVarying ());
+    while (!worklist.empty ()) {
+        const std::size_t node = worklist.back ();
+        worklist.pop_back ();
+        queued [node] = false;
+        TValues values = entries [node];
+        transfer (nodes [node].statement, values);
+        for (std::size_t successor: getSuccessors (nodes [node], entries [node]))
+            if (join (entries [successor], values) && !queued [successor]) {
+                queued [successor] = true;
+                worklist.push_back (successor);
+            }
+    }
+
+    sharedExpressions.visit (block.getStatements ());
+    for (std::size_t node = 0; node < nodes.size (); ++node)
+        if (nodes [node].statement && !entries [node].empty ()) {
+            values = &entries [node];
+            rewriteNode (nodes [node].statement);
+        }
+    values = nullptr;
+    return changed;
+}
+
+// The record of a with-statement is shared by the accesses of its fields; the values
+// are valid at one node only.
+
+void TConstantPropagator::generateCode (TArrayIndex &arrayIndex) {
+    if (!sharedExpressions.shared.count (&arrayIndex))
+        inherited::generateCode (arrayIndex);
+}
+
+void TConstantPropagator::generateCode (TRecordComponent &recordComponent) {
+    if (!sharedExpressions.shared.count (&recordComponent))
+        inherited::generateCode (recordComponent);
+}
+
+void TConstantPropagator::generateCode (TPointerDereference &pointerDereference) {
+    if (!sharedExpressions.shared.count (&pointerDereference))
+        inherited::generateCode (pointerDereference);
+}
+
+TExpressionBase *TConstantPropagator::rewriteExpression (TExpressionBase *expression) {
+    if (expression->isLValueDereference ())
+        if (const TValue *value = getValue (static_cast<TLValueDereference *> (expression)->getLValue (), *values))
+            if (value->state == TValue::TState::Constant) {
+                changed = true;
+                if (expression->getType () == &stdType.Real)
+                    return TExpressionBase::createConstant (std::bit_cast<double> (value->n), &stdType.Real, block);
+                return TExpressionBase::createConstant (value->n, expression->getType (), block);
+            }
+    return expression;
+}
+
+TConstantPropagator::TValue TConstantPropagator::createInteger (std::int64_t n) {
+    return TValue {TValue::TState::Constant, n};
+}
+
+TConstantPropagator::TValue TConstantPropagator::createReal (double v) {
+    return TValue {TValue::TState::Constant, std::bit_cast<std::int64_t> (v)};
+}
+
+TConstantPropagator::TValue TConstantPropagator::createVarying () {
+    return TValue {TValue::TState::Varying, 0};
+}
+
+// The operations are evaluated like they are folded by TFolder.
+
+TConstantPropagator::TValue TConstantPropagator::evaluate (TExpressionBase *expression, const TValues &values) const {
+    if (const TSimpleConstant *c = getConstant (expression)) {
+        if (expression->getType () == &stdType.Real)
+            return isRealFolded () ? createReal (c->getDouble ()) : createVarying ();
+        return expression->getType ()->isEnumerated () ? createInteger (c->getInteger ()) : createVarying ();
+    }
+    if (expression->isLValueDereference ()) {
+        const TValue *value = getValue (static_cast<TLValueDereference *> (expression)->getLValue (), values);
+        return value ? *value : createVarying ();
+    }
+    if (TExpression *comparison = dynamic_cast<TExpression *> (expression))
+        return evaluateComparison (*comparison, values);
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return evaluateOperation (simpleExpression->getLeftExpression (), simpleExpression->getRightExpression (), simpleExpression->getOperation (), expression->getType (), values);
+    if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return evaluateOperation (term->getLeftExpression (), term->getRightExpression (), term->getOperation (), expression->getType (), values);
+    if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        return evaluatePrefix (*prefixedExpression, values);
+    if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression))
+        return evaluateTypeCast (*typeCast, values);
+    if (TPredefinedRoutine *predefinedRoutine = dynamic_cast<TPredefinedRoutine *> (expression))
+        return evaluatePredefined (*predefinedRoutine, values);
+    return createVarying ();
+}
+
+TConstantPropagator::TValue TConstantPropagator::evaluateOperation (TExpressionBase *left, TExpressionBase *right, TToken operation, const TType *type, const TValues &values) const {
+    const TValue a = evaluate (left, values), b = evaluate (right, values);
+    if (a.state == TValue::TState::Undefined || b.state == TValue::TState::Undefined)
+        return TValue {TValue::TState::Undefined, 0};
+    if (a.state != TValue::TState::Constant || b.state != TValue::TState::Constant)
+        return createVarying ();
+    if (type == &stdType.Int64) {
+        std::int64_t result;
+        if (foldInteger (operation, a.n, b.n, result))
+            return createInteger (result);
+    } else if (type == &stdType.Boolean) {
+        std::int64_t result;
+        if ((operation == TToken::And || operation == TToken::Or || operation == TToken::Xor) && foldInteger (operation, a.n, b.n, result))
+            return createInteger (result);
+    } else if (type == &stdType.Real && left->getType () == &stdType.Real && right->getType () == &stdType.Real && isRealFolded ()) {
+        double result;
+        if (foldReal (operation, std::bit_cast<double> (a.n), std::bit_cast<double> (b.n), result))
+            return createReal (result);
+    }
+    return createVarying ();
+}
+
+TConstantPropagator::TValue TConstantPropagator::evaluateComparison (TExpression &comparison, const TValues &values) const {
+    const TValue a = evaluate (comparison.getLeftExpression (), values), b = evaluate (comparison.getRightExpression (), values);
+    const TType *typeA = comparison.getLeftExpression ()->getType (), *typeB = comparison.getRightExpression ()->getType ();
+    if (a.state == TValue::TState::Undefined || b.state == TValue::TState::Undefined)
+        return TValue {TValue::TState::Undefined, 0};
+    if (a.state != TValue::TState::Constant || b.state != TValue::TState::Constant)
+        return createVarying ();
+    bool result;
+    if (typeA == &stdType.Real && typeB == &stdType.Real && isRealFolded ()) {
+        if (foldComparison (comparison.getOperation (), std::bit_cast<double> (a.n), std::bit_cast<double> (b.n), result))
+            return createInteger (result);
+    } else if (typeA->isEnumerated () && typeB->isEnumerated ())
+        if (foldComparison (comparison.getOperation (), a.n, b.n, result))
+            return createInteger (result);
+    return createVarying ();
+}
+
+TConstantPropagator::TValue TConstantPropagator::evaluatePrefix (TPrefixedExpression &prefixedExpression, const TValues &values) const {
+    const TValue a = evaluate (prefixedExpression.getExpression (), values);
+    const TType *type = prefixedExpression.getType ();
+    if (a.state != TValue::TState::Constant)
+        return a;
+    if (prefixedExpression.getOperation () == TToken::Sub) {
+        if (type == &stdType.Int64)
+            return createInteger (normalizeInteger (-static_cast<std::uint64_t> (a.n)));
+        if (type == &stdType.Real && isRealFolded ())
+            return createReal (negateReal (std::bit_cast<double> (a.n)));
+    } else if (prefixedExpression.getOperation () == TToken::Not) {
+        if (type == &stdType.Int64)
+            return createInteger (~a.n);
+        if (type == &stdType.Boolean)
+            return createInteger (!a.n);
+    }
+    return createVarying ();
+}
+
+TConstantPropagator::TValue TConstantPropagator::evaluateTypeCast (TTypeCast &typeCast, const TValues &values) const {
+    return convert (evaluate (typeCast.getExpression (), values), typeCast.getType (), typeCast.getExpression ()->getType ());
+}
+
+TConstantPropagator::TValue TConstantPropagator::evaluatePredefined (TPredefinedRoutine &predefinedRoutine, const TValues &values) const {
+    const std::vector<TExpressionBase *> &args = predefinedRoutine.getArguments ();
+    if (args.size () != 1 || args [0]->getType () != &stdType.Int64)
+        return createVarying ();
+    const TValue a = evaluate (args [0], values);
+    if (a.state != TValue::TState::Constant)
+        return a;
+    switch (predefinedRoutine.getRoutine ()) {
+        case TPredefinedRoutine::Odd:
+            return createInteger (a.n & 1);
+        case TPredefinedRoutine::Succ:
+        case TPredefinedRoutine::Pred:
+            if (predefinedRoutine.getType () == &stdType.Int64)
+                return createInteger (normalizeInteger (a.n + (predefinedRoutine.getRoutine () == TPredefinedRoutine::Succ ? 1 : -1)));
+            break;
+        default:
+            break;
+    }
+    return createVarying ();
+}
+
+// conversion by a type cast or an assignment; integers are converted if the value is in range
+
+TConstantPropagator::TValue TConstantPropagator::convert (TValue value, const TType *type, const TType *sourceType) const {
+    if (value.state != TValue::TState::Constant || type == sourceType)
+        return value;
+    if (isIntegerType (sourceType)) {
+        if (isIntegerType (type)) {
+            const TEnumeratedType *enumeratedType = static_cast<const TEnumeratedType *> (type);
+            if (enumeratedType->getMinVal () <= value.n && value.n <= enumeratedType->getMaxVal ())
+                return value;
+        } else if (type == &stdType.Real && isRealFolded ())
+            return createReal (value.n);
+    }
+    return createVarying ();
+}
+
+// value of a variable propagated; nullptr for other lValues
+
+const TConstantPropagator::TValue *TConstantPropagator::getValue (TExpressionBase *lValue, const TValues &values) const {
+    if (!lValue->isSymbol () || lValue->isReference ())
+        return nullptr;
+    std::map<const TSymbol *, std::size_t>::const_iterator it = variables.find (static_cast<TVariable *> (lValue)->getSymbol ());
+    return it == variables.end () ? nullptr : &values [it->second];
+}
+
+void TConstantPropagator::transfer (TStatement *statement, TValues &values) const {
+    if (TVariable *variable = statement ? getStoredVariable (statement) : nullptr) {
+        std::map<const TSymbol *, std::size_t>::const_iterator it = variables.find (variable->getSymbol ());
+        if (it != variables.end ()) {
+            TValue value = createVarying ();
+            if (TAssignment *assignment = dynamic_cast<TAssignment *> (statement))
+                value = convert (evaluate (assignment->getExpression (), values), variable->getType (), assignment->getExpression ()->getType ());
+            values [it->second] = value;
+        }
+    }
+}
+
+std::vector<std::size_t> TConstantPropagator::getSuccessors (const TFlowGraph::TNode &node, const TValues &values) const {
+    TExpressionBase *condition = nullptr;
+    if (TIfStatement *ifStatement = dynamic_cast<TIfStatement *> (node.statement))
+        condition = ifStatement->getCondition ();
+    else if (TGotoStatement *gotoStatement = dynamic_cast<TGotoStatement *> (node.statement))
+        condition = gotoStatement->getCondition ();
+    else if (TCaseStatement *caseStatement = dynamic_cast<TCaseStatement *> (node.statement)) {
+        const TValue value = evaluate (caseStatement->getExpression (), values);
+        if (value.state == TValue::TState::Undefined)
+            return {};
+        if (value.state == TValue::TState::Varying)
+            return node.successors;
+        const TCaseStatement::TCaseList &caseList = caseStatement->getCaseList ();
+        for (std::size_t i = 0; i < caseList.size (); ++i)
+            for (const TCaseStatement::TLabel &label: caseList [i].labels)
+                if (label.a <= value.n && value.n <= label.b)
+                    return {node.successors [i]};
+        return {node.successors.back ()};
+    }
+    if (!condition)
+        return node.successors;
+    const TValue value = evaluate (condition, values);
+    if (value.state == TValue::TState::Undefined)
+        return {};
+    if (value.state == TValue::TState::Varying)
+        return node.successors;
+    return {node.successors [value.n ? 0 : 1]};
+}
+
+bool TConstantPropagator::join (TValues &values, const TValues &other) {
+    if (values.empty ()) {
+        values = other;
+        return true;
+    }
+    bool changed = false;
+    for (std::size_t i = 0; i < values.size (); ++i)
+        if (other [i].state != TValue::TState::Undefined && values [i].state != TValue::TState::Varying) {
+            if (values [i].state == TValue::TState::Undefined)
+                values [i] = other [i];
+            else if (other [i].state == TValue::TState::Varying || other [i].n != values [i].n)
+                values [i] = createVarying ();
+            else
+                continue;
+            changed = true;
+        }
+    return changed;
+}
+
+// replaces the reads of a node; the branches of if and case statements are nodes of their own
+
+void TConstantPropagator::rewriteNode (TStatement *statement) {
+    if (TIfStatement *ifStatement = dynamic_cast<TIfStatement *> (statement))
+        rewrite (getCondition (*ifStatement));
+    else if (TGotoStatement *gotoStatement = dynamic_cast<TGotoStatement *> (statement))
+        rewrite (getCondition (*gotoStatement));
+    else if (TCaseStatement *caseStatement = dynamic_cast<TCaseStatement *> (statement))
+        rewrite (getExpression (*caseStatement));
+    else if (!dynamic_cast<TLabeledStatement *> (statement))
+        visit (statement);
+}
+
+
+class TFolder: public TSyntaxTreeRewriter {
+using inherited = TSyntaxTreeRewriter;
+public:
+    TFolder (TBlock &block, const std::set<const TSymbol *> &nonLocal);
+
+    // one pass over the routine; returns true if the routine was changed
+    bool optimize ();
+
+    virtual void generateCode (TStatementSequence &) override;
+
+protected:
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *) override;
+    virtual TStatement *rewriteStatement (TStatement *) override;
+
+private:
+    TExpressionBase *foldExpression (TExpressionBase *);
+    TExpressionBase *foldOperation (TExpressionBase *left, TExpressionBase *right, TToken operation, TType *type);
+    TExpressionBase *foldPrefix (TPrefixedExpression &);
+    TExpressionBase *foldTypeCast (TTypeCast &);
+    TExpressionBase *foldPredefined (TPredefinedRoutine &);
+    TExpressionBase *createInteger (std::int64_t, TType *);
+    TExpressionBase *createReal (double);
+
+    TStatement *foldStatement (TStatement *);
+    TStatement *createEmptyStatement ();
+    bool canRemove (TStatement *);
+    bool removeEmptyStatements (std::vector<TStatement *> &);
+
+    bool isLocalScalar (const TSymbol *) const;
+    bool isDeadStore (TStatement *);
+    bool propagateConstants ();
+    TExpressionBase *getPropagatedValue (TAssignment &, const TUsageCollector &);
+
+    TBlock &block;
+    const std::set<const TSymbol *> &nonLocal;
+    const TSymbol *resultSymbol;
+    TUsageCollector routineUsage;
+    std::map<const TSymbol *, TExpressionBase *> values;
+    bool changed;
+};
+
+TFolder::TFolder (TBlock &block, const std::set<const TSymbol *> &nonLocal):
+  block (block), nonLocal (nonLocal), resultSymbol (nullptr), changed (false) {
+    if (block.returnLValueDeref)
+        if (TVariable *result = dynamic_cast<TVariable *> (static_cast<TLValueDereference *> (block.returnLValueDeref)->getLValue ()))
+            resultSymbol = result->getSymbol ();
+}
+
+TExpressionBase *TFolder::createInteger (std::int64_t n, TType *type) {
+    return TExpressionBase::createConstant (n, type, block);
+}
+
+TExpressionBase *TFolder::createReal (double v) {
+    return TExpressionBase::createConstant (v, &stdType.Real, block);
+}
+
+TStatement *TFolder::createEmptyStatement () {
+    return block.getCompiler ().createMemoryPoolObject<TEmptyStatement> ();
+}
+
+TExpressionBase *TFolder::rewriteExpression (TExpressionBase *expression) {
+    if (TExpressionBase *result = foldExpression (expression)) {
+        changed = true;
+        return result;
+    }
+    return expression;
+}
+
+TStatement *TFolder::rewriteStatement (TStatement *statement) {
+    TStatement *result = foldStatement (statement);
+    changed |= result != statement;
+    return result;
+}
+
+// returns nullptr if the expression is not changed
+
+TExpressionBase *TFolder::foldExpression (TExpressionBase *expression) {
+    if (TLValueDereference *lValueDereference = dynamic_cast<TLValueDereference *> (expression)) {
+        TExpressionBase *lValue = lValueDereference->getLValue ();
+        if (lValue->isSymbol ()) {
+            std::map<const TSymbol *, TExpressionBase *>::iterator it = values.find (static_cast<TVariable *> (lValue)->getSymbol ());
+            if (it != values.end ())
+                return it->second;
+        }
+    } else if (TExpression *comparison = dynamic_cast<TExpression *> (expression)) {
+        const TSimpleConstant *a = getConstant (comparison->getLeftExpression ()), *b = getConstant (comparison->getRightExpression ());
+        const TType *typeA = comparison->getLeftExpression ()->getType (), *typeB = comparison->getRightExpression ()->getType ();
+        bool result;
+        if (a && b && typeA == &stdType.Real && typeB == &stdType.Real && isRealFolded ()) {
+            if (foldComparison (comparison->getOperation (), a->getDouble (), b->getDouble (), result))
+                return createInteger (result, &stdType.Boolean);
+        } else if (a && b && typeA->isEnumerated () && typeB->isEnumerated ())
+            if (foldComparison (comparison->getOperation (), a->getInteger (), b->getInteger (), result))
+                return createInteger (result, &stdType.Boolean);
+    } else if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return foldOperation (simpleExpression->getLeftExpression (), simpleExpression->getRightExpression (), simpleExpression->getOperation (), expression->getType ());
+    else if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return foldOperation (term->getLeftExpression (), term->getRightExpression (), term->getOperation (), expression->getType ());
+    else if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        return foldPrefix (*prefixedExpression);
+    else if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression))
+        return foldTypeCast (*typeCast);
+    else if (TPredefinedRoutine *predefinedRoutine = dynamic_cast<TPredefinedRoutine *> (expression))
+        return foldPredefined (*predefinedRoutine);
+    return nullptr;
+}
+
+TExpressionBase *TFolder::foldOperation (TExpressionBase *left, TExpressionBase *right, TToken operation, TType *type) {
+    const TSimpleConstant *a = getConstant (left), *b = getConstant (right);
+    if (!a || !b)
+        return nullptr;
+    if (type == &stdType.Int64) {
+        std::int64_t result;
+        if (foldInteger (operation, a->getInteger (), b->getInteger (), result))
+            return createInteger (result, type);
+    } else if (type == &stdType.Boolean) {
+        if (operation == TToken::And || operation == TToken::Or || operation == TToken::Xor) {
+            std::int64_t result;
+            foldInteger (operation, a->getInteger (), b->getInteger (), result);
+            return createInteger (result, type);
+        }
+    } else if (type == &stdType.Real && left->getType () == &stdType.Real && right->getType () == &stdType.Real && isRealFolded ()) {
+        double result;
+        if (foldReal (operation, a->getDouble (), b->getDouble (), result))
+            return createReal (result);
+    }
+    return nullptr;
+}
+
+TExpressionBase *TFolder::foldPrefix (TPrefixedExpression &prefixedExpression) {
+    const TSimpleConstant *a = getConstant (prefixedExpression.getExpression ());
+    TType *type = prefixedExpression.getType ();
+    if (!a)
+        return nullptr;
+    if (prefixedExpression.getOperation () == TToken::Sub) {
+        if (type == &stdType.Int64)
+            return createInteger (normalizeInteger (-static_cast<std::uint64_t> (a->getInteger ())), type);
+        if (type == &stdType.Real && isRealFolded ())
+            return createReal (negateReal (a->getDouble ()));
+    } else if (prefixedExpression.getOperation () == TToken::Not) {
+        if (type == &stdType.Int64)
+            return createInteger (~a->getInteger (), type);
+        if (type == &stdType.Boolean)
+            return createInteger (!a->getInteger (), type);
+    }
+    return nullptr;
+}
+
+TExpressionBase *TFolder::foldTypeCast (TTypeCast &typeCast) {
+    const TSimpleConstant *a = getConstant (typeCast.getExpression ());
+    TType *type = typeCast.getType (), *sourceType = typeCast.getExpression ()->getType ();
+    if (!a || !isIntegerType (sourceType))
+        return nullptr;
+    // conversions between integer types are folded if the value is in range
+    if (isIntegerType (type)) {
+        const TEnumeratedType *enumeratedType = static_cast<const TEnumeratedType *> (type);
+        if (enumeratedType->getMinVal () <= a->getInteger () && a->getInteger () <= enumeratedType->getMaxVal ())
+            return createInteger (a->getInteger (), type);
+    } else if (type == &stdType.Real && isRealFolded ())
+        return createReal (a->getInteger ());
+    return nullptr;
+}
+
+TExpressionBase *TFolder::foldPredefined (TPredefinedRoutine &predefinedRoutine) {
+    const std::vector<TExpressionBase *> &args = predefinedRoutine.getArguments ();
+    const TSimpleConstant *a = args.size () == 1 ? getConstant (args [0]) : nullptr;
+    if (!a || args [0]->getType () != &stdType.Int64)
+        return nullptr;
+    switch (predefinedRoutine.getRoutine ()) {
+        case TPredefinedRoutine::Odd:
+            return createInteger (a->getInteger () & 1, &stdType.Boolean);
+        case TPredefinedRoutine::Succ:
+        case TPredefinedRoutine::Pred:
+            if (predefinedRoutine.getType () == &stdType.Int64)
+                return createInteger (normalizeInteger (a->getInteger () + (predefinedRoutine.getRoutine () == TPredefinedRoutine::Succ ? 1 : -1)), &stdType.Int64);
+            break;
+        default:
+            break;
+    }
+    return nullptr;
+}
+
+TStatement *TFolder::foldStatement (TStatement *statement) {
+    if (TIfStatement *ifStatement = dynamic_cast<TIfStatement *> (statement)) {
+        if (const TSimpleConstant *c = getConstant (ifStatement->getCondition ())) {
+            TStatement *taken = c->getInteger () ? ifStatement->getStatement1 () : ifStatement->getStatement2 (),
+                       *removed = c->getInteger () ? ifStatement->getStatement2 () : ifStatement->getStatement1 ();
+            if (canRemove (removed))
+                return taken ? taken : createEmptyStatement ();
+        }
+    } else if (TGotoStatement *gotoStatement = dynamic_cast<TGotoStatement *> (statement)) {
+        if (const TSimpleConstant *c = getConstant (gotoStatement->getCondition ())) {
+            if (c->getInteger ())
+                return block.getCompiler ().createMemoryPoolObject<TGotoStatement> (gotoStatement->getLabel ());
+            return createEmptyStatement ();
+        }
+    } else if (isDeadStore (statement))
+        return createEmptyStatement ();
+    else if (TCaseStatement *caseStatement = dynamic_cast<TCaseStatement *> (statement))
+        if (const TSimpleConstant *c = getConstant (caseStatement->getExpression ())) {
+            const std::int64_t n = c->getInteger ();
+            TStatement *taken = caseStatement->getDefaultStatement ();
+            for (const TCaseStatement::TCase &it: caseStatement->getCaseList ())
+                for (const TCaseStatement::TLabel &label: it.labels)
+                    if (label.a <= n && n <= label.b)
+                        taken = it.statement;
+            bool removable = taken == caseStatement->getDefaultStatement () || canRemove (caseStatement->getDefaultStatement ());
+            for (const TCaseStatement::TCase &it: caseStatement->getCaseList ())
+                removable = removable && (it.statement == taken || canRemove (it.statement));
+            if (removable)
+                return taken ? taken : createEmptyStatement ();
+        }
+    return statement;
+}
+
+// a statement can be removed if all gotos to its labels are within the statement
+
+bool TFolder::canRemove (TStatement *statement) {
+    TUsageCollector usage;
+    usage.visit (statement);
+    for (const TSymbol *label: usage.labels)
+        if (usage.gotos [label] != routineUsage.gotos [label])
+            return false;
+    return true;
+}
+
+bool TFolder::removeEmptyStatements (std::vector<TStatement *> &statements) {
+    const std::size_t size = statements.size ();
+    std::erase_if (statements, [] (TStatement *statement) { return dynamic_cast<TEmptyStatement *> (statement); });
+    return statements.size () != size;
+}
+
+void TFolder::generateCode (TStatementSequence &statementSequence) {
+    inherited::generateCode (statementSequence);
+    changed |= removeEmptyStatements (getStatements (statementSequence));
+}
+
+bool TFolder::isLocalScalar (const TSymbol *s) const {
+    return s->getLevel () == block.getSymbols ().getLevel () && s != resultSymbol && !s->isAliased () && !nonLocal.count (s) &&
+        (s->checkSymbolFlag (TSymbol::Variable) || s->checkSymbolFlag (TSymbol::Parameter)) &&
+        !s->checkSymbolFlag (TSymbol::Alias) && !s->checkSymbolFlag (TSymbol::Absolute) && isPropagatedType (s->getType ());
+}
+
+// a store to a local variable which is never read and not written otherwise
+
+bool TFolder::isDeadStore (TStatement *statement) {
+    TVariable *variable = getStoredVariable (statement);
+    if (!variable)
+        return false;
+    const TSymbol *s = variable->getSymbol ();
+    if (!isLocalScalar (s) || routineUsage.reads.count (s) || routineUsage.writes [s] != routineUsage.stores [s])
+        return false;
+    TEffectFinder effects;
+    effects.visit (statement);
+    return !effects.hasEffects;
+}
+
+// value of a variable assigned once: a constant or a variable which is not modified
+
+TExpressionBase *TFolder::getPropagatedValue (TAssignment &assignment, const TUsageCollector &usage) {
+    TExpressionBase *lValue = assignment.getLValue (), *expression = assignment.getExpression ();
+    if (!lValue->isSymbol () || lValue->isReference ())
+        return nullptr;
+    const TSymbol *s = static_cast<TVariable *> (lValue)->getSymbol ();
+    if (!isLocalScalar (s) || usage.writes.at (s) != 1 || expression->getType () != s->getType ())
+        return nullptr;
+    if (expression->isConstant ())
+        return expression;
+    if (expression->isLValueDereference ()) {
+        TExpressionBase *source = static_cast<TLValueDereference *> (expression)->getLValue ();
+        if (source->isSymbol () && !source->isReference ()) {
+            const TSymbol *t = static_cast<TVariable *> (source)->getSymbol ();
+            if (t != s && isLocalScalar (t) && !usage.writes.count (t))
+                return expression;
+        }
+    }
+    return nullptr;
+}
+
+// Values are propagated from assignments in the outermost statement sequence which are
+// not preceeded by a label: they are executed before all following statements.
+
+bool TFolder::optimize () {
+    TStatementSequence *body = dynamic_cast<TStatementSequence *> (block.getStatements ());
+    if (!body)
+        return false;
+    std::vector<TStatement *> &statements = getStatements (*body);
+
+    routineUsage = TUsageCollector ();
+    routineUsage.visit (body);
+    changed = false;
+    values.clear ();
+
+    std::vector<std::size_t> assignments;
+    bool labelSeen = false;
+    for (std::size_t i = 0; i < statements.size (); ++i) {
+        rewrite (statements [i]);
+        if (!labelSeen)
+            if (TAssignment *assignment = dynamic_cast<TAssignment *> (statements [i]))
+                if (TExpressionBase *value = getPropagatedValue (*assignment, routineUsage)) {
+                    values [static_cast<TVariable *> (assignment->getLValue ())->getSymbol ()] = value;
+                    assignments.push_back (i);
+                }
+        TUsageCollector usage;
+        usage.visit (statements [i]);
+        labelSeen |= !usage.labels.empty ();
+    }
+    values.clear ();
+
+    // remove the assignments no longer used
+    TUsageCollector usage;
+    usage.visit (body);
+    for (std::size_t i: assignments)
+        if (!usage.reads.count (static_cast<TVariable *> (static_cast<TAssignment *> (statements [i])->getLValue ())->getSymbol ())) {
+            statements [i] = createEmptyStatement ();
+            changed = true;
+        }
+    removeEmptyStatements (statements);
+    return propagateConstants () || changed;
+}
+
+// local scalar variables changed only by assignments, inc and dec
+
+bool TFolder::propagateConstants () {
+    TUsageCollector usage;
+    usage.visit (block.getStatements ());
+    std::vector<const TSymbol *> variables;
+    for (const std::pair<const TSymbol *const, std::size_t> &it: usage.stores)
+        if (isLocalScalar (it.first) && usage.writes [it.first] == it.second)
+            variables.push_back (it.first);
+    return TConstantPropagator (block, variables).optimize ();
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ()) {
+            blocks.push_back (s->getBlock ());
+            collectBlocks (*s->getBlock (), blocks);
+        }
+}
+
+}
+
+void TConstantFolding::optimize (TBlock &programBlock) {
+    std::vector<TBlock *> blocks {&programBlock};
+    collectBlocks (programBlock, blocks);
+
+    // variables used by nested routines
+    std::set<const TSymbol *> nonLocal;
+    for (TBlock *block: blocks) {
+        TUsageCollector usage;
+        usage.visit (block->getStatements ());
+        const std::size_t level = block->getSymbols ().getLevel ();
+        for (const std::map<const TSymbol *, std::size_t> *m: {&usage.reads, &usage.writes})
+            for (const std::pair<const TSymbol *const, std::size_t> &it: *m)
+                if (it.first->getLevel () < level)
+                    nonLocal.insert (it.first);
+    }
+
+    for (TBlock *block: blocks) {
+        TFolder folder (*block, nonLocal);
+        for (std::size_t pass = 0; pass < maxPasses && folder.optimize (); ++pass);
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+/** \file constantfolding.hpp
+
+    Simplifies the routine bodies before code is generated:
+
+    - arithmetic, comparisons and the predefined functions odd, succ and pred
+      are evaluated if their operands are constant
+    - branches of if, case and conditional goto statements which cannot be taken
+      are removed
+    - a local scalar variable which is assigned once in the outermost statement
+      sequence of its routine and not modified anywhere else is replaced by the
+      assigned constant or by the value parameter or variable it was copied from.
+      The uses following the assignment are replaced; the assignment is removed
+      if no use is left.
+    - assignments, increments and decrements of a local scalar variable which is
+      never read are removed unless they call a routine, dereference a pointer or
+      divide integers.
+    - a read of a local scalar variable changed only by assignments, inc and dec is
+      replaced by a constant if the variable has the same constant value on all paths
+      reaching it in the flow graph of the routine. Paths through branches found not
+      to be taken with the values computed so far are ignored, so a variable keeps a
+      constant value in a loop which assigns it only in such a branch.
+*/
+
+#pragma once
+
+namespace statpascal {
+
+class TBlock;
+
+class TConstantFolding final {
+public:
+    /** optimizes the program block and all routines */
+    static void optimize (TBlock &programBlock);
+};
+
+}
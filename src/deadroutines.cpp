@@ -0,0 +1,92 @@
+#include "deadroutines.hpp"
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+class TRoutineReferences: public TSyntaxTreeWalker {
+public:
+    virtual void generateCode (TConstantValue &) override;
+    virtual void generateCode (TRoutineValue &) override;
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TReferenceVariable &) override;
+
+    void addConstant (const TConstant *);
+    // follows absolute declarations to the routine
+    void addSymbol (TSymbol *);
+
+    std::vector<TSymbol *> routines;
+};
+
+void TRoutineReferences::generateCode (TConstantValue &constantValue) {
+    addConstant (constantValue.getConstant ());
+}
+
+void TRoutineReferences::generateCode (TRoutineValue &routineValue) {
+    addSymbol (routineValue.getSymbol ());
+}
+
+void TRoutineReferences::generateCode (TVariable &variable) {
+    addSymbol (variable.getSymbol ());
+}
+
+void TRoutineReferences::generateCode (TReferenceVariable &referenceVariable) {
+    addSymbol (referenceVariable.getSymbol ());
+}
+
+void TRoutineReferences::addConstant (const TConstant *constant) {
+    if (const TSimpleConstant *simpleConstant = dynamic_cast<const TSimpleConstant *> (constant)) {
+        if (simpleConstant->getType () && simpleConstant->getType ()->isRoutine () && simpleConstant->getRoutineValue ())
+            addSymbol (simpleConstant->getRoutineValue ()->getSymbol ());
+    } else if (const TArrayConstant *arrayConstant = dynamic_cast<const TArrayConstant *> (constant)) {
+        for (const TConstant *c: arrayConstant->getValues ())
+            addConstant (c);
+    } else if (const TRecordConstant *recordConstant = dynamic_cast<const TRecordConstant *> (constant))
+        for (const TRecordConstant::TRecordValue &value: recordConstant->getValues ())
+            addConstant (value.c);
+}
+
+void TRoutineReferences::addSymbol (TSymbol *s) {
+    for (; s; s = s->getAlias ())
+        if (s->checkSymbolFlag (TSymbol::Routine))
+            routines.push_back (s);
+}
+
+bool isGeneratedRoutine (const TSymbol *s) {
+    return s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ();
+}
+
+}
+
+TDeadRoutineElimination::TResult TDeadRoutineElimination::optimize (TBlock &programBlock) {
+    std::set<const TSymbol *> reachable;
+    std::vector<TBlock *> blocks {&programBlock};
+    for (std::size_t i = 0; i < blocks.size (); ++i) {
+        TRoutineReferences references;
+        for (const TSymbol *s: blocks [i]->getSymbols ())
+            if (s->checkSymbolFlag (TSymbol::StaticVariable))
+                references.addConstant (s->getConstant ());
+        references.visit (blocks [i]->getStatements ());
+        for (TSymbol *s: references.routines)
+            if (reachable.insert (s).second && isGeneratedRoutine (s))
+                blocks.push_back (s->getBlock ());
+    }
+
+    TResult result {0, 0};
+    for (TBlock *block: blocks) {
+        for (TSymbol *s: block->getSymbols ())
+            if (isGeneratedRoutine (s)) {
+                const bool used = reachable.count (s);
+                s->setUsed (used);
+                ++(used ? result.routines : result.removed);
+            }
+        block->getSymbols ().removeUnusedSymbols ();
+    }
+    return result;
+}
+
+}
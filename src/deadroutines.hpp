@@ -0,0 +1,29 @@
+/** \file deadroutines.hpp
+
+    Removes routines no longer reachable after the optimizations of the syntax tree,
+    e.g. routines whose calls were all inlined or folded away. Reachable are the
+    routines referenced by the statements of the program block, which include the
+    initialization and finalization of all units, by typed constants and, recursively,
+    by the blocks of reachable routines. Unlike the removal of unused symbols after
+    parsing, nested routines are also removed.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace statpascal {
+
+class TBlock;
+
+class TDeadRoutineElimination final {
+public:
+    struct TResult {
+        std::size_t routines, removed;
+    };
+
+    /** removes unreachable routines from the program block and all routines; returns the number of routines kept and removed */
+    static TResult optimize (TBlock &programBlock);
+};
+
+}
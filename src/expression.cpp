@@ -94,6 +94,7 @@ template<typename T> TExpressionBase *TExpressionBase::createConstant (T val, TT
 }
 
 template TExpressionBase *TExpressionBase::createConstant<std::int64_t> (std::int64_t, TType *, TBlock &);
+template TExpressionBase *TExpressionBase::createConstant<double> (double, TType *, TBlock &);
 
 bool TExpressionBase::mergeConstants (TExpressionBase *&left, TExpressionBase *right, TType *type, TToken operation, TBlock &block) {
     if (left->isConstant () && right->isConstant ()) {
@@ -370,10 +371,33 @@ TType *TExpressionBase::checkVectorOperatorTypes (TExpressionBase *&left, TExpre
     TType *leftBaseType = retrieveVectorAndBaseType (left, block),
           *rightBaseType = retrieveVectorAndBaseType (right, block);
           
+    // vectors with identical single, int32, int16 or int8 elements are computed in the declared width
+    TVectorType *nativeType = nullptr;
+    const TStdType::TScalarTypeCode tc = TStdType::getScalarTypeCode (left->getType ()->getBaseType ());
+    if (tc == TStdType::getScalarTypeCode (right->getType ()->getBaseType ()))
+        switch (tc) {
+            case TStdType::TScalarTypeCode::single:
+                nativeType = compiler.createMemoryPoolObject<TVectorType> (&stdType.Single);
+                break;
+            case TStdType::TScalarTypeCode::s32:
+                nativeType = compiler.createMemoryPoolObject<TVectorType> (&stdType.Int32);
+                break;
+            case TStdType::TScalarTypeCode::s16:
+                nativeType = compiler.createMemoryPoolObject<TVectorType> (&stdType.Int16);
+                break;
+            case TStdType::TScalarTypeCode::s8:
+                nativeType = compiler.createMemoryPoolObject<TVectorType> (&stdType.Int8);
+                break;
+            default:
+                break;
+        }
+          
     switch (operation) {
         case TToken::And:
         case TToken::Or:
         case TToken::Xor:
+            if (nativeType && nativeType->getBaseType () != &stdType.Single)
+                return nativeType;
             if (leftBaseType == rightBaseType) {
                 if (leftBaseType == &stdType.Int64)
                     return &stdType.Int64Vector;
@@ -393,10 +417,15 @@ TType *TExpressionBase::checkVectorOperatorTypes (TExpressionBase *&left, TExpre
         case TToken::Add:
         case TToken::Sub:
         case TToken::Mul:
+            // integer results are int64 like in the scalar code
+            if (nativeType && nativeType->getBaseType () == &stdType.Single)
+                return nativeType;
             if (leftBaseType == &stdType.Int64 && rightBaseType == &stdType.Int64)
                 return &stdType.Int64Vector;
             // fall through
         case TToken::Div:
+            if (nativeType && nativeType->getBaseType () == &stdType.Single)
+                return nativeType;
             if ((leftBaseType == &stdType.Int64 || leftBaseType == &stdType.Real) && (rightBaseType == &stdType.Int64 || rightBaseType == &stdType.Real))
                 return &stdType.RealVector;
             break;
@@ -1285,6 +1314,12 @@ bool TLValueDereference::isLValueDereference () const {
 }
 
 void TLValueDereference::acceptCodeGenerator (TCodeGenerator &codeGenerator) {
+    // the address of a vector element is only required to modify it
+    if (base->isVectorIndex () && getType ()->isString ())
+        if (TFunctionCall *valueCall = static_cast<TVectorIndex *> (base)->getValueCall ()) {
+            codeGenerator.visit (valueCall);
+            return;
+        }
     codeGenerator.generateCode (*this);
 }
 
@@ -1362,17 +1397,17 @@ void TConstantValue::acceptCodeGenerator (TCodeGenerator &codeGenerator) {
 
 
 TRoutineValue::TRoutineValue (const std::string &identifier, TBlock &block):
-  symbol (nullptr) {
+  symbol (nullptr),
+  symbolOverloads (&block.getSymbols ().searchSymbols (identifier)) {
     TCompilerImpl &compiler = block.getCompiler ();
-    symbolOverloads = block.getSymbols ().searchSymbols (identifier);
     
-    if (symbolOverloads.empty ()) {
+    if (symbolOverloads->empty ()) {
         compiler.errorMessage (TCompilerImpl::IdentifierNotFound, "Identifier '" + identifier + "' not found in subroutine call");
         setType (&stdType.Void);
     } else {
-        resolveOverload (symbolOverloads.front (), block);
-        if (symbolOverloads.size () > 1) {
-//            std::cout << "Overloaded: " << identifier << " with count: " << symbolOverloads.size () << std::endl;
+        resolveOverload (symbolOverloads->front (), block);
+        if (symbolOverloads->size () > 1) {
+//            std::cout << "Overloaded: " << identifier << " with count: " << symbolOverloads->size () << std::endl;
             setType (&stdType.UnresOverload);
         } else {
 //            std::cout << "Resolved: " << identifier << " with argscount: " << static_cast<TRoutineType *> (getType ())->getParameter ().size () << std::endl;
@@ -1387,7 +1422,7 @@ void TRoutineValue::resolveOverload (TSymbol *s, TBlock &block) {
 }
 
 void TRoutineValue::resolveCall (std::vector<TExpressionBase *> args, TBlock &block) {
-    for (TSymbol *s: symbolOverloads) {
+    for (TSymbol *s: *symbolOverloads) {
         TRoutineType *routineType = static_cast<TRoutineType *> (s->getType ());
         bool success = false;
         if (routineType->getParameter ().size () == args.size ()) {
@@ -1414,7 +1449,7 @@ void TRoutineValue::resolveCall (std::vector<TExpressionBase *> args, TBlock &bl
 }
 
 bool TRoutineValue::resolveConversion (const TRoutineType *required, TBlock &block) {
-    for (TSymbol *s: symbolOverloads) {
+    for (TSymbol *s: *symbolOverloads) {
         TRoutineType *routineType = static_cast<TRoutineType *> (s->getType ());
         if (routineType->matchesOverload (required)) {
             resolveOverload (s, block);
@@ -1433,13 +1468,16 @@ void TRoutineValue::acceptCodeGenerator (TCodeGenerator &codeGenerator) {
 }
 
 
-TVectorIndex::TVectorIndex (TExpressionBase *base, TExpressionBase *index, TType *resultType, TIndexKind indexKind, TBlock &block) {
+TVectorIndex::TVectorIndex (TExpressionBase *base, TExpressionBase *index, TType *resultType, TIndexKind indexKind, TBlock &block):
+  base (base), valueCall (nullptr) {
     static const std::map<TIndexKind, std::string> runtimeFunc = {
         {TIndexKind::IntVec, "__vec_index_vint"}, {TIndexKind::BoolVec, "__vec_index_vbool"}, {TIndexKind::Int, "__vec_index_int"}
     };
     setType (resultType);
     lValue = (indexKind == TIndexKind::Int);
     runtimeCall = createRuntimeCall (runtimeFunc.at (indexKind), lValue ? static_cast<TType *> (&stdType.GenericPointer) : resultType, {base, index}, block, false);
+    if (lValue && resultType->isString ())
+        valueCall = createRuntimeCall ("__vec_element_str", resultType, {base, index}, block, false);
 }
 
 bool TVectorIndex::isLValue () const {
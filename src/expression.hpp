@@ -76,6 +76,7 @@ public:
     virtual bool isTypeCast () const override;
     
 private:
+    friend class TSyntaxTreeRewriter;
     // muess behandeln: subrange -> basetype, basetype->subrange mit Check
 
     TType *required;
@@ -103,6 +104,7 @@ public:
     TToken getOperation () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *left, *right;
     TToken operation;
 };
@@ -133,6 +135,7 @@ public:
     TToken getOperation () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *left, *right;
     TToken operation;
 };
@@ -163,6 +166,7 @@ public:
     TToken getOperation () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *left, *right;
     TToken operation;
 };
@@ -209,7 +213,8 @@ public:
     
     TPrefixedExpression (TExpressionBase *base, TToken operation, TType *type);
     
-private:    
+private:
+    friend class TSyntaxTreeRewriter;    
     TExpressionBase *base;    
     TToken operation;
 };
@@ -240,8 +245,10 @@ public:
     TExpressionBase *getReturnStorage () const;		// L-value
     TExpressionBase *getReturnStorageDeref () const;	// L-value dereference
     void setReturnStorage (TExpressionBase *returnStorage, TBlock &, bool replacesTemp = false);	// L-value
+    bool hasReturnTemp () const;	// false if result is stored directly in an assigned L-value
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *function;
     std::vector<TExpressionBase *> args;
     bool ignoreReturn;
@@ -273,6 +280,10 @@ inline TExpressionBase *TFunctionCall::getReturnStorageDeref () const {
     return returnStorageDeref;
 }
 
+inline bool TFunctionCall::hasReturnTemp () const {
+    return returnSymbol;
+}
+
 
 class TConstantValue: public TExpressionBase {
 using inherited = TExpressionBase;
@@ -317,7 +328,7 @@ private:
     void resolveOverload (TSymbol *, TBlock &);
 
     TSymbol *symbol;	// resolved overload
-    std::vector<TSymbol *> symbolOverloads;
+    const TSymbolList::TBaseContainer *symbolOverloads;	// owned by the symbol table
 };
 
 inline TSymbol *TRoutineValue::getSymbol () const {
@@ -368,6 +379,7 @@ public:
     virtual void acceptCodeGenerator (TCodeGenerator &) override;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *base;
 };
 
@@ -384,6 +396,7 @@ public:
     TExpressionBase *getIndexExpression () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *base, *index;
 };
 
@@ -408,6 +421,7 @@ public:
     const std::string getComponent () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *base;
     const std::string component;
 };
@@ -432,6 +446,7 @@ public:
     TExpressionBase *getExpression () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *expr;
 };
 
@@ -453,9 +468,22 @@ public:
     
     virtual void acceptCodeGenerator (TCodeGenerator &) override;
     
+    TExpressionBase *getBaseExpression () const;
+    /** call reading a string element without converting a string arena, or nullptr */
+    TFunctionCall *getValueCall () const;
+    
 private:
-    TFunctionCall *runtimeCall;
+    TExpressionBase *base;
+    TFunctionCall *runtimeCall, *valueCall;
     bool lValue;
 };
 
+inline TExpressionBase *TVectorIndex::getBaseExpression () const {
+    return base;
+}
+
+inline TFunctionCall *TVectorIndex::getValueCall () const {
+    return valueCall;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "expressionkey.hpp"
+#include "expression.hpp"
+#include "compilerimpl.hpp"
+#include "config.hpp"
+
+#include <bit>
+#include <set>
+
+namespace statpascal {
+
+bool TExpressionKey::isIntegerType (const TType *type) {
+    return type == &stdType.Int64 || (type->isSubrange () && type->getBaseType () == &stdType.Int64);
+}
+
+bool TExpressionKey::isScalarType (const TType *type) {
+    return type->isEnumerated () || type == &stdType.Real || type->isPointer ();
+}
+
+bool TExpressionKey::isRealMoved () {
+    return TConfig::target == TConfig::TTarget::X64 || TConfig::target == TConfig::TTarget::AARCH64;
+}
+
+bool TExpressionKey::isScaledIndex (std::size_t size) {
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+std::size_t TExpressionKey::getAddressCost (TExpressionBase *expression) {
+    std::size_t cost = 0;
+    for (;;)
+        if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression)) {
+            if (!arrayIndex->getIndexExpression ()->isConstant ())
+                cost += isScaledIndex (arrayIndex->getType ()->getSize ()) ? 1 : 2;
+            expression = arrayIndex->getBaseExpression ();
+        } else if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (expression))
+            expression = recordComponent->getExpression ();
+        else
+            return cost;
+}
+
+std::string TExpressionKey::getSymbolKey (char c, const TSymbol *s) {
+    return c + std::to_string (reinterpret_cast<std::uintptr_t> (s));
+}
+
+std::string TExpressionKey::getLoadKey (TExpressionBase *) {
+    return std::string ();
+}
+
+std::string TExpressionKey::getValueKey (TExpressionBase *expression) {
+    const TType *type = expression->getType ();
+    if (!isIntegerType (type) && !(type == &stdType.Real && isRealMoved ()))
+        return std::string ();
+    if (expression->isConstant ()) {
+        const TSimpleConstant *constant = static_cast<TConstantValue *> (expression)->getConstant ();
+        return '#' + (type == &stdType.Real ? std::to_string (std::bit_cast<std::uint64_t> (constant->getDouble ())) : std::to_string (constant->getInteger ()));
+    }
+    if (expression->isLValueDereference ()) {
+        TExpressionBase *lValue = static_cast<TLValueDereference *> (expression)->getLValue ();
+        if (lValue->isSymbol () && !lValue->isReference ())
+            return getVariableKey (static_cast<TVariable *> (lValue)->getSymbol ());
+        return getLoadKey (lValue);
+    }
+    if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression)) {
+        // conversions between integer types generate no code
+        const TType *baseType = typeCast->getExpression ()->getType ();
+        if (isIntegerType (type) && isIntegerType (baseType))
+            return getValueKey (typeCast->getExpression ());
+        if (type == &stdType.Real && baseType == &stdType.Int64) {
+            const std::string key = getValueKey (typeCast->getExpression ());
+            return key.empty () ? key : "real (" + key + ')';
+        }
+        return std::string ();
+    }
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return getOperationKey (simpleExpression->getLeftExpression (), simpleExpression->getRightExpression (), simpleExpression->getOperation (), type);
+    if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return getOperationKey (term->getLeftExpression (), term->getRightExpression (), term->getOperation (), type);
+    if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        if (prefixedExpression->getOperation () == TToken::Sub || (prefixedExpression->getOperation () == TToken::Not && type != &stdType.Real))
+            return getOperationKey (nullptr, prefixedExpression->getExpression (), prefixedExpression->getOperation (), type);
+    return std::string ();
+}
+
+// Integer division is excluded: it may fail where it is not evaluated, e.g. in the
+// unused part of a short-circuit boolean expression or in a loop not entered.
+
+std::string TExpressionKey::getOperationKey (TExpressionBase *left, TExpressionBase *right, TToken operation, const TType *type) {
+    static const std::set<TToken>
+        integerOperations {TToken::Add, TToken::Sub, TToken::Mul, TToken::And, TToken::Or, TToken::Xor, TToken::Shl, TToken::Shr, TToken::Not},
+        realOperations {TToken::Add, TToken::Sub, TToken::Mul, TToken::Div};
+    if (!(type == &stdType.Real ? realOperations : integerOperations).count (operation))
+        return std::string ();
+    const std::string a = left ? getValueKey (left) : std::string ("_"), b = getValueKey (right);
+    if (a.empty () || b.empty ())
+        return std::string ();
+    return '(' + a + ' ' + std::to_string (static_cast<int> (operation)) + ' ' + b + ')';
+}
+
+std::string TExpressionKey::getAddressKey (TExpressionBase *expression) {
+    if (expression->isSymbol ())
+        return getSymbolKey (expression->isReference () ? 'r' : 'v', static_cast<TVariable *> (expression)->getSymbol ());
+    if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (expression)) {
+        const std::string base = getAddressKey (recordComponent->getExpression ());
+        return base.empty () ? base : base + '.' + recordComponent->getComponent ();
+    }
+    if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression)) {
+        if (!arrayIndex->getBaseExpression ()->getType ()->isArray ())
+            return std::string ();
+        const std::string base = getAddressKey (arrayIndex->getBaseExpression ()), index = getValueKey (arrayIndex->getIndexExpression ());
+        return base.empty () || index.empty () ? std::string () : base + '[' + index + ']';
+    }
+    if (TPointerDereference *pointerDereference = dynamic_cast<TPointerDereference *> (expression)) {
+        TExpressionBase *pointer = pointerDereference->getExpression ();
+        if (pointer->isSymbol () && !pointer->isReference ()) {
+            const std::string key = getVariableKey (static_cast<TVariable *> (pointer)->getSymbol ());
+            return key.empty () ? key : '^' + key;
+        }
+    }
+    return std::string ();
+}
+
+}
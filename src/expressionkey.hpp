@@ -0,0 +1,52 @@
+/** \file expressionkey.hpp
+
+    Keys identifying integer and real expressions with the same value and variables,
+    array elements and record components at the same address. Two expressions with the
+    same non-empty key may be evaluated once. Derived classes decide which variables
+    keep their values.
+*/
+
+#pragma once
+
+#include "lexer.hpp"
+
+#include <string>
+#include <cstddef>
+
+namespace statpascal {
+
+class TExpressionBase;
+class TSymbol;
+class TType;
+
+class TExpressionKey {
+public:
+    virtual ~TExpressionKey () = default;
+
+    /** key of an integer or real expression, or an empty string */
+    std::string getValueKey (TExpressionBase *);
+    /** key of the address of an lvalue, or an empty string */
+    std::string getAddressKey (TExpressionBase *);
+
+    // Int64 and its subranges
+    static bool isIntegerType (const TType *);
+    static bool isScalarType (const TType *);
+    // real arithmetic is moved for IEEE doubles only: a division by zero does not trap
+    static bool isRealMoved ();
+    // element sizes handled by the scaled index addressing of the backends
+    static bool isScaledIndex (std::size_t size);
+    /** cost of the address of an element: 1 for each scaled index not constant, 2 for other indices */
+    static std::size_t getAddressCost (TExpressionBase *);
+    static std::string getSymbolKey (char c, const TSymbol *);
+
+protected:
+    /** key of the value of a scalar variable, or an empty string if it cannot be used */
+    virtual std::string getVariableKey (const TSymbol *) = 0;
+    /** key of the value of an array element or record component, empty by default */
+    virtual std::string getLoadKey (TExpressionBase *lValue);
+
+private:
+    std::string getOperationKey (TExpressionBase *left, TExpressionBase *right, TToken operation, const TType *type);
+};
+
+}
@@ -0,0 +1,68 @@
+#include "flowgraph.hpp"
+#include "statements.hpp"
+
+namespace statpascal {
+
+TFlowGraph::TFlowGraph (TStatement *body):
+  nodes (1, TNode {nullptr, {}}), valid (true) {
+    entryNode = build (body, exitNode);
+}
+
+// The statements of a sequence are added from the last one: the node following a
+// statement is known when it is added. Gotos may refer to the node of a label before
+// its statement is reached.
+
+std::size_t TFlowGraph::build (TStatement *statement, std::size_t next) {
+    if (!statement)
+        return next;
+    if (TStatementSequence *statementSequence = dynamic_cast<TStatementSequence *> (statement)) {
+        const std::vector<TStatement *> &statements = statementSequence->getStatements ();
+        for (std::vector<TStatement *>::const_reverse_iterator it = statements.rbegin (); it != statements.rend (); ++it)
+            next = build (*it, next);
+        return next;
+    }
+    if (TWithStatement *withStatement = dynamic_cast<TWithStatement *> (statement))
+        return build (withStatement->getStatement (), next);
+    if (TLabeledStatement *labeledStatement = dynamic_cast<TLabeledStatement *> (statement)) {
+        const std::size_t node = getLabelNode (labeledStatement->getLabel ());
+        valid &= !nodes [node].statement;
+        const std::size_t successor = build (labeledStatement->getStatement (), next);
+        nodes [node] = TNode {labeledStatement, {successor}};
+        return node;
+    }
+    if (TIfStatement *ifStatement = dynamic_cast<TIfStatement *> (statement)) {
+        const std::size_t statement1 = build (ifStatement->getStatement1 (), next),
+                          statement2 = build (ifStatement->getStatement2 (), next);
+        return addNode (statement, {statement1, statement2});
+    }
+    if (TCaseStatement *caseStatement = dynamic_cast<TCaseStatement *> (statement)) {
+        std::vector<std::size_t> successors;
+        for (const TCaseStatement::TCase &c: caseStatement->getCaseList ())
+            successors.push_back (build (c.statement, next));
+        successors.push_back (build (caseStatement->getDefaultStatement (), next));
+        return addNode (statement, std::move (successors));
+    }
+    if (TGotoStatement *gotoStatement = dynamic_cast<TGotoStatement *> (statement)) {
+        const std::size_t label = getLabelNode (gotoStatement->getLabel ());
+        if (gotoStatement->getCondition ())
+            return addNode (statement, {label, next});
+        return addNode (statement, {label});
+    }
+    valid &= dynamic_cast<TAssignment *> (statement) || dynamic_cast<TRoutineCall *> (statement) || dynamic_cast<TEmptyStatement *> (statement);
+    return addNode (statement, {next});
+}
+
+std::size_t TFlowGraph::addNode (TStatement *statement, std::vector<std::size_t> &&successors) {
+    nodes.push_back (TNode {statement, std::move (successors)});
+    return nodes.size () - 1;
+}
+
+std::size_t TFlowGraph::getLabelNode (const TSymbol *label) {
+    std::map<const TSymbol *, std::size_t>::iterator it = labelNodes.find (label);
+    if (it != labelNodes.end ())
+        return it->second;
+    labelNodes [label] = nodes.size ();
+    return addNode (nullptr, {});
+}
+
+}
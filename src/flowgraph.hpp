@@ -0,0 +1,71 @@
+/** \file flowgraph.hpp
+
+    Control flow graph of a routine body for the optimizations of the syntax tree.
+    Loops are lowered to labels and conditional gotos by the parser; each of the
+    remaining statements is a node:
+
+    - an assignment, routine call or empty statement continues with the next statement
+    - an if statement continues with the first statement of the then or else branch,
+      a case statement with that of one of its cases or the default, a conditional goto
+      with the label or the next statement
+    - a labeled statement continues with the statement it labels.
+
+    Statement sequences and with statements are not nodes. An exit or halt is assumed
+    to continue with the next statement.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <map>
+
+namespace statpascal {
+
+class TStatement;
+class TSymbol;
+
+class TFlowGraph final {
+public:
+    /** Successors of an if statement are the then and else branch, of a case statement
+        the cases in the order of the case list followed by the default, of a conditional
+        goto the label and the next statement. */
+    struct TNode {
+        TStatement *statement;
+        std::vector<std::size_t> successors;
+    };
+
+    /** node reached at the end of the routine; it has no statement */
+    static constexpr std::size_t exitNode = 0;
+
+    explicit TFlowGraph (TStatement *body);
+
+    /** false if the body contains a statement which is not a node */
+    bool isValid () const;
+    std::size_t getEntryNode () const;
+    const std::vector<TNode> &getNodes () const;
+
+private:
+    std::size_t build (TStatement *, std::size_t next);
+    std::size_t addNode (TStatement *, std::vector<std::size_t> &&successors);
+    std::size_t getLabelNode (const TSymbol *label);
+
+    std::vector<TNode> nodes;
+    std::map<const TSymbol *, std::size_t> labelNodes;
+    std::size_t entryNode;
+    bool valid;
+};
+
+inline bool TFlowGraph::isValid () const {
+    return valid;
+}
+
+inline std::size_t TFlowGraph::getEntryNode () const {
+    return entryNode;
+}
+
+inline const std::vector<TFlowGraph::TNode> &TFlowGraph::getNodes () const {
+    return nodes;
+}
+
+}
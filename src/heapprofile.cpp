@@ -0,0 +1,137 @@
+#include "heapprofile.hpp"
+
+#include <execinfo.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace statpascal {
+
+namespace {
+
+struct TSiteKey {
+    std::uintptr_t address;	// return address in generated code, 0 if not called from there
+    THeapProfile::TKind kind;
+
+    bool operator < (const TSiteKey &other) const {
+        return address < other.address || (address == other.address && kind < other.kind);
+    }
+};
+
+struct TSite {
+    std::size_t count = 0, liveCount = 0, bytes = 0, liveBytes = 0, peakBytes = 0;
+};
+
+struct TLiveAllocation {
+    TSite *site;
+    std::size_t bytes;
+};
+
+std::mutex profileMutex;
+std::uintptr_t codeBegin, codeEnd;
+std::vector<THeapProfile::TRoutineLabel> routineLabels;
+std::map<TSiteKey, TSite> sites;
+TSite total;
+std::unordered_map<const void *, TLiveAllocation> liveAllocations;
+
+// the first return address inside the generated code; the unwinder stops there as generated code has no unwind information
+
+std::uintptr_t getCallSite () {
+    constexpr int maxDepth = 64;
+    void *frames [maxDepth];
+    const int n = backtrace (frames, maxDepth);
+    for (int i = 0; i < n; ++i) {
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t> (frames [i]);
+        if (codeBegin <= address && address < codeEnd)
+            return address;
+    }
+    return 0;
+}
+
+std::string getSiteName (std::uintptr_t address) {
+    if (!address)
+        return "(runtime)";
+    const std::size_t offset = address - codeBegin;
+    std::vector<THeapProfile::TRoutineLabel>::const_iterator it = std::upper_bound (routineLabels.begin (), routineLabels.end (), offset - 1,
+        [] (std::size_t offset, const THeapProfile::TRoutineLabel &label) { return offset < label.offset; });
+    char buf [32];
+    if (it == routineLabels.begin ()) {
+        snprintf (buf, sizeof (buf), "0x%zx", offset);
+        return buf;
+    }
+    --it;
+    snprintf (buf, sizeof (buf), "+0x%zx", offset - it->offset);
+    return it->name + buf;
+}
+
+const char *getKindName (THeapProfile::TKind kind) {
+    static const char *names [] = {"string", "vector", "value", "new"};
+    return names [static_cast<int> (kind)];
+}
+
+}
+
+void THeapProfile::enable (const void *code, std::size_t codeSize, std::vector<TRoutineLabel> &&routines) {
+    codeBegin = reinterpret_cast<std::uintptr_t> (code);
+    codeEnd = codeBegin + codeSize;
+    routineLabels = std::move (routines);
+    std::sort (routineLabels.begin (), routineLabels.end (), [] (const TRoutineLabel &a, const TRoutineLabel &b) { return a.offset < b.offset; });
+    // load the unwinder before the first allocation is recorded
+    void *frame;
+    backtrace (&frame, 1);
+    enabled = true;
+    std::atexit (report);
+}
+
+void THeapProfile::allocate (const void *p, std::size_t bytes, TKind kind) {
+    const std::uintptr_t address = getCallSite ();
+    std::lock_guard<std::mutex> lock (profileMutex);
+    TSite &site = sites [{address, kind}];
+    ++site.count;
+    ++site.liveCount;
+    site.bytes += bytes;
+    site.liveBytes += bytes;
+    site.peakBytes = std::max (site.peakBytes, site.liveBytes);
+    ++total.count;
+    ++total.liveCount;
+    total.bytes += bytes;
+    total.liveBytes += bytes;
+    total.peakBytes = std::max (total.peakBytes, total.liveBytes);
+    liveAllocations [p] = {&site, bytes};
+}
+
+void THeapProfile::release (const void *p) {
+    std::lock_guard<std::mutex> lock (profileMutex);
+    std::unordered_map<const void *, TLiveAllocation>::iterator it = liveAllocations.find (p);
+    // allocations made before the profile was enabled are not known
+    if (it != liveAllocations.end ()) {
+        --it->second.site->liveCount;
+        it->second.site->liveBytes -= it->second.bytes;
+        --total.liveCount;
+        total.liveBytes -= it->second.bytes;
+        liveAllocations.erase (it);
+    }
+}
+
+void THeapProfile::report () {
+    std::lock_guard<std::mutex> lock (profileMutex);
+    enabled = false;
+    std::vector<std::pair<TSiteKey, TSite>> sorted (sites.begin (), sites.end ());
+    std::stable_sort (sorted.begin (), sorted.end (), [] (const std::pair<TSiteKey, TSite> &a, const std::pair<TSiteKey, TSite> &b) {
+        return a.second.peakBytes > b.second.peakBytes;
+    });
+    fprintf (stderr, "\nHeap profile (%zu sites)\n%-40s %-7s %12s %14s %12s %14s %14s\n", sorted.size (), "site", "kind", "count", "bytes", "live count", "live bytes", "peak bytes");
+    for (const std::pair<TSiteKey, TSite> &it: sorted) {
+        const TSite &site = it.second;
+        fprintf (stderr, "%-40s %-7s %12zu %14zu %12zu %14zu %14zu\n", getSiteName (it.first.address).c_str (), getKindName (it.first.kind),
+                 site.count, site.bytes, site.liveCount, site.liveBytes, site.peakBytes);
+    }
+    fprintf (stderr, "%-40s %-7s %12zu %14zu %12zu %14zu %14zu\n", "total", "", total.count, total.bytes, total.liveCount, total.liveBytes, total.peakBytes);
+}
+
+}
@@ -0,0 +1,47 @@
+/** \file heapprofile.hpp
+
+    Allocation site profile of the values created by a running program (--heap-profile).
+    Strings, vectors and memory allocated with new are attributed to the call in the
+    generated code which created them. Count and size of the allocations made and still
+    alive and the peak size alive are reported per site at exit. The size of a value is
+    taken when it is created.
+
+    While the profile is not enabled the hooks only test a flag.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace statpascal {
+
+class THeapProfile final {
+public:
+    enum class TKind {String, Vector, Value, Memory};
+
+    struct TRoutineLabel {
+        std::size_t offset;
+        std::string name;
+    };
+
+    /** starts recording allocations made from the generated code; routine labels are used
+        to name the sites. The report is written to stderr at exit. */
+    static void enable (const void *code, std::size_t codeSize, std::vector<TRoutineLabel> &&routines);
+    static bool isEnabled ();
+
+    static void allocate (const void *p, std::size_t bytes, TKind);
+    static void release (const void *p);
+
+private:
+    static void report ();
+
+    static inline bool enabled = false;
+};
+
+inline bool THeapProfile::isEnabled () {
+    return enabled;
+}
+
+}
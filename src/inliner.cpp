@@ -0,0 +1,295 @@
+#include "inliner.hpp"
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+#include "predefined.hpp"
+#include "config.hpp"
+
+#include <map>
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+struct TExpressionInfo {
+    std::size_t size = 0;
+    std::map<const TSymbol *, std::size_t> uses;
+    std::set<const TSymbol *> lValues;		// symbols used without dereference
+};
+
+struct TInlineRoutine {
+    TAssignment *assignment;
+    std::vector<const TSymbol *> parameters;	// in order of the arguments
+    std::map<const TSymbol *, std::size_t> uses;
+};
+
+using TInlineRoutines = std::map<const TSymbol *, TInlineRoutine>;
+
+bool isSimpleType (const TType *type) {
+    return type && (type->isEnumerated () || type == &stdType.Real || type->isPointer ());
+}
+
+// Counts the nodes of an expression and the uses of symbols. Returns false if
+// the expression has side effects or contains nodes not handled by the inliner.
+// Reading an absolute variable may have side effects on the TI.
+
+bool analyzeExpression (TExpressionBase *expression, TExpressionInfo &info) {
+    if (!expression)
+        return true;
+    ++info.size;
+    if (expression->isConstant ())
+        return isSimpleType (expression->getType ());
+    if (expression->isSymbol ()) {
+        const TSymbol *s = static_cast<TVariable *> (expression)->getSymbol ();
+        ++info.uses [s];
+        info.lValues.insert (s);
+        return !s->checkSymbolFlag (TSymbol::Absolute);
+    }
+    if (TLValueDereference *lValueDereference = dynamic_cast<TLValueDereference *> (expression)) {
+        TExpressionBase *lValue = lValueDereference->getLValue ();
+        if (!isSimpleType (expression->getType ()))
+            return false;
+        if (lValue->isSymbol ()) {
+            const TSymbol *s = static_cast<TVariable *> (lValue)->getSymbol ();
+            ++info.uses [s];
+            return !s->checkSymbolFlag (TSymbol::Absolute);
+        }
+        return analyzeExpression (lValue, info);
+    }
+    if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression))
+        return isSimpleType (expression->getType ()) && isSimpleType (typeCast->getExpression ()->getType ()) && analyzeExpression (typeCast->getExpression (), info);
+    if (TExpression *comparison = dynamic_cast<TExpression *> (expression))
+        return isSimpleType (comparison->getLeftExpression ()->getType ()) && isSimpleType (comparison->getRightExpression ()->getType ()) &&
+               analyzeExpression (comparison->getLeftExpression (), info) && analyzeExpression (comparison->getRightExpression (), info);
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return isSimpleType (expression->getType ()) &&
+               analyzeExpression (simpleExpression->getLeftExpression (), info) && analyzeExpression (simpleExpression->getRightExpression (), info);
+    if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return isSimpleType (expression->getType ()) && analyzeExpression (term->getLeftExpression (), info) && analyzeExpression (term->getRightExpression (), info);
+    if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        return isSimpleType (expression->getType ()) && analyzeExpression (prefixedExpression->getExpression (), info);
+    if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression))
+        return analyzeExpression (arrayIndex->getBaseExpression (), info) && analyzeExpression (arrayIndex->getIndexExpression (), info);
+    if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (expression))
+        return analyzeExpression (recordComponent->getExpression (), info);
+    if (TPointerDereference *pointerDereference = dynamic_cast<TPointerDereference *> (expression))
+        return analyzeExpression (pointerDereference->getExpression (), info);
+    if (TPredefinedRoutine *predefinedRoutine = dynamic_cast<TPredefinedRoutine *> (expression)) {
+        const TPredefinedRoutine::TRoutine routine = predefinedRoutine->getRoutine ();
+        if (routine != TPredefinedRoutine::Odd && routine != TPredefinedRoutine::Succ && routine != TPredefinedRoutine::Pred)
+            return false;
+        for (TExpressionBase *arg: predefinedRoutine->getArguments ())
+            if (!analyzeExpression (arg, info))
+                return false;
+        return true;
+    }
+    return false;
+}
+
+bool createInlineRoutine (TBlock &block, TInlineRoutine &inlineRoutine) {
+    const TSymbol *routine = block.getSymbol ();
+    const TRoutineType *routineType = static_cast<const TRoutineType *> (routine->getType ());
+    TStatementSequence *body = dynamic_cast<TStatementSequence *> (block.getStatements ());
+    if (!body || body->getStatements ().size () != 1 || block.getSymbols ().getLevel () != 2)
+        return false;
+    TAssignment *assignment = dynamic_cast<TAssignment *> (body->getStatements () [0]);
+    if (!assignment || !isSimpleType (assignment->getLValue ()->getType ()))
+        return false;
+
+    const TSymbol *resultSymbol = nullptr;
+    if (block.returnLValueDeref) {
+        TExpressionBase *resultLValue = static_cast<TLValueDereference *> (block.returnLValueDeref)->getLValue ();
+        if (resultLValue->isReference () || !isSimpleType (resultLValue->getType ()))
+            return false;
+        resultSymbol = static_cast<TVariable *> (resultLValue)->getSymbol ();
+        if (!assignment->getLValue ()->isSymbol () || static_cast<TVariable *> (assignment->getLValue ())->getSymbol () != resultSymbol)
+            return false;
+        // the assignment truncates integers to the result type; a type cast in an expression does not
+        TExpressionBase *value = assignment->getExpression ();
+        if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (value))
+            value = typeCast->getExpression ();
+        if (value->getType () != resultLValue->getType () && !resultLValue->getType ()->isReal ())
+            return false;
+    }
+
+    // no local variables
+    for (const TSymbol *s: block.getSymbols ())
+        if (s != resultSymbol && !s->checkSymbolFlag (TSymbol::Parameter) && !s->checkSymbolFlag (TSymbol::Constant) && !s->checkSymbolFlag (TSymbol::NamedType))
+            return false;
+
+    std::set<const TSymbol *> valueParameters;
+    for (const TSymbol *parameter: routineType->getParameter ()) {
+        const TSymbol *s = block.getSymbols ().searchSymbol (parameter->getName ());
+        if (!s || s->getLevel () != 2 || s->getType () != parameter->getType ())
+            return false;
+        if (s->getType ()->isReference ()) {
+            if (s->getType ()->getBaseType () == &stdType.GenericVar)
+                return false;
+        } else if (isSimpleType (s->getType ()))
+            valueParameters.insert (s);
+        else
+            return false;
+        inlineRoutine.parameters.push_back (s);
+    }
+
+    TExpressionInfo info;
+    if (!analyzeExpression (assignment->getLValue (), info) || !analyzeExpression (assignment->getExpression (), info) || info.size > TConfig::inlineSize)
+        return false;
+    for (const std::pair<const TSymbol *const, std::size_t> &it: info.uses)
+        if (it.first == resultSymbol) {
+            if (it.second != 1)
+                return false;
+        } else if (valueParameters.count (it.first)) {
+            if (info.lValues.count (it.first))
+                return false;
+        } else if (it.first->getLevel () != 1 && std::find (inlineRoutine.parameters.begin (), inlineRoutine.parameters.end (), it.first) == inlineRoutine.parameters.end ())
+            return false;
+
+    inlineRoutine.assignment = assignment;
+    inlineRoutine.uses = std::move (info.uses);
+    return true;
+}
+
+
+class TCallInliner: public TSyntaxTreeRewriter {
+public:
+    TCallInliner (TBlock &block, const TInlineRoutines &inlineRoutines);
+
+protected:
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *) override;
+    virtual TStatement *rewriteStatement (TStatement *) override;
+
+private:
+    const TInlineRoutine *getInlineRoutine (TExpressionBase *, bool isProcedure);
+    TExpressionBase *clone (TExpressionBase *);
+
+    TBlock &block;
+    const TInlineRoutines &inlineRoutines;
+    std::map<const TSymbol *, TExpressionBase *> arguments;
+};
+
+TCallInliner::TCallInliner (TBlock &block, const TInlineRoutines &inlineRoutines):
+  block (block), inlineRoutines (inlineRoutines) {
+}
+
+TExpressionBase *TCallInliner::rewriteExpression (TExpressionBase *expression) {
+    if (const TInlineRoutine *inlineRoutine = getInlineRoutine (expression, false))
+        return clone (inlineRoutine->assignment->getExpression ());
+    return expression;
+}
+
+TStatement *TCallInliner::rewriteStatement (TStatement *statement) {
+    if (TRoutineCall *routineCall = dynamic_cast<TRoutineCall *> (statement))
+        if (const TInlineRoutine *inlineRoutine = getInlineRoutine (routineCall->getRoutineCall (), true))
+            return block.getCompiler ().createMemoryPoolObject<TAssignment> (clone (inlineRoutine->assignment->getLValue ()), clone (inlineRoutine->assignment->getExpression ()));
+    return statement;
+}
+
+// checks the call and its arguments; sets the arguments substituted for the parameters
+
+const TInlineRoutine *TCallInliner::getInlineRoutine (TExpressionBase *expression, bool isProcedure) {
+    TFunctionCall *functionCall = dynamic_cast<TFunctionCall *> (expression);
+    if (!functionCall || functionCall->getReturnStorage () || (functionCall->getType () == &stdType.Void) != isProcedure || (!isProcedure && functionCall->isIgnoreReturn ()))
+        return nullptr;
+    TRoutineValue *routineValue = dynamic_cast<TRoutineValue *> (functionCall->getFunction ());
+    TInlineRoutines::const_iterator it = routineValue ? inlineRoutines.find (routineValue->getSymbol ()) : inlineRoutines.end ();
+    if (it == inlineRoutines.end () || it->second.parameters.size () != functionCall->getArguments ().size ())
+        return nullptr;
+
+    const TInlineRoutine &inlineRoutine = it->second;
+    arguments.clear ();
+    for (std::size_t i = 0; i < inlineRoutine.parameters.size (); ++i) {
+        TExpressionBase *arg = functionCall->getArguments () [i];
+        const TSymbol *parameter = inlineRoutine.parameters [i];
+        std::map<const TSymbol *, std::size_t>::const_iterator uses = inlineRoutine.uses.find (parameter);
+        TExpressionInfo info;
+        if (!analyzeExpression (arg, info) || (uses != inlineRoutine.uses.end () && uses->second > 1 && info.size > TConfig::inlineArgumentSize))
+            return nullptr;
+        arguments [parameter] = arg;
+    }
+    block.getSymbols ().addInlinedCall (routineValue->getSymbol ()->getName ());
+    return &inlineRoutine;
+}
+
+// copies an expression of the inlined routine or an argument, replacing the parameters
+
+TExpressionBase *TCallInliner::clone (TExpressionBase *expression) {
+    TCompilerImpl &compiler = block.getCompiler ();
+    if (expression->isConstant ())
+        return expression;
+    if (expression->isSymbol ()) {
+        TSymbol *s = static_cast<TVariable *> (expression)->getSymbol ();
+        std::map<const TSymbol *, TExpressionBase *>::iterator it = arguments.find (s);
+        if (it != arguments.end ())
+            return clone (it->second);
+        if (expression->isReference ())
+            return compiler.createMemoryPoolObject<TReferenceVariable> (s, block);
+        return compiler.createMemoryPoolObject<TVariable> (s, block);
+    }
+    if (TLValueDereference *lValueDereference = dynamic_cast<TLValueDereference *> (expression)) {
+        TExpressionBase *lValue = lValueDereference->getLValue ();
+        if (lValue->isSymbol () && !lValue->isReference ()) {
+            std::map<const TSymbol *, TExpressionBase *>::iterator it = arguments.find (static_cast<TVariable *> (lValue)->getSymbol ());
+            if (it != arguments.end ())
+                return clone (it->second);
+        }
+        return compiler.createMemoryPoolObject<TLValueDereference> (clone (lValue));
+    }
+    if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression))
+        return compiler.createMemoryPoolObject<TTypeCast> (typeCast->getType (), clone (typeCast->getExpression ()));
+    if (TExpression *comparison = dynamic_cast<TExpression *> (expression))
+        return compiler.createMemoryPoolObject<TExpression> (clone (comparison->getLeftExpression ()), clone (comparison->getRightExpression ()), comparison->getOperation (), comparison->getType ());
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return compiler.createMemoryPoolObject<TSimpleExpression> (clone (simpleExpression->getLeftExpression ()), clone (simpleExpression->getRightExpression ()), simpleExpression->getOperation (), simpleExpression->getType ());
+    if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return compiler.createMemoryPoolObject<TTerm> (clone (term->getLeftExpression ()), clone (term->getRightExpression ()), term->getOperation (), term->getType ());
+    if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        return compiler.createMemoryPoolObject<TPrefixedExpression> (clone (prefixedExpression->getExpression ()), prefixedExpression->getOperation (), prefixedExpression->getType ());
+    if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression))
+        return compiler.createMemoryPoolObject<TArrayIndex> (clone (arrayIndex->getBaseExpression ()), clone (arrayIndex->getIndexExpression ()), arrayIndex->getType ());
+    if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (expression)) {
+        TExpressionBase *base = clone (recordComponent->getExpression ());
+        const TSymbol *component = static_cast<TRecordType *> (base->getType ())->searchComponent (recordComponent->getComponent ());
+        return compiler.createMemoryPoolObject<TRecordComponent> (base, recordComponent->getComponent (), component);
+    }
+    if (TPointerDereference *pointerDereference = dynamic_cast<TPointerDereference *> (expression))
+        return compiler.createMemoryPoolObject<TPointerDereference> (clone (pointerDereference->getExpression ()));
+    TPredefinedRoutine *predefinedRoutine = static_cast<TPredefinedRoutine *> (expression);
+    std::vector<TExpressionBase *> args;
+    for (TExpressionBase *arg: predefinedRoutine->getArguments ())
+        args.push_back (clone (arg));
+    return compiler.createMemoryPoolObject<TPredefinedRoutine> (predefinedRoutine->getRoutine (), predefinedRoutine->getType (), std::move (args));
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ()) {
+            blocks.push_back (s->getBlock ());
+            collectBlocks (*s->getBlock (), blocks);
+        }
+}
+
+}
+
+void TInliner::optimize (TBlock &programBlock) {
+    if (!TConfig::inlineSize)
+        return;
+    std::vector<TBlock *> blocks {&programBlock};
+    collectBlocks (programBlock, blocks);
+
+    TInlineRoutines inlineRoutines;
+    for (TBlock *block: blocks)
+        if (block != &programBlock) {
+            TInlineRoutine inlineRoutine;
+            if (createInlineRoutine (*block, inlineRoutine))
+                inlineRoutines [block->getSymbol ()] = std::move (inlineRoutine);
+        }
+    if (!inlineRoutines.empty ())
+        for (TBlock *block: blocks) {
+            TCallInliner inliner (*block, inlineRoutines);
+            TStatement *statements = block->getStatements ();
+            inliner.rewrite (statements);
+        }
+}
+
+}
@@ -0,0 +1,29 @@
+/** \file inliner.hpp
+
+    Replaces calls of small routines by their bodies. A routine is inlined if
+
+    - it has no local variables and no nested routines and uses only its value
+      parameters of simple type, its var parameters and global variables
+    - its body is a single assignment to the function result or, for a procedure,
+      to a var parameter or global variable
+    - the assignment has no calls and at most TConfig::inlineSize nodes.
+
+    Parameters are replaced by the arguments of the call. A call is not inlined if
+    an argument has side effects or if an argument larger than TConfig::inlineArgumentSize
+    would be evaluated more than once. Inlined calls are shown in the header of the
+    calling routine in the listing.
+*/
+
+#pragma once
+
+namespace statpascal {
+
+class TBlock;
+
+class TInliner final {
+public:
+    /** inlines calls in the program block and all routines */
+    static void optimize (TBlock &programBlock);
+};
+
+}
@@ -2,6 +2,8 @@
 #include "config.hpp"
 
 #include <unordered_map>
+#include <unordered_set>
+#include <string_view>
 #include <limits>
 #include <cmath>
 #include <array>
@@ -9,83 +11,25 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <iostream>
 
 namespace statpascal {
 
-class TLexer::TLexerImpl {
-public:
-    TLexerImpl ();
-    ~TLexerImpl () = default;
+namespace {
 
-    void setSource (const std::string &);
-    void setSource (std::string &&);
-    void setFilename (const std::string &fn);
-    
-    void getNextToken ();
-    TToken getToken ();
-//    bool checkToken (TToken) ;
-    
-    double getDouble () const;
-    std::int64_t getInteger () const;
-    std::string getString () const;
-    std::string getIdentifier () const;
-    unsigned char getChar () const;
-    
-    void setAssemblerMode (bool);
-    
-    unsigned getLineNumber () const;
-    unsigned getLinePosition () const;
-    std::string getFilename () const;
-
-private:
-    typedef const char *TSourceIterator;
-    typedef std::unordered_map<std::string, TToken> TStringTokenMap;
-    typedef std::unordered_map<char, TToken> TCharTokenMap;
-
-    void initLexer ();
-    void checkConditional ();
-    bool skipComment ();
-    bool skipWhiteSpace ();
-    
-    void parseNumber ();
-    void parseHex ();
-    void parseOctal ();
-    void parseNumericChar ();
-    void parseQuotedString ();
-    void parseString ();
-    bool parseOperator (char base, TToken baseToken, char combine1, TToken combinedToken1, char combine2 = '\0', TToken combinedToken2 = TToken::Error);
-    void parseSymbol ();
-    
-    void setCurrentTokenAndAdvance (TToken);
-    
-    const char stringTerminator = '\'';
-    const char stringNumericEscape = '#';
-    
-    TStringTokenMap reservedWords;
-    TCharTokenMap reservedSymbols;
-    
-    std::string source;
-    TSourceIterator sourceIt, lineBegin;
-    unsigned lineNumber, lastReadLineNumber, lastReadPosition;
-    std::string filename;
-    
-    TToken currentToken;
-    double fVal;
-    std::int64_t iVal;
-    std::string sVal, sValLower;
-    unsigned char cVal;
-    bool assemblerMode;
+struct TKeyword {
+    std::string_view name;
+    TToken token;
 };
 
-inline void TLexer::TLexerImpl::setCurrentTokenAndAdvance (TToken t) {
-    currentToken = t;
-    ++sourceIt;
-}
-
-TLexer::TLexerImpl::TLexerImpl ():
-  reservedWords ({
+constexpr TKeyword keywords [] = {
     {"and", 		TToken::And},
     {"array", 		TToken::Array}, 
     {"begin", 		TToken::Begin}, 
@@ -146,72 +90,318 @@ TLexer::TLexerImpl::TLexerImpl ():
     {"vector", 		TToken::Vector}, 
     {"while", 		TToken::While}, 
     {"xor", 		TToken::Xor} 
-  }), reservedSymbols ({
-    {'+', 	TToken::Add},
-    {'-', 	TToken::Sub},
-    {'*',	TToken::Mul},
-    {'/', 	TToken::Div},
-    {'^', 	TToken::Dereference},
-    {'(', 	TToken::BracketOpen},
-    {')', 	TToken::BracketClose},
-    {'[', 	TToken::SquareBracketOpen},
-    {']', 	TToken::SquareBracketClose},
-    {'=',	TToken::Equal},
-    {'@',	TToken::AddrOp},
-    {',', 	TToken::Comma},
-    {';', 	TToken::Semicolon},
-    {'\0', 	TToken::Terminator},
-    // The following need evaluation of the second character:
-    {'*',	TToken::Error},
-    {'.',	TToken::Error},
-    {'<',	TToken::Error},
-    {'>',	TToken::Error},
-    {':',	TToken::Error},
-    {'=',	TToken::Error}
-  }) {
-}
-
-void TLexer::TLexerImpl::initLexer () {
-    lineBegin = sourceIt = &source [0];
+};
+
+constexpr char toLower (char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// perfect hash of the keywords: length, first, second and last character select a unique slot
+
+constexpr std::size_t keywordHashSize = 256;
+
+constexpr std::size_t keywordHash (const char *s, std::size_t length) {
+    return (20 * length + 12 * static_cast<unsigned char> (toLower (s [0])) + 3 * static_cast<unsigned char> (toLower (s [length > 1])) + static_cast<unsigned char> (toLower (s [length - 1]))) % keywordHashSize;
+}
+
+using TKeywordTable = std::array<const TKeyword *, keywordHashSize>;
+
+constexpr TKeywordTable createKeywordTable () {
+    TKeywordTable table {};
+    for (const TKeyword &keyword: keywords)
+        table [keywordHash (keyword.name.data (), keyword.name.length ())] = &keyword;
+    return table;
+}
+
+constexpr TKeywordTable keywordTable = createKeywordTable ();
+
+constexpr bool isPerfectHash () {
+    for (const TKeyword &keyword: keywords)
+        if (keywordTable [keywordHash (keyword.name.data (), keyword.name.length ())] != &keyword)
+            return false;
+    return true;
+}
+
+static_assert (isPerfectHash (), "keyword hash has collisions");
+
+using TSymbolTable = std::array<TToken, 256>;
+
+// Error marks characters which need evaluation of the second character
+
+constexpr TSymbolTable createSymbolTable () {
+    TSymbolTable table {};
+    for (TToken &t: table)
+        t = TToken::Identifier;
+    const std::pair<char, TToken> symbols [] = {
+        {'+', 	TToken::Add},
+        {'-', 	TToken::Sub},
+        {'*',	TToken::Mul},
+        {'/', 	TToken::Div},
+        {'^', 	TToken::Dereference},
+        {'(', 	TToken::BracketOpen},
+        {')', 	TToken::BracketClose},
+        {'[', 	TToken::SquareBracketOpen},
+        {']', 	TToken::SquareBracketClose},
+        {'=',	TToken::Equal},
+        {'@',	TToken::AddrOp},
+        {',', 	TToken::Comma},
+        {';', 	TToken::Semicolon},
+        {'.',	TToken::Error},
+        {'<',	TToken::Error},
+        {'>',	TToken::Error},
+        {':',	TToken::Error}
+    };
+    for (const std::pair<char, TToken> &symbol: symbols)
+        table [static_cast<unsigned char> (symbol.first)] = symbol.second;
+    return table;
+}
+
+constexpr TSymbolTable symbolTable = createSymbolTable ();
+
+bool startsWith (const char *s, const char *prefix) {
+    return !std::strncmp (s, prefix, std::strlen (prefix));
+}
+
+const std::string emptyIdentifier;
+
+const std::string &getKeywordName (const TKeyword *keyword) {
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> result;
+        for (const TKeyword &keyword: keywords)
+            result.emplace_back (keyword.name);
+        return result;
+    } ();
+    return names [keyword - keywords];
+}
+
+}
+
+class TLexer::TLexerImpl {
+public:
+    TLexerImpl ();
+    ~TLexerImpl ();
+
+    void setSource (const std::string &);
+    void setSource (std::string &&);
+    void setFilename (const std::string &fn);
+    
+    void setTokenImage (const std::string &fn, TTokenImage &&);
+    void recordTokens ();
+    bool isRecording () const;
+    const TTokenImage &getTokenImage () const;
+    
+    void getNextToken ();
+    TToken getToken ();
+//    bool checkToken (TToken) ;
+    
+    double getDouble () const;
+    std::int64_t getInteger () const;
+    std::string getString () const;
+    const std::string &getIdentifier () const;
+    unsigned char getChar () const;
+    
+    void setAssemblerMode (bool);
+    
+    unsigned getLineNumber () const;
+    unsigned getLinePosition () const;
+    std::string getFilename () const;
+
+private:
+    typedef const char *TSourceIterator;
+
+    void initLexer (const char *begin);
+    void unmapSource ();
+    void checkConditional ();
+    bool skipComment ();
+    bool skipWhiteSpace ();
+    
+    void parseNumber ();
+    void parseHex ();
+    void parseOctal ();
+    void parseNumericChar ();
+    void parseQuotedString ();
+    void parseString ();
+    bool parseOperator (char base, TToken baseToken, char combine1, TToken combinedToken1, char combine2 = '\0', TToken combinedToken2 = TToken::Error);
+    void parseSymbol ();
+    
+    void setCurrentTokenAndAdvance (TToken);
+    
+    void recordToken ();
+    void replayToken ();
+    std::uint32_t getStringIndex (std::string_view);
+    
+    const char stringTerminator = '\'';
+    const char stringNumericEscape = '#';
+    
+    // the source is either mapped from the file or held in source, with a terminating NUL
+    std::string source;
+    void *mappedSource;
+    std::size_t mappedSize;
+    TSourceIterator sourceIt, lineBegin;
+    unsigned lineNumber, lastReadLineNumber, lastReadPosition;
+    std::string filename;
+    
+    TToken currentToken;
+    double fVal;
+    std::int64_t iVal;
+    // string constants refer to stringBuffer, other tokens to the source; identifiers are interned in lower case
+    std::string_view sVal;
+    const std::string *sValLower;
+    std::string stringBuffer, lowerBuffer;
+    std::unordered_set<std::string> identifiers;
+    unsigned char cVal;
+    bool assemblerMode;
+    
+    enum class TImageMode {None, Recording, Replaying};
+    TImageMode imageMode;
+    TTokenImage tokenImage;
+    std::size_t replayPosition;
+    unsigned replayLinePosition;
+    std::unordered_map<std::string, std::uint32_t> stringIndex;
+};
+
+inline void TLexer::TLexerImpl::setCurrentTokenAndAdvance (TToken t) {
+    currentToken = t;
+    ++sourceIt;
+}
+
+TLexer::TLexerImpl::TLexerImpl ():
+  mappedSource (nullptr), mappedSize (0), sValLower (&emptyIdentifier), imageMode (TImageMode::None) {
+}
+
+TLexer::TLexerImpl::~TLexerImpl () {
+    unmapSource ();
+}
+
+void TLexer::TLexerImpl::initLexer (const char *begin) {
+    lineBegin = sourceIt = begin;
     lineNumber = lastReadLineNumber = lastReadPosition = 1;
+    fVal = 0.0;
+    iVal = 0;
+    cVal = 0;
+    sVal = std::string_view ();
+    sValLower = &emptyIdentifier;
     assemblerMode = false;
     getNextToken ();
 }
 
+void TLexer::TLexerImpl::unmapSource () {
+    if (mappedSource) {
+        munmap (mappedSource, mappedSize);
+        mappedSource = nullptr;
+    }
+}
+
 void TLexer::TLexerImpl::setSource (const std::string &s) {
+    unmapSource ();
     source = s;
-    initLexer ();
+    initLexer (source.c_str ());
 }
 
 void TLexer::TLexerImpl::setSource (std::string &&s) {
+    unmapSource ();
     source = std::move (s);
-    initLexer ();
+    initLexer (source.c_str ());
 }
 
+// The file is mapped if the zero filled rest of its last page terminates it; otherwise it is read.
+
 void TLexer::TLexerImpl::setFilename (const std::string &fn) {
     filename = fn;
+    unmapSource ();
+    const int fd = open (fn.c_str (), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && !fstat (fd, &st) && st.st_size > 0 && st.st_size % sysconf (_SC_PAGE_SIZE)) {
+        void *p = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            close (fd);
+            mappedSource = p;
+            mappedSize = st.st_size;
+            source.clear ();
+            initLexer (static_cast<const char *> (p));
+            return;
+        }
+    }
+    if (fd >= 0)
+        close (fd);
     std::ifstream f (fn);
     std::stringstream buf;
     buf << f.rdbuf ();
     setSource (buf.str ());
 }
 
+void TLexer::TLexerImpl::setTokenImage (const std::string &fn, TTokenImage &&image) {
+    filename = fn;
+    tokenImage = std::move (image);
+    imageMode = TImageMode::Replaying;
+    replayPosition = 0;
+    lastReadLineNumber = lastReadPosition = 1;
+    replayToken ();
+}
+
+// the current token was lexed before recording started
+
+void TLexer::TLexerImpl::recordTokens () {
+    imageMode = TImageMode::Recording;
+    tokenImage = TTokenImage ();
+    stringIndex.clear ();
+    recordToken ();
+}
+
+bool TLexer::TLexerImpl::isRecording () const {
+    return imageMode == TImageMode::Recording;
+}
+
+const TTokenImage &TLexer::TLexerImpl::getTokenImage () const {
+    return tokenImage;
+}
+
+std::uint32_t TLexer::TLexerImpl::getStringIndex (std::string_view v) {
+    const std::string s (v);
+    std::unordered_map<std::string, std::uint32_t>::iterator it = stringIndex.find (s);
+    if (it != stringIndex.end ())
+        return it->second;
+    tokenImage.strings.push_back (s);
+    return stringIndex [s] = tokenImage.strings.size () - 1;
+}
+
+void TLexer::TLexerImpl::recordToken () {
+    tokenImage.tokens.push_back ({currentToken, lineNumber, static_cast<std::uint32_t> (sourceIt - lineBegin + 1), getStringIndex (sVal), getStringIndex (*sValLower), iVal, fVal, cVal});
+}
+
+// reading past the end of the image gives the terminator as lexing past the end of the source
+
+void TLexer::TLexerImpl::replayToken () {
+    if (replayPosition < tokenImage.tokens.size ()) {
+        const TTokenImage::TTokenRecord &record = tokenImage.tokens [replayPosition++];
+        currentToken = record.token;
+        lineNumber = record.lineNumber;
+        replayLinePosition = record.linePosition;
+        sVal = tokenImage.strings [record.string];
+        sValLower = &tokenImage.strings [record.identifier];
+        iVal = record.integer;
+        fVal = record.real;
+        cVal = record.character;
+    } else
+        currentToken = TToken::Terminator;
+}
+
 void TLexer::TLexerImpl::checkConditional () {
-    sVal.clear ();
-    if (std::string (sourceIt, 7) == "{$ifdef") {
-        if ((std::string (sourceIt, 13) != "{$ifdef ti99}") && 
-            (std::string (sourceIt, 20) != "{$ifdef ti99-banked}" || TConfig::target != TConfig::TTarget::TI_BANKCART) &&
-            (std::string (sourceIt, 19) != "{$ifdef ti99-plain}" || TConfig::target == TConfig::TTarget::TI_BANKCART))
-            while (*sourceIt && std::string (sourceIt, 8) != "{$endif}") {
+    sVal = std::string_view ();
+    if (startsWith (sourceIt, "{$ifdef")) {
+        if (!startsWith (sourceIt, "{$ifdef ti99}") && 
+            (!startsWith (sourceIt, "{$ifdef ti99-banked}") || TConfig::target != TConfig::TTarget::TI_BANKCART) &&
+            (!startsWith (sourceIt, "{$ifdef ti99-plain}") || TConfig::target == TConfig::TTarget::TI_BANKCART))
+            while (*sourceIt && !startsWith (sourceIt, "{$endif}")) {
                 if (*sourceIt == '\n') {
                     ++lineNumber;
                     lineBegin = sourceIt + 1;
                 }
                 ++sourceIt;
             }
-    } else if (std::string (sourceIt, 9) == "{$bank:on")
+    } else if (startsWith (sourceIt, "{$bank:on"))
         currentToken = TToken::BankOn;
-    else if (std::string (sourceIt, 10) == "{$bank:off")
+    else if (startsWith (sourceIt, "{$bank:off"))
         currentToken = TToken::BankOff;
 }
 
@@ -359,9 +549,9 @@ void TLexer::TLexerImpl::parseNumericChar () {
         parseNumber ();
         
     if (currentToken == TToken::IntegerConst && iVal >= 0 && iVal <= 255)
-        sVal += static_cast<char> (iVal);
+        stringBuffer += static_cast<char> (iVal);
     else
-        sVal += '?';
+        stringBuffer += '?';
     currentToken = TToken::StringConst;
 }
 
@@ -373,21 +563,21 @@ void TLexer::TLexerImpl::parseQuotedString () {
             done = true;
         } else if (*sourceIt == stringTerminator) {
             if (*(sourceIt + 1) == stringTerminator) {
-                sVal.push_back (stringTerminator);
+                stringBuffer.push_back (stringTerminator);
                 ++sourceIt;
             } else {
                 currentToken = TToken::StringConst;
                 done = true;
             }
         } else 
-            sVal.push_back (*sourceIt);
+            stringBuffer.push_back (*sourceIt);
         ++sourceIt;
     }
     
 }
 
 void TLexer::TLexerImpl::parseString () {
-    sVal.clear ();
+    stringBuffer.clear ();
     
     char c = *sourceIt;
     while (c == stringTerminator || c == stringNumericEscape) {
@@ -398,6 +588,7 @@ void TLexer::TLexerImpl::parseString () {
             parseNumericChar ();
         c = *sourceIt;
     }
+    sVal = stringBuffer;
     
     if (currentToken != TToken::Error && sVal.length () == 1) {
         currentToken = TToken::CharConst;
@@ -406,15 +597,25 @@ void TLexer::TLexerImpl::parseString () {
 }
 
 void TLexer::TLexerImpl::parseSymbol () {
-    sVal.clear (); 
-    sValLower.clear ();
+    const char *begin = sourceIt;
     while (isalnum (*sourceIt) || *sourceIt == '_') 
-        sVal.push_back (*sourceIt++);
-    sValLower.resize (sVal.length ());
-    std::transform (sVal.begin (), sVal.end (), sValLower.begin (), ::tolower);
+        ++sourceIt;
+    sVal = std::string_view (begin, sourceIt - begin);
+    
+    const TKeyword *keyword = keywordTable [keywordHash (begin, sVal.length ())];
+    if (keyword && keyword->name.length () == sVal.length () && std::equal (sVal.begin (), sVal.end (), keyword->name.begin (), [] (char a, char b) { return toLower (a) == b; })) {
+        currentToken = keyword->token;
+        sValLower = &getKeywordName (keyword);
+        return;
+    }
     
-    TStringTokenMap::const_iterator it = reservedWords.find (sValLower);
-    currentToken = (it == reservedWords.end ()) ? TToken::Identifier : it->second;
+    lowerBuffer.resize (sVal.length ());
+    std::transform (sVal.begin (), sVal.end (), lowerBuffer.begin (), toLower);
+    std::unordered_set<std::string>::const_iterator it = identifiers.find (lowerBuffer);
+    if (it == identifiers.end ())
+        it = identifiers.insert (lowerBuffer).first;
+    sValLower = &*it;
+    currentToken = TToken::Identifier;
 }
 
 bool TLexer::TLexerImpl::parseOperator (char base, TToken baseToken, char combine1, TToken combinedToken1, char combine2, TToken combinedToken2) {
@@ -430,6 +631,10 @@ bool TLexer::TLexerImpl::parseOperator (char base, TToken baseToken, char combin
 }
 
 void TLexer::TLexerImpl::getNextToken () {
+    if (imageMode == TImageMode::Replaying) {
+        replayToken ();
+        return;
+    }
     currentToken = TToken::Error;
     while (skipWhiteSpace () || skipComment ());
     
@@ -448,11 +653,11 @@ void TLexer::TLexerImpl::getNextToken () {
         else if (!c)
             currentToken = TToken::Terminator;
         else {
-            TCharTokenMap::const_iterator it = reservedSymbols.find (c);
-            if (it == reservedSymbols.end ())
+            const TToken t = symbolTable [static_cast<unsigned char> (c)];
+            if (t == TToken::Identifier)
                 setCurrentTokenAndAdvance (TToken::Error);
-            else if (it->second != TToken::Error)
-                setCurrentTokenAndAdvance (it->second);
+            else if (t != TToken::Error)
+                setCurrentTokenAndAdvance (t);
             else
               parseOperator ('.', TToken::Point, '.', TToken::Points) ||
               parseOperator ('<', TToken::LessThan, '=', TToken::LessEqual, '>', TToken::NotEqual) ||
@@ -460,11 +665,13 @@ void TLexer::TLexerImpl::getNextToken () {
               parseOperator (':', TToken::Colon, '=', TToken::Define);
         }
     }
+    if (imageMode == TImageMode::Recording)
+        recordToken ();
 }
 
 inline TToken TLexer::TLexerImpl::getToken () {
     lastReadLineNumber = lineNumber;
-    lastReadPosition = sourceIt - lineBegin + 1;
+    lastReadPosition = imageMode == TImageMode::Replaying ? replayLinePosition : sourceIt - lineBegin + 1;
     return currentToken;
 }
 
@@ -487,11 +694,11 @@ inline std::int64_t TLexer::TLexerImpl::getInteger () const {
 }
     
 inline std::string TLexer::TLexerImpl::getString () const {
-    return sVal;
+    return std::string (sVal);
 }
 
-inline std::string TLexer::TLexerImpl::getIdentifier () const {
-    return sValLower;
+inline const std::string &TLexer::TLexerImpl::getIdentifier () const {
+    return *sValLower;
 }
 
 inline unsigned char TLexer::TLexerImpl::getChar () const {
@@ -562,6 +769,22 @@ void TLexer::setFilename (const std::string &fn) {
     impl ()->setFilename (fn);
 }
 
+void TLexer::setTokenImage (const std::string &fn, TTokenImage &&image) {
+    impl ()->setTokenImage (fn, std::move (image));
+}
+
+void TLexer::recordTokens () {
+    impl ()->recordTokens ();
+}
+
+bool TLexer::isRecording () const {
+    return impl ()->isRecording ();
+}
+
+const TTokenImage &TLexer::getTokenImage () const {
+    return impl ()->getTokenImage ();
+}
+
 void TLexer::getNextToken () {
     impl ()->getNextToken ();
 }
@@ -586,7 +809,7 @@ std::string TLexer::getString () const {
     return impl ()->getString ();
 }
 
-std::string TLexer::getIdentifier () const {
+const std::string &TLexer::getIdentifier () const {
     return impl ()->getIdentifier ();
 }
 
@@ -7,6 +7,7 @@
 #include <memory>
 #include <ostream>
 #include <cstdint>
+#include <vector>
 
 namespace statpascal {
 
@@ -41,6 +42,21 @@ enum class TToken {
 
 std::ostream &operator << (std::ostream &, TToken);
 
+/** Tokens of a source in the order read by the parser together with their values and
+    positions. Replaying the image gives the same results as lexing the source again. */
+struct TTokenImage {
+    struct TTokenRecord {
+        TToken token;
+        std::uint32_t lineNumber, linePosition;
+        std::uint32_t string, identifier;	// indices into strings
+        std::int64_t integer;
+        double real;
+        unsigned char character;
+    };
+    std::vector<TTokenRecord> tokens;
+    std::vector<std::string> strings;
+};
+
 class TLexer final {
 public:
     TLexer ();
@@ -53,14 +69,17 @@ public:
     void setSource (const std::string &);
     void setSource (std::string &&);
     void setFilename (const std::string &fn);
+    
+    /** reads the tokens from an image instead of lexing a source; fn is used for error positions */
+    void setTokenImage (const std::string &fn, TTokenImage &&);
+    /** records all tokens read from now on in the token image */
+    void recordTokens ();
+    bool isRecording () const;
+    const TTokenImage &getTokenImage () const;
 
-private:    
-    friend class TCompilerImpl;
     void getNextToken ();
     TToken getToken ();
     
-public:
-    
     /** Returns true and parses next token if the argument is the current token.
         If the argument and the current token do not match, the method returns false
         and does not parse the next token. */
@@ -70,8 +89,8 @@ public:
     std::int64_t getInteger () const;
     std::string getString () const;
     
-    /** same as getString converted to lower case */
-    std::string getIdentifier () const;
+    /** same as getString converted to lower case; valid for the lifetime of the lexer */
+    const std::string &getIdentifier () const;
     unsigned char getChar () const;
     
     /** assembler mode: treats > as hex indicator */
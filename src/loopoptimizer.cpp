@@ -0,0 +1,440 @@
+#include "loopoptimizer.hpp"
+#include "syntaxtreewalker.hpp"
+#include "expressionkey.hpp"
+#include "compilerimpl.hpp"
+#include "predefined.hpp"
+#include "config.hpp"
+
+#include <map>
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+// Collects the symbols assigned in a statement. A variable used without dereference - as
+// target of an assignment, as var argument or in an address - is counted as assigned; the
+// base of an array element or record component which is only read is not.
+
+class TLoopUsage: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TReferenceVariable &) override;
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TPointerDereference &) override;
+    virtual void generateCode (TLabeledStatement &) override;
+    virtual void generateCode (TGotoStatement &) override;
+
+    std::map<const TSymbol *, std::size_t> writes, gotos;
+    std::set<const TSymbol *> reads, labels;
+    bool hasCalls = false, hasReferenceWrites = false;
+};
+
+void TLoopUsage::generateCode (TFunctionCall &functionCall) {
+    hasCalls = true;
+    inherited::generateCode (functionCall);
+}
+
+void TLoopUsage::generateCode (TVariable &variable) {
+    ++writes [variable.getSymbol ()];
+}
+
+void TLoopUsage::generateCode (TReferenceVariable &referenceVariable) {
+    ++writes [referenceVariable.getSymbol ()];
+    hasReferenceWrites = true;
+}
+
+void TLoopUsage::generateCode (TLValueDereference &lValueDereference) {
+    TExpressionBase *lValue = lValueDereference.getLValue ();
+    for (;;)
+        if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (lValue)) {
+            visit (arrayIndex->getIndexExpression ());
+            lValue = arrayIndex->getBaseExpression ();
+        } else if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (lValue))
+            lValue = recordComponent->getExpression ();
+        else
+            break;
+    if (lValue->isSymbol ())
+        reads.insert (static_cast<TVariable *> (lValue)->getSymbol ());
+    else
+        visit (lValue);
+}
+
+void TLoopUsage::generateCode (TPointerDereference &pointerDereference) {
+    TExpressionBase *base = pointerDereference.getExpression ();
+    if (base->isSymbol ())
+        reads.insert (static_cast<TVariable *> (base)->getSymbol ());
+    else
+        inherited::generateCode (pointerDereference);
+}
+
+void TLoopUsage::generateCode (TLabeledStatement &labeledStatement) {
+    labels.insert (labeledStatement.getLabel ());
+    inherited::generateCode (labeledStatement);
+}
+
+void TLoopUsage::generateCode (TGotoStatement &gotoStatement) {
+    ++gotos [gotoStatement.getLabel ()];
+    inherited::generateCode (gotoStatement);
+}
+
+
+struct TLoop {
+    TSymbol *controlVariable;
+    TPredefinedRoutine::TRoutine step;
+    bool isControlVariableStepped;	// changed only by the increment of the loop
+    TLoopUsage usage;
+    std::map<std::string, TSymbol *> temporaries;
+    std::vector<TStatement *> preheader, steps;
+};
+
+class TLoopRewriter: public TSyntaxTreeRewriter, public TExpressionKey {
+using inherited = TSyntaxTreeRewriter;
+public:
+    TLoopRewriter (TBlock &block, const std::set<const TSymbol *> &nonLocal);
+
+    void optimize ();
+
+    virtual void generateCode (TSimpleExpression &) override;
+    virtual void generateCode (TTerm &) override;
+    virtual void generateCode (TPrefixedExpression &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TStatementSequence &) override;
+
+protected:
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *) override;
+    virtual TStatement *rewriteStatement (TStatement *) override;
+    virtual std::string getVariableKey (const TSymbol *) override;
+
+private:
+    void optimizeLoop (std::vector<TStatement *> &, std::size_t &pos);
+
+    bool isInvariant (const TSymbol *, std::size_t writes = 0) const;
+    std::string getInductionKey (TExpressionBase *, std::size_t &stride);
+    bool isHoisted (TExpressionBase *);
+    bool isElementPointer (TArrayIndex *, std::string &key, std::size_t &step);
+    bool isHoistedAssignment (TAssignment &);
+    bool getControlOffset (TExpressionBase *index, std::int64_t &offset);
+
+    TExpressionBase *hoistExpression (TExpressionBase *);
+    TExpressionBase *createElementPointer (const std::string &key, TArrayIndex *, std::size_t step);
+    TSymbol *createTemporary (const std::string &key, TType *);
+    TVariable *createVariable (TSymbol *);
+
+    TBlock &block;
+    const std::set<const TSymbol *> &nonLocal;
+    std::set<const TSymbol *> locals, temporaries;
+    TLoopUsage routineUsage;
+    TSharedExpressionCollector sharedExpressions;
+    TLoop *loop;
+};
+
+TLoopRewriter::TLoopRewriter (TBlock &block, const std::set<const TSymbol *> &nonLocal):
+  block (block), nonLocal (nonLocal), locals (block.getSymbols ().begin (), block.getSymbols ().end ()), loop (nullptr) {
+}
+
+void TLoopRewriter::optimize () {
+    TStatement *statements = block.getStatements ();
+    routineUsage.visit (statements);
+    sharedExpressions.visit (statements);
+    rewrite (statements);
+}
+
+// Loops are optimized from the innermost: the preheaders of inner loops are part of the
+// body of the outer loop.
+
+void TLoopRewriter::generateCode (TStatementSequence &statementSequence) {
+    inherited::generateCode (statementSequence);
+    if (!loop) {
+        std::vector<TStatement *> &statements = getStatements (statementSequence);
+        for (std::size_t pos = 1; pos + 2 < statements.size (); ++pos)
+            optimizeLoop (statements, pos);
+    }
+}
+
+// invariant subexpressions are replaced as a whole
+
+void TLoopRewriter::generateCode (TSimpleExpression &simpleExpression) {
+    if (!isHoisted (&simpleExpression))
+        inherited::generateCode (simpleExpression);
+}
+
+void TLoopRewriter::generateCode (TTerm &term) {
+    if (!isHoisted (&term))
+        inherited::generateCode (term);
+}
+
+void TLoopRewriter::generateCode (TPrefixedExpression &prefixedExpression) {
+    if (!isHoisted (&prefixedExpression))
+        inherited::generateCode (prefixedExpression);
+}
+
+void TLoopRewriter::generateCode (TArrayIndex &arrayIndex) {
+    std::string key;
+    std::size_t step;
+    if (!isElementPointer (&arrayIndex, key, step))
+        inherited::generateCode (arrayIndex);
+}
+
+// the record of a with-statement is also accessed outside of the loop
+
+void TLoopRewriter::generateCode (TRecordComponent &recordComponent) {
+    if (!sharedExpressions.shared.count (recordComponent.getExpression ()))
+        inherited::generateCode (recordComponent);
+}
+
+void TLoopRewriter::generateCode (TAssignment &assignment) {
+    if (!isHoistedAssignment (assignment))
+        inherited::generateCode (assignment);
+}
+
+TExpressionBase *TLoopRewriter::rewriteExpression (TExpressionBase *expression) {
+    if (!loop)
+        return expression;
+    if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression)) {
+        std::string key;
+        std::size_t step;
+        if (isElementPointer (arrayIndex, key, step))
+            return createElementPointer (key, arrayIndex, step);
+    } else if (isHoisted (expression))
+        return hoistExpression (expression);
+    return expression;
+}
+
+TStatement *TLoopRewriter::rewriteStatement (TStatement *statement) {
+    TAssignment *assignment = dynamic_cast<TAssignment *> (statement);
+    if (!assignment || !isHoistedAssignment (*assignment))
+        return statement;
+    loop->preheader.push_back (assignment);
+    --loop->usage.writes [static_cast<TVariable *> (assignment->getLValue ())->getSymbol ()];
+    return block.getCompiler ().createMemoryPoolObject<TEmptyStatement> ();
+}
+
+// The loop consists of the increment of the control variable, the body and the conditional
+// jump to the increment; statements [pos - 1] enters it at the body. Computations moved out
+// of the loop are placed before this jump after the check for an empty loop.
+
+void TLoopRewriter::optimizeLoop (std::vector<TStatement *> &statements, std::size_t &pos) {
+    TGotoStatement *entry = dynamic_cast<TGotoStatement *> (statements [pos - 1]),
+                   *backEdge = dynamic_cast<TGotoStatement *> (statements [pos + 2]);
+    TLabeledStatement *increment = dynamic_cast<TLabeledStatement *> (statements [pos]),
+                      *body = dynamic_cast<TLabeledStatement *> (statements [pos + 1]);
+    if (!entry || !backEdge || !increment || !body || entry->getCondition () || entry->getLabel () != body->getLabel () ||
+        !backEdge->getCondition () || backEdge->getLabel () != increment->getLabel ())
+        return;
+    TRoutineCall *routineCall = dynamic_cast<TRoutineCall *> (increment->getStatement ());
+    TPredefinedRoutine *incDec = routineCall ? dynamic_cast<TPredefinedRoutine *> (routineCall->getRoutineCall ()) : nullptr;
+    if (!incDec || (incDec->getRoutine () != TPredefinedRoutine::Inc && incDec->getRoutine () != TPredefinedRoutine::Dec) ||
+        incDec->getArguments ().size () != 1 || !incDec->getArguments () [0]->isSymbol () || incDec->getArguments () [0]->isReference ())
+        return;
+
+    TLoop current;
+    current.controlVariable = static_cast<TVariable *> (incDec->getArguments () [0])->getSymbol ();
+    current.step = incDec->getRoutine ();
+    for (std::size_t i = pos; i <= pos + 2; ++i)
+        current.usage.visit (statements [i]);
+
+    // no jumps into the loop except the entry
+    for (const TSymbol *label: current.usage.labels)
+        if (routineUsage.gotos [label] != current.usage.gotos [label] + (label == body->getLabel ()))
+            return;
+
+    loop = &current;
+    current.isControlVariableStepped = isInvariant (current.controlVariable, 1);
+    rewrite (statements [pos + 1]);
+    loop = nullptr;
+
+    if (!current.steps.empty ()) {
+        TCompilerImpl &compiler = block.getCompiler ();
+        current.steps.insert (current.steps.begin (), routineCall);
+        statements [pos] = compiler.createMemoryPoolObject<TLabeledStatement> (increment->getLabel (), compiler.createMemoryPoolObject<TStatementSequence> (std::move (current.steps)));
+    }
+    statements.insert (statements.begin () + pos - 1, current.preheader.begin (), current.preheader.end ());
+    pos += current.preheader.size ();
+}
+
+// A variable is invariant if it has the given number of assignments in the loop and cannot be
+// changed through a pointer, a var parameter or a called routine.
+
+bool TLoopRewriter::isInvariant (const TSymbol *s, std::size_t writes) const {
+    std::map<const TSymbol *, std::size_t>::const_iterator it = loop->usage.writes.find (s);
+    if ((it == loop->usage.writes.end () ? 0 : it->second) != writes ||
+        !(s->checkSymbolFlag (TSymbol::Variable) || s->checkSymbolFlag (TSymbol::Parameter)) ||
+        s->checkSymbolFlag (TSymbol::Alias) || s->checkSymbolFlag (TSymbol::Absolute) || s->isAliased () || !isScalarType (s->getType ()))
+        return false;
+    if (locals.count (s))
+        return !loop->usage.hasCalls || !nonLocal.count (s);
+    return !loop->usage.hasCalls && !loop->usage.hasReferenceWrites;
+}
+
+std::string TLoopRewriter::getVariableKey (const TSymbol *s) {
+    return isInvariant (s) ? getSymbolKey ('s', s) : std::string ();
+}
+
+// Returns a key identifying an address which changes by the same number of bytes in each
+// iteration: an array indexed by the control variable, or an element or component of it
+// accessed with an invariant index.
+
+std::string TLoopRewriter::getInductionKey (TExpressionBase *expression, std::size_t &stride) {
+    if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (expression)) {
+        const std::string base = getInductionKey (recordComponent->getExpression (), stride);
+        return base.empty () ? base : base + '.' + recordComponent->getComponent ();
+    }
+    TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression);
+    if (!arrayIndex || !arrayIndex->getBaseExpression ()->getType ()->isArray ())
+        return std::string ();
+    std::int64_t offset;
+    if (getControlOffset (arrayIndex->getIndexExpression (), offset)) {
+        const std::string base = getAddressKey (arrayIndex->getBaseExpression ());
+        stride = arrayIndex->getType ()->getSize ();
+        return base.empty () ? base : base + "[@" + std::to_string (offset) + ']';
+    }
+    const std::string index = getValueKey (arrayIndex->getIndexExpression ());
+    const std::string base = index.empty () ? index : getInductionKey (arrayIndex->getBaseExpression (), stride);
+    return base.empty () ? base : base + '[' + index + ']';
+}
+
+// An array element is accessed through a pointer moved by step elements in each iteration if
+// the address would need a multiplication or, with step 0, through a pointer set before the
+// loop if its invariant address needs more than a scaled index. The conversion of a string
+// to a pointer gives its characters, so strings are excluded.
+
+bool TLoopRewriter::isElementPointer (TArrayIndex *arrayIndex, std::string &key, std::size_t &step) {
+    if (!loop || arrayIndex->getType () == &stdType.String)
+        return false;
+    std::size_t stride;
+    const std::size_t size = arrayIndex->getType ()->getSize ();
+    key = getInductionKey (arrayIndex, stride);
+    // leaf routines keep their variables in registers; a stepped pointer would stay in memory
+    if (!key.empty () && routineUsage.hasCalls && !isScaledIndex (stride) && size && stride % size == 0) {
+        step = stride / size;
+        return true;
+    }
+    step = 0;
+    key = getAddressKey (arrayIndex);
+    return !key.empty () && getAddressCost (arrayIndex) >= 2;
+}
+
+// The preheader of an inner loop is moved as a whole if it is invariant in the outer loop.
+
+bool TLoopRewriter::isHoistedAssignment (TAssignment &assignment) {
+    TExpressionBase *lValue = assignment.getLValue (), *expression = assignment.getExpression ();
+    if (!loop || !lValue->isSymbol () || lValue->isReference () || !temporaries.count (static_cast<TVariable *> (lValue)->getSymbol ()))
+        return false;
+    if (lValue->getType ()->isPointer ())
+        return expression->isTypeCast () && !getAddressKey (static_cast<TTypeCast *> (expression)->getExpression ()).empty ();
+    return !getValueKey (expression).empty ();
+}
+
+bool TLoopRewriter::isHoisted (TExpressionBase *expression) {
+    return loop && (dynamic_cast<TSimpleExpression *> (expression) || dynamic_cast<TTerm *> (expression) || dynamic_cast<TPrefixedExpression *> (expression)) &&
+        !getValueKey (expression).empty ();
+}
+
+// index of the form control variable plus or minus a constant
+
+bool TLoopRewriter::getControlOffset (TExpressionBase *index, std::int64_t &offset) {
+    if (!loop->isControlVariableStepped)
+        return false;
+    while (index->isTypeCast ())
+        index = static_cast<TTypeCast *> (index)->getExpression ();
+    if (index->isLValueDereference ()) {
+        TExpressionBase *lValue = static_cast<TLValueDereference *> (index)->getLValue ();
+        offset = 0;
+        return lValue->isSymbol () && !lValue->isReference () && static_cast<TVariable *> (lValue)->getSymbol () == loop->controlVariable;
+    }
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (index)) {
+        TExpressionBase *right = simpleExpression->getRightExpression ();
+        const TToken operation = simpleExpression->getOperation ();
+        if ((operation == TToken::Add || operation == TToken::Sub) && right->isConstant () && getControlOffset (simpleExpression->getLeftExpression (), offset)) {
+            const std::int64_t n = static_cast<TConstantValue *> (right)->getConstant ()->getInteger ();
+            offset += operation == TToken::Add ? n : -n;
+            return true;
+        }
+    }
+    return false;
+}
+
+TExpressionBase *TLoopRewriter::hoistExpression (TExpressionBase *expression) {
+    TSymbol *&temporary = loop->temporaries [getValueKey (expression)];
+    if (!temporary) {
+        temporary = createTemporary ("$inv", expression->getType ());
+        loop->preheader.push_back (block.getCompiler ().createMemoryPoolObject<TAssignment> (createVariable (temporary), expression));
+    }
+    return block.getCompiler ().createMemoryPoolObject<TLValueDereference> (createVariable (temporary));
+}
+
+// The pointer is set to the element accessed in the first iteration and moved with the
+// increment of the loop.
+
+TExpressionBase *TLoopRewriter::createElementPointer (const std::string &key, TArrayIndex *arrayIndex, std::size_t step) {
+    TCompilerImpl &compiler = block.getCompiler ();
+    TSymbol *&pointer = loop->temporaries [key];
+    if (!pointer) {
+        TType *pointerType = compiler.createMemoryPoolObject<TPointerType> (arrayIndex->getType ());
+        pointer = createTemporary ("$ptr", pointerType);
+        loop->preheader.push_back (compiler.createMemoryPoolObject<TAssignment> (createVariable (pointer), compiler.createMemoryPoolObject<TTypeCast> (pointerType, arrayIndex)));
+        if (step) {
+            // an element addressed through the pointer is not invariant
+            ++loop->usage.writes [pointer];
+            std::vector<TExpressionBase *> args {createVariable (pointer)};
+            if (step > 1)
+                args.push_back (TExpressionBase::createInt64Constant (step, block));
+            loop->steps.push_back (compiler.createMemoryPoolObject<TRoutineCall> (
+                compiler.createMemoryPoolObject<TPredefinedRoutine> (loop->step, pointerType, std::move (args))));
+        }
+    }
+    return compiler.createMemoryPoolObject<TPointerDereference> (createVariable (pointer));
+}
+
+TSymbol *TLoopRewriter::createTemporary (const std::string &prefix, TType *type) {
+    TSymbolList &symbols = block.getSymbols ();
+    TSymbol *s = symbols.addVariable (prefix + std::to_string (symbols.size ()), type).symbol;
+    locals.insert (s);
+    temporaries.insert (s);
+    return s;
+}
+
+TVariable *TLoopRewriter::createVariable (TSymbol *s) {
+    return block.getCompiler ().createMemoryPoolObject<TVariable> (s, block);
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ()) {
+            blocks.push_back (s->getBlock ());
+            collectBlocks (*s->getBlock (), blocks);
+        }
+}
+
+}
+
+void TLoopOptimizer::optimize (TBlock &programBlock) {
+    if (!TConfig::optimizeLoops)
+        return;
+    std::vector<TBlock *> blocks {&programBlock};
+    collectBlocks (programBlock, blocks);
+
+    // variables used by nested routines
+    std::set<const TSymbol *> nonLocal;
+    for (TBlock *block: blocks) {
+        TLoopUsage usage;
+        usage.visit (block->getStatements ());
+        const std::size_t level = block->getSymbols ().getLevel ();
+        for (const std::pair<const TSymbol *const, std::size_t> &it: usage.writes)
+            if (it.first->getLevel () < level)
+                nonLocal.insert (it.first);
+        for (const TSymbol *s: usage.reads)
+            if (s->getLevel () < level)
+                nonLocal.insert (s);
+    }
+
+    for (TBlock *block: blocks)
+        TLoopRewriter (*block, nonLocal).optimize ();
+}
+
+}
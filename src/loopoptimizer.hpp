@@ -0,0 +1,32 @@
+/** \file loopoptimizer.hpp
+
+    Optimizes the loops created by TForStatement::parse:
+
+    - integer and real arithmetic on variables not modified in the loop is computed
+      before the loop and kept in a temporary variable
+    - the address of an array element with an invariant index is computed before
+      the loop and the element is accessed through a pointer
+    - an array element indexed by the control variable (plus or minus a constant) is
+      accessed through a pointer which is incremented or decremented together with
+      the control variable. This is not done in routines without calls, whose
+      variables are kept in registers by the code generators.
+
+    A variable is invariant if it is not assigned in the loop and its address is not
+    taken. If the loop calls routines, only local variables of the routine which are
+    not used by nested routines are invariant; other variables are not invariant if
+    the loop assigns a var parameter.
+*/
+
+#pragma once
+
+namespace statpascal {
+
+class TBlock;
+
+class TLoopOptimizer final {
+public:
+    /** optimizes the loops of the program block and all routines */
+    static void optimize (TBlock &programBlock);
+};
+
+}
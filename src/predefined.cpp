@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <map>
+#include <set>
 #include <unordered_map>
 
 namespace statpascal {
@@ -95,6 +96,43 @@ TFunctionCall *TCombineRoutine::createCombineCall (TBlock &block, TType *resultT
 }
 
 
+class TMaskRoutine: public TRuntimeRoutine {
+using inherited = TRuntimeRoutine;
+public:
+    enum TKind {Any, All, Which, FirstIndex};
+    TMaskRoutine (TBlock &, TKind, std::vector<TExpressionBase *> &&);
+};
+
+TMaskRoutine::TMaskRoutine (TBlock &block, TKind kind, std::vector<TExpressionBase *> &&args):
+  inherited (kind == Which ? static_cast<TType *> (&stdType.Int64Vector) : kind == FirstIndex ? &stdType.Int64 : &stdType.Boolean) {
+    static const std::set<std::string> comparisons = {
+        "__vec_equal", "__vec_not_equal", "__vec_less_equal", "__vec_greater_equal", "__vec_less", "__vec_greater"
+    };
+    TCompilerImpl &compiler = block.getCompiler ();
+    
+    // a vector comparison as argument is evaluated by the runtime up to the first match instead of creating the mask
+    std::string name = "__vbool";
+    std::vector<TExpressionBase *> callArgs = {args [0]};
+    if (args [0]->isFunctionCall ())
+        if (TRoutineValue *routine = dynamic_cast<TRoutineValue *> (static_cast<TFunctionCall *> (args [0])->getFunction ()))
+            if (comparisons.count (routine->getSymbol ()->getName ())) {
+                name = routine->getSymbol ()->getName ();
+                callArgs = static_cast<TFunctionCall *> (args [0])->getArguments ();
+            }
+            
+    if (kind == Which)
+        appendTransformedNode (createRuntimeCall (name + "_which", &stdType.Int64Vector, std::move (callArgs), block, false));
+    else {
+        callArgs.push_back (createConstant<std::int64_t> (kind != All, &stdType.Boolean, block));
+        TExpressionBase *first = createRuntimeCall (name + "_first", &stdType.Int64, std::move (callArgs), block, false);
+        if (kind == FirstIndex)
+            appendTransformedNode (first);
+        else
+            appendTransformedNode (compiler.createMemoryPoolObject<TExpression> (first, createInt64Constant (0, block), kind == Any ? TToken::NotEqual : TToken::Equal, &stdType.Boolean));
+    }
+}
+
+
 class TResizeRoutine: public TRuntimeRoutine {
 using inherited = TRuntimeRoutine;
 public:
@@ -121,7 +159,15 @@ public:
 TNewRoutine::TNewRoutine (TBlock &block, std::vector<TExpressionBase *> &&args):
   inherited (&stdType.Void) {
       const TType *type = args [0]->getType ()->getBaseType ();
-      appendTransformedNode (createRuntimeCall ("__new", &stdType.Void, {
+      // new (p, arena) and new (p, count, arena) allocate from an arena
+      TExpressionBase *arena = args.back ()->getType ()->isPointer () && args.size () > 1 ? args.back () : nullptr;
+      if (arena)
+          args.pop_back ();
+#ifdef CREATE_9900
+      if (arena)
+          block.getCompiler ().errorMessage (TCompilerImpl::InvalidType, "Arenas are not supported on this target");
+#endif
+      std::vector<TExpressionBase *> callArgs = {
           static_cast<TLValueDereference *> (args [0])->getLValue (),
           args.size () == 2 ? args [1] : createInt64Constant (1, block),
           createInt64Constant (type->getSize (), block),
@@ -129,8 +175,10 @@ TNewRoutine::TNewRoutine (TBlock &block, std::vector<TExpressionBase *> &&args):
           createAnyManagerIndex (type, block),
           createVariableAccess (TConfig::globalRuntimeDataPtr, block)
 #endif          
-         },
-         block, false));
+      };
+      if (arena)
+          callArgs.push_back (arena);
+      appendTransformedNode (createRuntimeCall (arena ? "__new_arena" : "__new", &stdType.Void, std::move (callArgs), block, false));
 }
 
 
@@ -387,6 +435,7 @@ enum TName {
     Reset, Rewrite,                   
     RuntimeCall,
     Addr, Ord, Odd, Succ, Pred, Inc, Dec, Write, Writeln, Read, Readln, Combine, Resize,
+    Any, All, Which, FirstIndex,
     Exit, Break, Halt
 };
 
@@ -414,12 +463,18 @@ const TRoutineMap routineMap = {
     {"ord", 	   {{Ord, Int_64, {Enumerated}}}},
     
     {"new", 	   {{New, Void, {Pointer | LValueRequired}},
-                    {New, Void, {Pointer | LValueRequired, Int_64}}}},
+                    {New, Void, {Pointer | LValueRequired, Int_64}},
+                    {New, Void, {Pointer | LValueRequired, Pointer}},
+                    {New, Void, {Pointer | LValueRequired, Int_64, Pointer}}}},
     {"dispose",    {{RuntimeCall, Void, {Pointer}, "__dispose", AppendGlobalRuntimeDataPtr}}},
     
     {"resize", 	   {{Resize, Void, {Vector | LValueRequired, Int_64}, ""}}},
     {"size",	   {{RuntimeCall, Int_64, {Vector}, "__size_vec", RuntimeNoParaCheck}}},
     {"rev", 	   {{RuntimeCall, Vector, {Vector}, "__rev_vec", RuntimeNoParaCheck | KeepType}}},
+    {"any", 	   {{Any, Bool, {Vector | Bool}}}},
+    {"all", 	   {{All, Bool, {Vector | Bool}}}},
+    {"which", 	   {{Which, Void, {Vector | Bool}}}},
+    {"firstindex", {{FirstIndex, Int_64, {Vector | Bool}}}},
     
     {"assign", 	   {{RuntimeCall, Void, {File | DerefLValueRequired, String}, "__assign"}}},
     {"reset", 	   {{Reset, Void, {File | DerefLValueRequired}},
@@ -616,9 +671,11 @@ TExpressionBase *TPredefinedRoutine::parse (const std::string &identifier, TBloc
                     case RoutineDescription::Reset:
                     case RoutineDescription::Rewrite:
                         return compiler.createMemoryPoolObject<TResetRewriteRoutine> (block, routineDescription.name == RoutineDescription::Reset, std::move (args));
-                    case RoutineDescription::Addr:
-                        if (args [0]->isSymbol ())
-                            static_cast<TVariable *> (args [0])->getSymbol ()->setAliased ();
+                    case RoutineDescription::Addr: {
+                        TExpressionBase *base = args [0]->isLValueDereference () ? static_cast<TLValueDereference *> (args [0])->getLValue () : args [0];
+                        if (base->isSymbol ())
+                            static_cast<TVariable *> (base)->getSymbol ()->setAliased ();
+                    }
                     case RoutineDescription::Ord:
                     case RoutineDescription::Chr:
                         createCast = true;
@@ -627,6 +684,14 @@ TExpressionBase *TPredefinedRoutine::parse (const std::string &identifier, TBloc
                         return compiler.createMemoryPoolObject<TResizeRoutine> (block, std::move (args));
                     case RoutineDescription::New:
                         return compiler.createMemoryPoolObject<TNewRoutine> (block, std::move (args));
+                    case RoutineDescription::Any:
+                        return compiler.createMemoryPoolObject<TMaskRoutine> (block, TMaskRoutine::Any, std::move (args));
+                    case RoutineDescription::All:
+                        return compiler.createMemoryPoolObject<TMaskRoutine> (block, TMaskRoutine::All, std::move (args));
+                    case RoutineDescription::Which:
+                        return compiler.createMemoryPoolObject<TMaskRoutine> (block, TMaskRoutine::Which, std::move (args));
+                    case RoutineDescription::FirstIndex:
+                        return compiler.createMemoryPoolObject<TMaskRoutine> (block, TMaskRoutine::FirstIndex, std::move (args));
                     default:
                         break;
                 }
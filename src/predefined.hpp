@@ -23,6 +23,7 @@ public:
     const std::vector<TExpressionBase *> &getArguments () const;
 
 private:
+    friend class TSyntaxTreeRewriter;
     TRoutine routine;
     std::vector<TExpressionBase *> arguments;
 };
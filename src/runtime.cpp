@@ -1,4 +1,6 @@
 #include "runtime.hpp"
+#include "runtimeheap.hpp"
+#include "heapprofile.hpp"
 #include <stdexcept>
 
 #include <cstring>
@@ -27,11 +29,12 @@ TAnyManager *TRuntimeData::getAnyManager (std::size_t index) {
 }
 
 std::size_t TRuntimeData::registerStringConstant (const std::string &s) {
-    for (std::size_t i = 0; i < stringPool.size (); ++i)
-        if (stringPool [i].get<std::string> () == s)
-            return i;
-    stringPool.emplace_back (TAnyValue (s));
-    return stringPool.size () - 1;
+    const auto [it, inserted] = stringIndex.try_emplace (s, stringPool.size ());
+    if (inserted) {
+        stringPool.emplace_back (TAnyValue (s));
+        stringPool.back ().makeImmortal ();
+    }
+    return it->second;
 }
 
 TAnyValue TRuntimeData::getStringConstant (std::size_t index) {
@@ -49,24 +52,32 @@ void *TRuntimeData::getData (std::size_t index) {
 }
 
 void *TRuntimeData::allocateMemory (std::size_t count, std::size_t size, std::size_t anyManagerIndex) {
-    // TODO: Lock
-    void *p = std::calloc (count, size);
-    if (anyManagerIndex)
-        dynamicArrayMap [p] = {size, count, anyManagerIndex};
+    void *p = TRuntimeHeap::allocate (count, size, anyManagerIndex);
+    if (THeapProfile::isEnabled () && p)
+        THeapProfile::allocate (p, count * size, THeapProfile::TKind::Memory);
     return p;
 }
 
 void TRuntimeData::releaseMemory (void *p) {
-    // TODO: Lock
-    TDynamicArrayMap::iterator it = dynamicArrayMap.find (p);
-    if (it != dynamicArrayMap.end ()) {
-        TArrayData arrayData = it->second;
+    if (p) {
+        if (THeapProfile::isEnabled ())
+            THeapProfile::release (p);
+        destroyElements (p);
+        // arena blocks are freed when the arena is released
+        if (!TRuntimeHeap::isArenaBlock (p))
+            TRuntimeHeap::release (p);
+    }
+}
+
+void TRuntimeData::destroyElements (void *p) {
+    TRuntimeHeap::THeader &header = TRuntimeHeap::getHeader (p);
+    if (header.anyManagerIndex) {
         unsigned char *q = static_cast<unsigned char *> (p);
-        for (std::size_t i = 0; i < arrayData.count; ++i)
-            anyManagers [arrayData.anyManagerIndex]->destroy (q + i * arrayData.size);
-        dynamicArrayMap.erase (it);
+        TAnyManager *anyManager = anyManagers [header.anyManagerIndex];
+        for (std::size_t i = 0; i < header.count; ++i)
+            anyManager->destroy (q + i * header.size);
+        header.anyManagerIndex = 0;
     }
-    std::free (p);
 }
 
 TFileHandler &TRuntimeData::getFileHandler (std::size_t index) {
@@ -139,6 +150,18 @@ extern "C" void rt_copy_mem (void *dst, const void *src, std::size_t size, std::
     anyManager->copy (src, dst);
 }
 
+extern "C" void rt_any_retain (void *p) {
+    TAnyValue::retainValue (p);
+}
+
+extern "C" void rt_any_release (void *p) {
+    TAnyValue::releaseValue (p);
+}
+
+extern "C" void rt_any_delete (void *p) {
+    TAnyValue::deleteValue (p);
+}
+
 extern "C" void rt_alloc_mem (void **p, std::size_t count, std::size_t size, std::size_t anyManagerIndex, TRuntimeData *runtimeData) {
 //    printf ("%p %ld %ld %ld %p\n", p,count, size, anyManagerIndex, runtimeData);
     *p = runtimeData->allocateMemory (count, size, anyManagerIndex);
@@ -148,6 +171,29 @@ extern "C" void rt_free_mem (void *p, TRuntimeData *runtimeData) {
     runtimeData->releaseMemory (p);
 }
 
+extern "C" void rt_alloc_arena (void **p, std::size_t count, std::size_t size, std::size_t anyManagerIndex, TRuntimeData *, TRuntimeArena *arena) {
+    *p = arena->allocate (count, size, anyManagerIndex);
+}
+
+extern "C" TRuntimeArena *rt_arena_create () {
+    return new TRuntimeArena;
+}
+
+extern "C" void rt_arena_free (TRuntimeArena *arena, TRuntimeData *runtimeData) {
+    if (arena) {
+        arena->release (nullptr, *runtimeData);
+        delete arena;
+    }
+}
+
+extern "C" void rt_arena_mark (TRuntimeArena *arena, void **p) {
+    *p = arena->mark ();
+}
+
+extern "C" void rt_arena_release (TRuntimeArena *arena, void *p, TRuntimeData *runtimeData) {
+    arena->release (p, *runtimeData);
+}
+
 extern "C" void rt_init_mem (void *p, std::size_t anyManagerIndex, TRuntimeData *runtimeData) {
     runtimeData->getAnyManager (anyManagerIndex)->init (p);
 }
@@ -160,7 +206,7 @@ extern "C" char *rt_str_index (statpascal::TAnyValue s, std::size_t index) {
     static char n = 0;
     if (s.hasValue ()) 
         // TODO: index check
-        return &(s.get<std::string> () [index - 1]);
+        return s.getStringBuffer () + index - 1;
     else
         return &n;        
 }
@@ -30,6 +30,8 @@ public:
     
     void *allocateMemory (std::size_t count, std::size_t size, std::size_t anyManagerIndex);
     void releaseMemory (void *p);
+    // runs the destructors of a managed block from TRuntimeHeap or TRuntimeArena
+    void destroyElements (void *p);
     
     TTextFileBaseHandler &getTextFileBaseHandler (std::size_t index);
     TBinaryFileHandler &getBinaryFileHandler (std::size_t index);
@@ -47,15 +49,11 @@ public:
     TPCodeMemory *getPCodeMemory ();
     
 private:
-    struct TArrayData {
-        std::size_t size, count;
-        std::size_t anyManagerIndex;
-    };
-    typedef std::unordered_map<void *, TArrayData> TDynamicArrayMap;
-    
-    TDynamicArrayMap dynamicArrayMap;
     std::vector<TAnyManager *> anyManagers;
+    // constants are immortal and never freed as copies are not counted; stringIndex maps
+    // their contents to the index in stringPool
     std::deque<TAnyValue> stringPool;
+    std::unordered_map<std::string, std::size_t> stringIndex;
     std::vector<std::vector<unsigned char>> dataPool;
     std::vector<TFileHandler *> fileHandler;
     std::vector<std::string> argvector;
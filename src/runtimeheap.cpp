@@ -0,0 +1,234 @@
+#include "runtimeheap.hpp"
+#include "runtime.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+namespace statpascal {
+
+namespace {
+
+// block sizes including the header: steps of 16 bytes up to 128, then four classes per power of two
+
+constexpr std::size_t classCount = 31, maxClassSize = 8192, minChunkSize = 65536;
+
+constexpr std::array<std::size_t, classCount> classSize = {
+    32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+    1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192
+};
+
+constexpr std::array<std::uint8_t, maxClassSize / 16 + 1> createClassIndex () {
+    std::array<std::uint8_t, maxClassSize / 16 + 1> result {};
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < result.size (); ++i) {
+        while (classSize [c] < 16 * i)
+            ++c;
+        result [i] = c;
+    }
+    return result;
+}
+
+constexpr std::array<std::uint8_t, maxClassSize / 16 + 1> classIndex = createClassIndex ();
+
+// number of blocks moved between a thread cache and the central list at once
+
+constexpr std::size_t getBatchSize (std::size_t sizeClass) {
+    return std::clamp<std::size_t> (16384 / classSize [sizeClass], 4, 64);
+}
+
+struct TFreeBlock {
+    TFreeBlock *next;
+};
+
+struct TCentralList {
+    std::mutex mutex;
+    TFreeBlock *head = nullptr;
+};
+
+TCentralList centralList [classCount];
+
+void returnToCentral (std::size_t sizeClass, TFreeBlock *first, TFreeBlock *last) {
+    TCentralList &central = centralList [sizeClass];
+    std::lock_guard<std::mutex> lock (central.mutex);
+    last->next = central.head;
+    central.head = first;
+}
+
+class TThreadCache {
+public:
+    ~TThreadCache ();
+
+    void *allocate (std::size_t sizeClass);
+    void release (void *p, std::size_t sizeClass);
+
+private:
+    void refill (std::size_t sizeClass);
+
+    TFreeBlock *head [classCount] = {};
+    std::size_t length [classCount] = {};
+};
+
+TThreadCache::~TThreadCache () {
+    for (std::size_t c = 0; c < classCount; ++c)
+        if (head [c]) {
+            TFreeBlock *last = head [c];
+            while (last->next)
+                last = last->next;
+            returnToCentral (c, head [c], last);
+        }
+}
+
+inline void *TThreadCache::allocate (std::size_t sizeClass) {
+    if (!head [sizeClass]) {
+        refill (sizeClass);
+        if (!head [sizeClass])
+            return nullptr;
+    }
+    TFreeBlock *p = head [sizeClass];
+    head [sizeClass] = p->next;
+    --length [sizeClass];
+    return p;
+}
+
+inline void TThreadCache::release (void *p, std::size_t sizeClass) {
+    TFreeBlock *block = static_cast<TFreeBlock *> (p);
+    block->next = head [sizeClass];
+    head [sizeClass] = block;
+    const std::size_t batch = getBatchSize (sizeClass);
+    if (++length [sizeClass] > 2 * batch) {
+        TFreeBlock *first = head [sizeClass], *last = first;
+        for (std::size_t i = 1; i < batch; ++i)
+            last = last->next;
+        head [sizeClass] = last->next;
+        length [sizeClass] -= batch;
+        returnToCentral (sizeClass, first, last);
+    }
+}
+
+void TThreadCache::refill (std::size_t sizeClass) {
+    const std::size_t batch = getBatchSize (sizeClass);
+    {
+        TCentralList &central = centralList [sizeClass];
+        std::lock_guard<std::mutex> lock (central.mutex);
+        if (central.head) {
+            TFreeBlock *last = central.head;
+            std::size_t n = 1;
+            for (; n < batch && last->next; ++n)
+                last = last->next;
+            head [sizeClass] = central.head;
+            central.head = last->next;
+            last->next = nullptr;
+            length [sizeClass] = n;
+            return;
+        }
+    }
+    // chunks are carved into blocks of one size class and never returned to the system
+    const std::size_t size = classSize [sizeClass], n = std::max (minChunkSize / size, batch);
+    unsigned char *chunk = static_cast<unsigned char *> (std::malloc (n * size));
+    if (!chunk)
+        return;
+    for (std::size_t i = 0; i < n; ++i)
+        reinterpret_cast<TFreeBlock *> (chunk + i * size)->next = i + 1 < n ? reinterpret_cast<TFreeBlock *> (chunk + (i + 1) * size) : nullptr;
+    head [sizeClass] = reinterpret_cast<TFreeBlock *> (chunk);
+    length [sizeClass] = n;
+}
+
+thread_local TThreadCache threadCache;
+
+}
+
+void *TRuntimeHeap::allocate (std::size_t count, std::size_t size, std::size_t anyManagerIndex) {
+    if (size && count > (std::numeric_limits<std::size_t>::max () - sizeof (THeader)) / size)
+        return nullptr;
+    const std::size_t total = count * size + sizeof (THeader);
+    THeader *header;
+    std::uint8_t sizeClass;
+    if (total <= maxClassSize) {
+        sizeClass = classIndex [(total + 15) / 16];
+        header = static_cast<THeader *> (threadCache.allocate (sizeClass));
+        if (!header)
+            return nullptr;
+        std::memset (header + 1, 0, count * size);
+    } else {
+        sizeClass = TRuntimeHeap::largeClass;
+        header = static_cast<THeader *> (std::calloc (1, total));
+        if (!header)
+            return nullptr;
+    }
+    *header = {count, static_cast<std::uint32_t> (size), static_cast<std::uint32_t> (anyManagerIndex), sizeClass};
+    return header + 1;
+}
+
+void TRuntimeHeap::release (void *p) {
+    THeader *header = static_cast<THeader *> (p) - 1;
+    if (header->sizeClass == TRuntimeHeap::largeClass)
+        std::free (header);
+    else
+        threadCache.release (header, header->sizeClass);
+}
+
+TRuntimeArena::~TRuntimeArena () {
+    for (TChunk &chunk: chunks)
+        std::free (chunk.begin);
+    for (TChunk &chunk: spare)
+        std::free (chunk.begin);
+}
+
+void *TRuntimeArena::allocate (std::size_t count, std::size_t size, std::size_t anyManagerIndex) {
+    if (size && count > (std::numeric_limits<std::size_t>::max () - 2 * sizeof (THeader)) / size)
+        return nullptr;
+    const std::size_t total = (count * size + 15) / 16 * 16 + sizeof (THeader);
+    if (static_cast<std::size_t> (end - pos) < total) {
+        if (!spare.empty () && static_cast<std::size_t> (spare.back ().end - spare.back ().begin) >= total) {
+            chunks.push_back (spare.back ());
+            spare.pop_back ();
+        } else {
+            const std::size_t n = std::max (total, chunkSize);
+            unsigned char *chunk = static_cast<unsigned char *> (std::malloc (n));
+            if (!chunk)
+                return nullptr;
+            chunks.push_back ({chunk, chunk + n});
+        }
+        pos = chunks.back ().begin;
+        end = chunks.back ().end;
+    }
+    THeader *header = reinterpret_cast<THeader *> (pos);
+    pos += total;
+    *header = {count, static_cast<std::uint32_t> (size), static_cast<std::uint32_t> (anyManagerIndex), TRuntimeHeap::arenaClass};
+    std::memset (header + 1, 0, count * size);
+    if (anyManagerIndex)
+        managed.push_back (header);
+    return header + 1;
+}
+
+// the mark record is allocated in the arena itself so that releasing to it also drops the record
+
+void *TRuntimeArena::mark () {
+    void *p = allocate (1, sizeof (TMark), 0);
+    if (p)
+        *static_cast<TMark *> (p) = {chunks.size (), managed.size ()};
+    return p;
+}
+
+void TRuntimeArena::release (void *mark, TRuntimeData &runtimeData) {
+    const TMark m = mark ? *static_cast<TMark *> (mark) : TMark {0, 0};
+    while (managed.size () > m.managedCount) {
+        runtimeData.destroyElements (managed.back () + 1);
+        managed.pop_back ();
+    }
+    while (chunks.size () > m.chunkCount) {
+        spare.push_back (chunks.back ());
+        chunks.pop_back ();
+    }
+    if (mark) {
+        pos = reinterpret_cast<unsigned char *> (&TRuntimeHeap::getHeader (mark));
+        end = chunks.back ().end;
+    } else
+        pos = end = nullptr;
+}
+
+}
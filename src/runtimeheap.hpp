@@ -0,0 +1,79 @@
+/** \file runtimeheap.hpp
+
+    Size class allocator used for new/dispose. Every block starts with a header
+    recording the element count, element size and any-manager index of the
+    allocation so that dispose needs no global lookup. Small blocks are served
+    from per-thread free lists which are refilled from and returned to central
+    lists in batches; blocks larger than the biggest size class are taken from
+    malloc.
+
+    TRuntimeArena hands out blocks with the same header by bumping a pointer
+    through large chunks. Releasing an arena back to a mark runs the
+    destructors of the managed allocations made since and drops everything
+    else at once. Arenas are not thread safe.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace statpascal {
+
+class TRuntimeData;
+
+class TRuntimeHeap final {
+public:
+    struct THeader {
+        std::uint64_t count;
+        std::uint32_t size;
+        std::uint32_t anyManagerIndex: 24, sizeClass: 8;
+    };
+    static_assert (sizeof (THeader) == 16);
+
+    // returns zero initialized memory for count elements of the given size
+    static void *allocate (std::size_t count, std::size_t size, std::size_t anyManagerIndex);
+    static void release (void *p);
+
+    static THeader &getHeader (void *p) {
+        return static_cast<THeader *> (p) [-1];
+    }
+    static bool isArenaBlock (void *p) {
+        return getHeader (p).sizeClass == arenaClass;
+    }
+
+    static constexpr std::uint8_t arenaClass = 254, largeClass = 255;
+};
+
+class TRuntimeArena final {
+public:
+    TRuntimeArena () = default;
+    ~TRuntimeArena ();
+
+    TRuntimeArena (const TRuntimeArena &) = delete;
+    TRuntimeArena &operator = (const TRuntimeArena &) = delete;
+
+    void *allocate (std::size_t count, std::size_t size, std::size_t anyManagerIndex);
+
+    // mark returns a position to release to; release (nullptr) empties the arena
+    void *mark ();
+    void release (void *mark, TRuntimeData &);
+
+private:
+    using THeader = TRuntimeHeap::THeader;
+    struct TChunk {
+        unsigned char *begin, *end;
+    };
+    struct TMark {
+        std::size_t chunkCount, managedCount;
+    };
+    static constexpr std::size_t chunkSize = 262144;
+
+    // chunks dropped by release are kept for reuse until the arena is freed
+    std::vector<TChunk> chunks, spare;
+    std::vector<THeader *> managed;
+    unsigned char *pos = nullptr, *end = nullptr;
+};
+
+}
@@ -6,10 +6,14 @@
 #include <iomanip>
 #include <filesystem>
 #include <mutex>
+#include <condition_variable>
 #include <semaphore>
 #include <functional>
+#include <thread>
+#include <unistd.h>
 
 #include "anyvalue.hpp"
+#include "anymanager.hpp"
 #include "vectordata.hpp"
 #include "rng.hpp"
 #include "runtime.hpp"
@@ -39,12 +43,10 @@ using sp_bool = bool;
 
 namespace {
 
-const std::string &getString (statpascal::TAnyValue &p) {
-    const static std::string empty;
-    if (p.hasValue ())
-        return p.get<std::string> ();
-    else
-        return empty;
+// the view refers to p which must not be changed while it is used
+
+std::string_view getString (const statpascal::TAnyValue &p) {
+    return p.getString ();
 }
     
 template<typename T> class bit_shl {
@@ -71,74 +73,94 @@ extern "C" statpascal::TAnyValue rt_str_make (std::size_t index, statpascal::TRu
     return runtimeData->getStringConstant (index);
 }
 
-extern "C" statpascal::TAnyValue rt_str_concat (statpascal::TAnyValue a, statpascal::TAnyValue b) {
-    return getString (a) + getString (b);
+extern "C" statpascal::TAnyValue rt_str_concat (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
+    const std::string_view s = getString (a), t = getString (b);
+    std::string result;
+    result.reserve (s.length () + t.length ());
+    return std::move (result.append (s).append (t));
+}
+
+extern "C" void rt_str_append (statpascal::TAnyValue *dest, statpascal::TBorrowedValue src) {
+    const std::string_view t = getString (src);
+    if (t.empty ())
+        return;
+    // nil and inline strings have no buffer to append to
+    if (dest == &src || getString (*dest).length () <= statpascal::TAnyValue::inlineStringLength) {
+        *dest = rt_str_concat (*dest, src);
+        return;
+    }
+    dest->copyOnWrite ();
+    std::string &s = dest->get<std::string> ();
+    if (s.capacity () < s.length () + t.length ())
+        s.reserve (std::max (2 * s.capacity (), s.length () + t.length ()));
+    s.append (t);
 }
 
 extern "C" statpascal::TAnyValue rt_str_char (std::uint8_t a) {
     return std::string (1, static_cast<std::string::value_type> (a));
 }
 
-extern "C" statpascal::TAnyValue rt_str_copy (statpascal::TAnyValue a, std::int64_t pos, std::int64_t length) {
-    const std::string &t = getString (a);
+extern "C" statpascal::TAnyValue rt_str_copy (statpascal::TBorrowedValue a, std::int64_t pos, std::int64_t length) {
+    const std::string_view t = getString (a);
     if (pos <= 0)
         pos = 1;
     if (static_cast<std::size_t> (pos) <= t.length () && length > 0) 
-        return t.substr (pos - 1, length);
+        return std::string (t.substr (pos - 1, length));
     else
         return std::string ();
 }
 
-extern "C" statpascal::TAnyValue rt_file_path (statpascal::TAnyValue t) {
-    const std::string &s = getString (t);
+extern "C" statpascal::TAnyValue rt_file_path (statpascal::TBorrowedValue t) {
+    const std::string_view s = getString (t);
     std::string::size_type sep = s.rfind ('/');
-    return sep == std::string::npos ? std::string () : s.substr (0, sep + 1);
+    return std::string (sep == std::string::npos ? std::string_view () : s.substr (0, sep + 1));
 }
 
-extern "C" statpascal::TAnyValue rt_file_name (statpascal::TAnyValue t) {
-    const std::string &s = getString (t);
+extern "C" statpascal::TAnyValue rt_file_name (statpascal::TBorrowedValue t) {
+    const std::string_view s = getString (t);
     std::string::size_type sep = s.rfind ('/');
-    return sep == std::string::npos ? s : s.substr (sep + 1);
+    return std::string (sep == std::string::npos ? s : s.substr (sep + 1));
 }
 
 extern "C" statpascal::TAnyValue rt_str_of_char (std::uint8_t a, std::int64_t length) {
     return std::string (std::max<std::int64_t> (0, length), a);
 }
 
-extern "C" statpascal::TAnyValue rt_str_upcase (statpascal::TAnyValue a) {
-    const std::string &t = getString (a);
+extern "C" statpascal::TAnyValue rt_str_upcase (statpascal::TBorrowedValue a) {
+    const std::string_view t = getString (a);
     std::string s (t.length (), 0);
     std::transform (t.begin (), t.end (), s.begin (), ::toupper);
     return std::move (s);
 }
 
-extern "C" sp_bool rt_str_equal (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_equal (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) == getString (b);
 }
 
-extern "C" sp_bool rt_str_not_equal (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_not_equal (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) != getString (b);
 }
 
-extern "C" sp_bool rt_str_less (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_less (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) < getString (b);
 }
 
-extern "C" sp_bool rt_str_greater (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_greater (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) > getString (b);
 }
 
-extern "C" sp_bool rt_str_less_equal (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_less_equal (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) <= getString (b);
 }
 
-extern "C" sp_bool rt_str_greater_equal (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+extern "C" sp_bool rt_str_greater_equal (statpascal::TBorrowedValue a, statpascal::TBorrowedValue b) {
     return getString (a) >= getString (b);
 }
 
 
-extern "C" void rt_str_insert (statpascal::TAnyValue src, statpascal::TAnyValue *dest, std::int64_t pos) {
-    const std::string &srcstr = getString (src);
+extern "C" void rt_str_insert (statpascal::TBorrowedValue src, statpascal::TAnyValue *dest, std::int64_t pos) {
+    // src may be the same variable as dest
+    const std::string srcstr (getString (src));
     if (pos <= 0)
         pos = 1;
     if (!dest->hasValue ()) {
@@ -154,11 +176,11 @@ extern "C" void rt_str_insert (statpascal::TAnyValue src, statpascal::TAnyValue
     }
 }
 
-extern "C" std::int64_t rt_str_length (statpascal::TAnyValue a) {
+extern "C" std::int64_t rt_str_length (statpascal::TBorrowedValue a) {
     return getString (a).size ();
 }
 
-extern "C" std::int64_t rt_str_pos (statpascal::TAnyValue needle, statpascal::TAnyValue haystack) {
+extern "C" std::int64_t rt_str_pos (statpascal::TBorrowedValue needle, statpascal::TBorrowedValue haystack) {
     std::string::size_type pos = getString (haystack).find (getString (needle));
     return pos != std::string::npos ? pos + 1 : 0;
 }
@@ -268,9 +290,10 @@ extern "C" std::int64_t rt_compare_byte (void *src, void *dst, std::int64_t size
     return std::memcmp (dst, src, size);
 }
 
-extern "C" std::int64_t rt_val_int (statpascal::TAnyValue a, std::uint16_t *code) {
+extern "C" std::int64_t rt_val_int (statpascal::TBorrowedValue a, std::uint16_t *code) {
     char *endptr;
-    const char *s = getString (a).c_str ();
+    const std::string t (getString (a));
+    const char *s = t.c_str ();
     std::int64_t result = std::strtoll (s, &endptr, 10);
     if (*endptr) {
         result = 0;
@@ -280,9 +303,10 @@ extern "C" std::int64_t rt_val_int (statpascal::TAnyValue a, std::uint16_t *code
     return result;
 }
 
-extern "C" double rt_val_dbl (statpascal::TAnyValue a, std::uint16_t *code) {
+extern "C" double rt_val_dbl (statpascal::TBorrowedValue a, std::uint16_t *code) {
     char *endptr;
-    const char *s = getString (a).c_str ();
+    const std::string t (getString (a));
+    const char *s = t.c_str ();
     double result = std::strtod (s, &endptr);
     if (*endptr) {
         result = 0.0;
@@ -337,36 +361,39 @@ template<typename TEl, typename TRes> TRes vecsum (statpascal::TAnyValue &in) {
 
 template<typename T> statpascal::TAnyValue veccumsum (const statpascal::TAnyValue &a) {
     const statpascal::TVectorData &in = a.get<statpascal::TVectorData> ();
-    statpascal::TVectorData out (in.getElementSize (), in.getElementCount ());
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (in.getElementSize (), in.getElementCount ());
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     
     const T *x = &(in.template get<T> (0));
     T *y = &(out.template get<T> (0));
     std::partial_sum (x, x + in.getElementCount (), y);
     
-    return std::move (out);
+    return outValue;
 }
 
 template<typename T> statpascal::TAnyValue vecsort (statpascal::TAnyValue &a) {
     const statpascal::TVectorData &in = a.get<statpascal::TVectorData> ();
     const std::size_t size = in.getElementSize (), count = in.getElementCount ();
-    statpascal::TVectorData out (size, count);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (size, count);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     
     const T *x = &(in.template get<T> (0));
     T *y = &(out.template get<T> (0));
     std::memcpy (y, x, size * count);
     std::sort (y, y + count);
     
-    return std::move (out);
+    return outValue;
 }
 
 statpascal::TAnyValue vecfunc (std::function<double (double)> fn, const statpascal::TAnyValue &a) {
     const statpascal::TVectorData &in = a.get<statpascal::TVectorData> ();
-    statpascal::TVectorData out (in.getElementSize (), in.getElementCount ());
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (in.getElementSize (), in.getElementCount ());
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     const double *x = &(in.get<double> (0));
     double *y = &(out.get<double> (0));
     for (std::size_t i = 0, ei = in.getElementCount (); i < ei; ++i)
         y [i] = fn (x [i]);
-    return std::move (out);
+    return outValue;
 }
 
 } // namespace
@@ -397,22 +424,42 @@ extern "C" statpascal::TAnyValue rt_vdbl_pow (statpascal::TAnyValue in, double e
 
 extern "C" void *rt_vec_index_int (statpascal::TAnyValue in, std::int64_t index) {
     // TODO: range check, COW?
+    // the element may be modified through the pointer: string arenas are materialized
     return &in.get<statpascal::TVectorData> ().get<char> (index - 1);
 }
 
+extern "C" statpascal::TAnyValue rt_vec_element_str (statpascal::TBorrowedValue in, std::int64_t index) {
+    // TODO: range check
+    const statpascal::TVectorData &vectorData = in.get<statpascal::TVectorData> ();
+    if (vectorData.isStringArena ())
+        return std::string (vectorData.getString (index - 1));
+    return vectorData.get<statpascal::TAnyValue> (index - 1);
+}
+
 extern "C" statpascal::TAnyValue rt_vec_index_vint (statpascal::TAnyValue a, statpascal::TAnyValue index) {
     // TODO: range check
     std::int64_t ival = 0;
     const statpascal::TVectorData 
         &src = a.get<statpascal::TVectorData> (),
         &ind = index.get<statpascal::TVectorData> ();
+        
+    if (src.isStringArena ()) {
+        statpascal::TStringArena out;
+        out.reserve (ind.getElementCount (), 0);
+        for (std::size_t i = 0; i < ind.getElementCount (); ++i) {
+            memcpy (&ival, &ind.get<char> (i), ind.getElementSize ());
+            out.append (src.getString (ival - 1));
+        }
+        return statpascal::TVectorData (std::move (out), src.getElementAnyManager ());
+    }
     
-    statpascal::TVectorData out (src.getElementSize (), ind.getElementCount (), src.getElementAnyManager (), false);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (src.getElementSize (), ind.getElementCount (), src.getElementAnyManager (), false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     for (std::size_t i = 0; i < ind.getElementCount (); ++i) {
         memcpy (&ival, &ind.get<char> (i), ind.getElementSize ());
         out.setElement (i, &src.get<unsigned char> (ival - 1));
     }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_vec_index_vbool (statpascal::TAnyValue a, statpascal::TAnyValue index) {
@@ -443,87 +490,120 @@ extern "C" statpascal::TAnyValue rt_vec_index_vbool (statpascal::TAnyValue a, st
     for (i = j * 8; i < indexCount; ++i)
         count += indexData [i];
         
-    statpascal::TVectorData out (src.getElementSize (), count, src.getElementAnyManager (), false);
+    if (src.isStringArena ()) {
+        statpascal::TStringArena out;
+        out.reserve (count, 0);
+        for (std::size_t i = 0; i < indexCount; ++i)
+            if (indexData [i])
+                out.append (src.getString (i));
+        return statpascal::TVectorData (std::move (out), src.getElementAnyManager ());
+    }
+        
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (src.getElementSize (), count, src.getElementAnyManager (), false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (count)
         for (std::size_t i = 0, dst = 0; dst < count; ++i) 
             if (indexData [i])
                 out.setElement (dst++, &src.get<unsigned char> (i));
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_intvec (std::int64_t a, std::int64_t b) {
-    statpascal::TVectorData out (sizeof (std::int64_t), std::max<std::int64_t> (0, b - a + 1));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), std::max<std::int64_t> (0, b - a + 1));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (b >= a) {
         std::int64_t *p = &out.get<std::int64_t> (0);
         std::iota (p, p + (b - a + 1), a);
     }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_realvec (double a, double b, double step) {
     if ((step > 0.0 && b >= a) || (step < 0.0 && b <= a)) {
         const std::size_t count = std::floor (1 + (b - a) / step + 0.5);
-        statpascal::TVectorData out (sizeof (double), count);
+        statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (double), count);
+        statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
         double *p = &out.get<double> (0);
         for (std::size_t i = 0; i < count; ++i)
             *p++ = static_cast<double> (count - 1 - i) / (count - 1) * a + static_cast<double> (i) / (count - 1) * b;
-        return std::move (out);
+        return outValue;
     } else
-        return statpascal::TVectorData (sizeof (double), 0);
+        return statpascal::TVectorData::create (sizeof (double), 0);
 }
 
 extern "C" statpascal::TAnyValue rt_makevec_int (std::int64_t size, std::int64_t val) {
-    statpascal::TVectorData out (size, 1);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (size, 1);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     out.setElement (0, &val);
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_makevec_dbl (std::int64_t size, double val) {
-    statpascal::TVectorData out (size, 1);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (size, 1);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (size == sizeof (double))
         out.setElement (0, &val);
     else {
         float val1 = val;
         out.setElement (0, &val1);
     }
-    return std::move (out);
+    return outValue;
 }
 
 // TODO: unify!
 
 extern "C" statpascal::TAnyValue rt_makevec_str (std::int64_t anyManagerIndex, statpascal::TRuntimeData *runtimeData, statpascal::TAnyValue a) {
-    statpascal::TVectorData out (sizeof (void *), 1, runtimeData->getAnyManager (anyManagerIndex));
-    out.setElement (0, &a);
-    return std::move (out);
+    statpascal::TStringArena out;
+    out.append (getString (a));
+    return statpascal::TVectorData (std::move (out), runtimeData->getAnyManager (anyManagerIndex));
 }
 
 extern "C" statpascal::TAnyValue rt_makevec_vec (std::int64_t anyManagerIndex, statpascal::TRuntimeData *runtimeData, statpascal::TAnyValue a) {
-    statpascal::TVectorData out (sizeof (void *), 1, runtimeData->getAnyManager (anyManagerIndex));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (void *), 1, runtimeData->getAnyManager (anyManagerIndex));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     out.setElement (0, &a);
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_combinevec_4 (statpascal::TAnyValue a, statpascal::TAnyValue b, statpascal::TAnyValue c, statpascal::TAnyValue d) {
     const std::size_t n = 4;
     std::array<statpascal::TAnyValue, n> in {a, b, c, d};
-    std::int64_t count = 0, elsize = 0;
+    std::int64_t count = 0, elsize = 0, length = 0;
     statpascal::TAnyManager *anyManager = nullptr;
+    bool arena = true;
     for (std::size_t i = 0; i < n; ++i)
         if (in [i].hasValue ()) {
             const statpascal::TVectorData &vectorData = in [i].get<statpascal::TVectorData> ();
             count += vectorData.getElementCount ();
             elsize = vectorData.getElementSize ();
             anyManager = vectorData.getElementAnyManager ();
+            if (vectorData.isStringArena ())
+                length += vectorData.getStringArena ().length ();
+            else
+                arena = false;
         }
-    statpascal::TVectorData out (elsize, count, anyManager, false);
+    // string arenas are only combined into an arena if no input has been materialized
+    if (arena && anyManager) {
+        statpascal::TStringArena out;
+        out.reserve (count, length);
+        for (std::size_t i = 0; i < n; ++i)
+            if (in [i].hasValue ()) {
+                const statpascal::TStringArena &src = in [i].get<statpascal::TVectorData> ().getStringArena ();
+                for (std::size_t j = 0; j < src.size (); ++j)
+                    out.append (src [j]);
+            }
+        return statpascal::TVectorData (std::move (out), anyManager);
+    }
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (elsize, count, anyManager, false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     std::int64_t index = 0;
     for (std::size_t i = 0; i < n; ++i)
         if (in [i].hasValue ()) {
             const statpascal::TVectorData &vectorData = in [i].get<statpascal::TVectorData> ();
             for (std::size_t j = 0; j < vectorData.getElementCount (); ++j)
-                out.setElement (index++, vectorData.getElement (j));
+                out.copyElement (index++, vectorData, j);
         }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_combinevec_3 (statpascal::TAnyValue a, statpascal::TAnyValue b, statpascal::TAnyValue c) {
@@ -539,7 +619,17 @@ extern "C" std::int64_t rt_sizevec (statpascal::TAnyValue a) {
 }
 
 extern "C" void rt_resizevec (std::int64_t anyManagerIndex, statpascal::TRuntimeData *runtimeData, std::int64_t elsize, statpascal::TAnyValue &a, std::int64_t n) {
-    statpascal::TVectorData out (elsize, n, runtimeData->getAnyManager (anyManagerIndex));
+    if (a.hasValue () && a.get<statpascal::TVectorData> ().isStringArena ()) {
+        const statpascal::TStringArena &src = a.get<statpascal::TVectorData> ().getStringArena ();
+        statpascal::TStringArena out;
+        out.reserve (n, src.length ());
+        for (std::int64_t j = 0; j < n; ++j)
+            out.append (static_cast<std::size_t> (j) < src.size () ? src [j] : std::string_view ());
+        a = statpascal::TVectorData (std::move (out), runtimeData->getAnyManager (anyManagerIndex));
+        return;
+    }
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (elsize, n, runtimeData->getAnyManager (anyManagerIndex));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (a.hasValue ()) {
         const std::size_t copyCount = std::min<std::size_t> (a.get<statpascal::TVectorData> ().getElementCount (), n);
         if (out.getElementAnyManager ())
@@ -548,47 +638,59 @@ extern "C" void rt_resizevec (std::int64_t anyManagerIndex, statpascal::TRuntime
         else
             std::memcpy (out.getElement (0), a.get<statpascal::TVectorData> ().getElement (0), copyCount * elsize);
     }
-    a = out;
+    a = outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_revvec (statpascal::TAnyValue a) {
     statpascal::TVectorData &vectorData = a.get<statpascal::TVectorData> ();
     const std::size_t n = vectorData.getElementCount ();
-    statpascal::TVectorData out (vectorData.getElementSize (), n, vectorData.getElementAnyManager ());
+    if (vectorData.isStringArena ()) {
+        const statpascal::TStringArena &src = vectorData.getStringArena ();
+        statpascal::TStringArena out;
+        out.reserve (n, src.length ());
+        for (std::size_t i = 0; i < n; ++i)
+            out.append (src [n - 1 - i]);
+        return statpascal::TVectorData (std::move (out), vectorData.getElementAnyManager ());
+    }
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (vectorData.getElementSize (), n, vectorData.getElementAnyManager ());
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     for (std::size_t i = 0; i < n; ++i)
-        out.setElement (i, vectorData.getElement (n - 1 - i));
-    return std::move (out);
+        out.copyElement (i, vectorData, n - 1 - i);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_vint_randomperm (std::int64_t n) {
-    statpascal::TVectorData out (sizeof (std::int64_t), std::max<std::int64_t> (n, 0));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), std::max<std::int64_t> (n, 0));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (n >= 1) {
         std::int64_t *p = &out.get<std::int64_t> (0);
         std::iota (p, p + n, 1);
         for (std::int64_t i = n - 1; i > 0; --i)
             std::swap (p [i], p [statpascal::TRNG::val (0, i)]);
     }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_vdbl_random (std::int64_t n) {
-    statpascal::TVectorData out (sizeof (double), std::max<std::int64_t> (n, 0));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (double), std::max<std::int64_t> (n, 0));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (n >= 1) {
         double *p = &out.get<double> (0);
         for (std::int64_t i = 0; i <n; ++i)
             p [i] = statpascal::TRNG::val ();
     }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_vint_random (std::int64_t m, std::int64_t n) {
-    statpascal::TVectorData out (sizeof (std::int64_t), std::max<std::int64_t> (n, 0));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), std::max<std::int64_t> (n, 0));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     if (n >= 1) {
         std::int64_t *p = &out.get<std::int64_t> (0);
         for (std::int64_t i = 0; i <n; ++i)
             p [i] = statpascal::TRNG::val (0, m);
     }
-    return std::move (out);
+    return outValue;
 }
 
 extern "C" statpascal::TAnyValue rt_vint_sort (statpascal::TAnyValue a) {
@@ -611,6 +713,29 @@ extern "C" std::int64_t rt_vbool_count (statpascal::TAnyValue in) {
     return vecsum<bool, std::int64_t> (in);
 }
 
+extern "C" std::int64_t rt_vbool_first (statpascal::TAnyValue in, sp_bool value) {
+    if (!in.hasValue ())
+        return 0;
+    const statpascal::TVectorData &v = in.get<statpascal::TVectorData> ();
+    const char *p = &v.get<char> (0);
+    const void *found = std::memchr (p, value ? 1 : 0, v.getElementCount ());
+    return found ? static_cast<const char *> (found) - p + 1 : 0;
+}
+
+extern "C" statpascal::TAnyValue rt_vbool_which (statpascal::TAnyValue in) {
+    const std::size_t count = in.hasValue () ? rt_vbool_count (in) : 0;
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), count, nullptr, false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
+    if (count) {
+        const statpascal::TVectorData &v = in.get<statpascal::TVectorData> ();
+        std::int64_t *result = &out.get<std::int64_t> (0);
+        for (std::size_t i = 0, ei = v.getElementCount (); i < ei; ++i)
+            if (v.get<bool> (i))
+                *result++ = i + 1;
+    }
+    return outValue;
+}
+
 extern "C" statpascal::TAnyValue rt_vint_cumsum (statpascal::TAnyValue a) {
     return veccumsum<std::int64_t> (a);
 }
@@ -619,6 +744,240 @@ extern "C" statpascal::TAnyValue rt_vdbl_cumsum (statpascal::TAnyValue a) {
     return veccumsum<double> (a);
 }
 
+// string vector routines
+
+namespace {
+
+// threads kept for parallelFor; a caller finding the pool busy runs its loop itself
+
+class TWorkerPool {
+public:
+    static TWorkerPool &getInstance ();
+    
+    std::size_t getWorkerCount () const;
+    
+    /** runs task (t) for t in [1, count) on the workers and task (0) on the calling thread;
+        returns false without running anything if the pool is in use */
+    bool run (std::size_t count, const std::function<void (std::size_t)> &task);
+    
+private:
+    TWorkerPool ();
+    ~TWorkerPool ();
+    
+    void work (std::size_t index);
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex, mutex;
+    std::condition_variable started, finished;
+    const std::function<void (std::size_t)> *task;
+    std::size_t taskCount, pending;
+    std::uint64_t generation;
+    bool stop;
+    pid_t pid;
+};
+
+TWorkerPool &TWorkerPool::getInstance () {
+    static TWorkerPool workerPool;
+    return workerPool;
+}
+
+TWorkerPool::TWorkerPool ():
+  task (nullptr), taskCount (0), pending (0), generation (0), stop (false), pid (getpid ()) {
+    for (std::size_t i = 1; i < std::thread::hardware_concurrency (); ++i)
+        workers.emplace_back (&TWorkerPool::work, this, i);
+}
+
+TWorkerPool::~TWorkerPool () {
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stop = true;
+    }
+    started.notify_all ();
+    for (std::thread &worker: workers)
+        if (worker.joinable ())
+            worker.join ();
+}
+
+std::size_t TWorkerPool::getWorkerCount () const {
+    return workers.size ();
+}
+
+bool TWorkerPool::run (std::size_t count, const std::function<void (std::size_t)> &f) {
+    // the workers do not exist in a forked child
+    if (getpid () != pid || !runMutex.try_lock ())
+        return false;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        task = &f;
+        taskCount = count;
+        pending = count - 1;
+        ++generation;
+    }
+    started.notify_all ();
+    f (0);
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        finished.wait (lock, [this] { return !pending; });
+        task = nullptr;
+    }
+    runMutex.unlock ();
+    return true;
+}
+
+void TWorkerPool::work (std::size_t index) {
+    std::uint64_t done = 0;
+    std::unique_lock<std::mutex> lock (mutex);
+    for (;;) {
+        started.wait (lock, [this, done] { return stop || generation != done; });
+        if (stop)
+            return;
+        done = generation;
+        if (index < taskCount) {
+            const std::function<void (std::size_t)> &f = *task;
+            lock.unlock ();
+            f (index);
+            lock.lock ();
+            if (!--pending)
+                finished.notify_one ();
+        }
+    }
+}
+
+// runs f (begin, end) over [0, n) - split between the pooled threads for large vectors
+
+template<typename F> void parallelFor (std::size_t n, F f) {
+    const std::size_t minChunk = 1 << 14;
+    const std::size_t threads = n < 2 * minChunk ? 1 : std::min (TWorkerPool::getInstance ().getWorkerCount () + 1, n / minChunk);
+    if (threads > 1) {
+        const std::size_t chunk = (n + threads - 1) / threads;
+        if (TWorkerPool::getInstance ().run (threads, [&] (std::size_t t) { f (t * chunk, std::min (n, (t + 1) * chunk)); }))
+            return;
+    }
+    f (0, n);
+}
+
+// element manager for string vectors created without type information from the compiler
+
+statpascal::TAnyManager *getStringElementManager () {
+    static statpascal::TAnySingleValueManager stringElementManager;
+    return &stringElementManager;
+}
+
+std::size_t getElementCount (const statpascal::TAnyValue &v) {
+    return v.hasValue () ? v.get<statpascal::TVectorData> ().getElementCount () : 0;
+}
+
+template<typename TLength, typename TFill> statpascal::TAnyValue makeStringVector (std::size_t n, TLength length, TFill fill) {
+    std::vector<std::size_t> lengths (n);
+    parallelFor (n, [&] (std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            lengths [i] = length (i);
+    });
+    statpascal::TStringArena out;
+    out.assignLengths (lengths);
+    parallelFor (n, [&] (std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            fill (i, out.getBuffer (i));
+    });
+    return statpascal::TVectorData (std::move (out), getStringElementManager ());
+}
+
+template<typename TResult> statpascal::TAnyValue makeIntVector (std::size_t n, TResult result) {
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), n, nullptr, false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
+    if (n) {
+        std::int64_t *p = &out.get<std::int64_t> (0);
+        parallelFor (n, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                p [i] = result (i);
+        });
+    }
+    return outValue;
+}
+
+}
+
+extern "C" statpascal::TAnyValue rt_vstr_length (statpascal::TAnyValue a) {
+    return makeIntVector (getElementCount (a), [&a] (std::size_t i) {
+        return a.get<statpascal::TVectorData> ().getString (i).length ();
+    });
+}
+
+extern "C" statpascal::TAnyValue rt_vstr_pos (statpascal::TAnyValue needle, statpascal::TAnyValue haystack) {
+    const std::string_view s = getString (needle);
+    return makeIntVector (getElementCount (haystack), [&s, &haystack] (std::size_t i) -> std::int64_t {
+        std::string_view::size_type pos = haystack.get<statpascal::TVectorData> ().getString (i).find (s);
+        return pos != std::string_view::npos ? pos + 1 : 0;
+    });
+}
+
+extern "C" statpascal::TAnyValue rt_vstr_upcase (statpascal::TAnyValue a) {
+    return makeStringVector (getElementCount (a), 
+        [&a] (std::size_t i) {
+            return a.get<statpascal::TVectorData> ().getString (i).length ();
+        },
+        [&a] (std::size_t i, char *dest) {
+            const std::string_view s = a.get<statpascal::TVectorData> ().getString (i);
+            std::transform (s.begin (), s.end (), dest, ::toupper);
+        });
+}
+
+extern "C" statpascal::TAnyValue rt_vstr_copy (statpascal::TAnyValue a, std::int64_t pos, std::int64_t length) {
+    if (pos <= 0)
+        pos = 1;
+    const std::size_t start = pos - 1, maxlen = std::max<std::int64_t> (length, 0);
+    auto substr = [&a, start, maxlen] (std::size_t i) {
+        const std::string_view s = a.get<statpascal::TVectorData> ().getString (i);
+        return start < s.length () ? s.substr (start, maxlen) : std::string_view ();
+    };
+    return makeStringVector (getElementCount (a), 
+        [&substr] (std::size_t i) {
+            return substr (i).length ();
+        },
+        [&substr] (std::size_t i, char *dest) {
+            const std::string_view s = substr (i);
+            std::copy (s.begin (), s.end (), dest);
+        });
+}
+
+extern "C" statpascal::TAnyValue rt_vstr_paste (statpascal::TAnyValue a, statpascal::TAnyValue sep) {
+    const std::size_t n = getElementCount (a);
+    const std::string_view separator = getString (sep);
+    std::string result;
+    if (n) {
+        const statpascal::TVectorData &v = a.get<statpascal::TVectorData> ();
+        std::size_t length = (n - 1) * separator.length ();
+        for (std::size_t i = 0; i < n; ++i)
+            length += v.getString (i).length ();
+        result.reserve (length);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i)
+                result.append (separator);
+            result.append (v.getString (i));
+        }
+    }
+    return std::move (result);
+}
+
+extern "C" statpascal::TAnyValue rt_str_split (statpascal::TAnyValue a, statpascal::TAnyValue sep) {
+    const std::string_view s = getString (a), separator = getString (sep);
+    statpascal::TStringArena out;
+    if (!s.empty ()) {
+        if (separator.empty ())
+            for (char c: s)
+                out.append (std::string_view (&c, 1));
+        else {
+            std::string::size_type start = 0, next;
+            while ((next = s.find (separator, start)) != std::string::npos) {
+                out.append (s.substr (start, next - start));
+                start = next + separator.length ();
+            }
+            out.append (s.substr (start));
+        }
+    }
+    return statpascal::TVectorData (std::move (out), getStringElementManager ());
+}
+
 namespace {
 
 template<class TOp> statpascal::TAnyValue applyVectorOperation (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
@@ -627,7 +986,8 @@ template<class TOp> statpascal::TAnyValue applyVectorOperation (statpascal::TAny
     
     const statpascal::TVectorData &av = a.get<statpascal::TVectorData> (), &bv = b.get<statpascal::TVectorData> ();
     
-    statpascal::TVectorData out (sizeof (T), std::max (av.getElementCount (), bv.getElementCount ()));
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (T), std::max (av.getElementCount (), bv.getElementCount ()));
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     T *result = &out.get<T> (0);
     
     const char *srcbegin1 = &av.get<char> (0),
@@ -734,7 +1094,7 @@ template<class TOp> statpascal::TAnyValue applyVectorOperation (statpascal::TAny
         }
     }
     
-    return std::move (out);
+    return outValue;
 }
 
 template<template<typename T> class TOp> statpascal::TAnyValue applyVectorOperation (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
@@ -745,29 +1105,120 @@ template<template<typename T> class TOp> statpascal::TAnyValue applyVectorOperat
         return applyVectorOperation<TOp<double>> (a, b, tca, tcb);
 }
 
+// Kernels reading the declared element width, used if both operands are vectors of the same
+// single, int32, int16 or int8 type. Bitwise operations on integers cannot overflow and keep
+// the width; they are computed unsigned.
+
+bool isNativeWidth (std::int64_t tca, std::int64_t tcb, bool allowSingle = true) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    return tca == tcb && (tca == s32 || tca == s16 || tca == s8 || (allowSingle && tca == single));
+}
+
+template<typename TIn, typename TOut, template<typename T> class TOp, typename TCalc = TIn> statpascal::TAnyValue applyNativeVectorOperation (statpascal::TAnyValue a, statpascal::TAnyValue b) {
+    TOp<TCalc> op;
+    const statpascal::TVectorData &av = a.get<statpascal::TVectorData> (), &bv = b.get<statpascal::TVectorData> ();
+    const std::size_t na = av.getElementCount (), nb = bv.getElementCount (), n = na && nb ? std::max (na, nb) : 0;
+    
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (TOut), n, nullptr, false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
+    if (n) {
+        TOut *result = &out.get<TOut> (0);
+        const TIn *p = &av.get<TIn> (0), *q = &bv.get<TIn> (0);
+        if (na == nb)
+            for (std::size_t i = 0; i < n; ++i)
+                result [i] = op (static_cast<TCalc> (p [i]), static_cast<TCalc> (q [i]));
+        else if (na == 1) {
+            const TCalc x = p [0];
+            for (std::size_t i = 0; i < n; ++i)
+                result [i] = op (x, static_cast<TCalc> (q [i]));
+        } else if (nb == 1) {
+            const TCalc y = q [0];
+            for (std::size_t i = 0; i < n; ++i)
+                result [i] = op (static_cast<TCalc> (p [i]), y);
+        } else
+            for (std::size_t i = 0; i < n; ++i)
+                result [i] = op (static_cast<TCalc> (p [i % na]), static_cast<TCalc> (q [i % nb]));
+    }
+    return outValue;
+}
+
+template<template<typename T> class TOp> statpascal::TAnyValue applyNativeBitwise (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tc) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    switch (tc) {
+        case s32:
+            return applyNativeVectorOperation<std::int32_t, std::int32_t, TOp, std::uint32_t> (a, b);
+        case s16:
+            return applyNativeVectorOperation<std::int16_t, std::int16_t, TOp, std::uint16_t> (a, b);
+        default:
+            return applyNativeVectorOperation<std::int8_t, std::int8_t, TOp, std::uint8_t> (a, b);
+    }
+}
+
+// integer arithmetic reads the declared width and computes int64 results like the scalar code
+
+template<template<typename T> class TOp> statpascal::TAnyValue applyNativeArithmetic (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tc) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    switch (tc) {
+        case single:
+            return applyNativeVectorOperation<float, float, TOp> (a, b);
+        case s32:
+            return applyNativeVectorOperation<std::int32_t, std::int64_t, TOp, std::int64_t> (a, b);
+        case s16:
+            return applyNativeVectorOperation<std::int16_t, std::int64_t, TOp, std::int64_t> (a, b);
+        default:
+            return applyNativeVectorOperation<std::int8_t, std::int64_t, TOp, std::int64_t> (a, b);
+    }
+}
+
+template<template<typename T> class TOp> statpascal::TAnyValue applyNativeComparison (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tc) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    switch (tc) {
+        case single:
+            return applyNativeVectorOperation<float, bool, TOp> (a, b);
+        case s32:
+            return applyNativeVectorOperation<std::int32_t, bool, TOp> (a, b);
+        case s16:
+            return applyNativeVectorOperation<std::int16_t, bool, TOp> (a, b);
+        default:
+            return applyNativeVectorOperation<std::int8_t, bool, TOp> (a, b);
+    }
+}
+
 } // anonymous namespace
 
 extern "C" statpascal::TAnyValue rt_vec_add (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeArithmetic<std::plus> (a, b, tca);
     return applyVectorOperation<std::plus> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_sub (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeArithmetic<std::minus> (a, b, tca);
     return applyVectorOperation<std::minus> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_or (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb, false))
+        return applyNativeBitwise<std::bit_or> (a, b, tca);
     return applyVectorOperation<std::bit_or<std::int64_t>> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_xor (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb, false))
+        return applyNativeBitwise<std::bit_xor> (a, b, tca);
     return applyVectorOperation<std::bit_xor<std::int64_t>> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_mul (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeArithmetic<std::multiplies> (a, b, tca);
     return applyVectorOperation<std::multiplies> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_div (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb) && tca == statpascal::TStdType::TScalarTypeCode::single)
+        return applyNativeVectorOperation<float, float, std::divides> (a, b);
     return applyVectorOperation<std::divides> (a, b, tca, tcb);
 }
 
@@ -776,6 +1227,8 @@ extern "C" statpascal::TAnyValue rt_vec_mod (statpascal::TAnyValue a, statpascal
 }
 
 extern "C" statpascal::TAnyValue rt_vec_and (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb, false))
+        return applyNativeBitwise<std::bit_and> (a, b, tca);
     return applyVectorOperation<std::bit_and<std::int64_t>> (a, b, tca, tcb);
 }
 
@@ -788,29 +1241,213 @@ extern "C" statpascal::TAnyValue rt_vec_shr (statpascal::TAnyValue a, statpascal
 }
 
 extern "C" statpascal::TAnyValue rt_vec_equal (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::equal_to> (a, b, tca);
     return applyVectorOperation<std::equal_to> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_not_equal (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::not_equal_to> (a, b, tca);
     return applyVectorOperation<std::not_equal_to> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_less_equal (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::less_equal> (a, b, tca);
     return applyVectorOperation<std::less_equal> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_greater_equal (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::greater_equal> (a, b, tca);
     return applyVectorOperation<std::greater_equal> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_less (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::less> (a, b, tca);
     return applyVectorOperation<std::less> (a, b, tca, tcb);
 }
 
 extern "C" statpascal::TAnyValue rt_vec_greater (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    if (isNativeWidth (tca, tcb))
+        return applyNativeComparison<std::greater> (a, b, tca);
     return applyVectorOperation<std::greater> (a, b, tca, tcb);
 }
 
+namespace {
+
+// Element-wise comparisons evaluated until the first element with the requested result,
+// used for any, all, firstIndex and which without creating the boolean vector
+
+template<typename T> T loadScalar (const char *p, std::int64_t tc) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    switch (tc) {
+        case s64:
+            return *reinterpret_cast<const std::int64_t *> (p);
+        case s32:
+            return *reinterpret_cast<const std::int32_t *> (p);
+        case s16:
+            return *reinterpret_cast<const std::int16_t *> (p);
+        case s8:
+            return *reinterpret_cast<const std::int8_t *> (p);
+        case u8:
+            return *reinterpret_cast<const std::uint8_t *> (p);
+        case u16:
+            return *reinterpret_cast<const std::uint16_t *> (p);
+        case u32:
+            return *reinterpret_cast<const std::uint32_t *> (p);
+        case single:
+            return *reinterpret_cast<const float *> (p);
+        case real:
+            return *reinterpret_cast<const double *> (p);
+        default:
+            return T ();
+    }
+}
+
+std::size_t comparisonCount (const statpascal::TAnyValue &a, const statpascal::TAnyValue &b) {
+    if (!a.hasValue () || !b.hasValue ())
+        return 0;
+    const std::size_t na = a.get<statpascal::TVectorData> ().getElementCount (), nb = b.get<statpascal::TVectorData> ().getElementCount ();
+    return na && nb ? std::max (na, nb) : 0;
+}
+
+// returns the 0-based index of the first element >= start with comparison result value or the element count
+
+template<typename T, typename TOp> std::size_t findTypedComparison (const statpascal::TVectorData &av, const statpascal::TVectorData &bv, std::size_t n, bool value, std::size_t start) {
+    TOp op;
+    const std::size_t na = av.getElementCount (), nb = bv.getElementCount ();
+    const T *p = &av.get<T> (0), *q = &bv.get<T> (0);
+    if (na == n && nb == n) {
+        for (std::size_t i = start; i < n; ++i)
+            if (op (p [i], q [i]) == value)
+                return i;
+    } else if (nb == 1) {
+        const T y = q [0];
+        for (std::size_t i = start; i < n; ++i)
+            if (op (p [i % na], y) == value)
+                return i;
+    } else
+        for (std::size_t i = start; i < n; ++i)
+            if (op (p [i % na], q [i % nb]) == value)
+                return i;
+    return n;
+}
+
+template<typename T, typename TOp> std::size_t findMixedComparison (const statpascal::TVectorData &av, const statpascal::TVectorData &bv, std::int64_t tca, std::int64_t tcb, std::size_t n, bool value, std::size_t start) {
+    TOp op;
+    const std::size_t na = av.getElementCount (), nb = bv.getElementCount ();
+    const std::size_t sa = statpascal::TStdType::scalarTypeSizes [tca], sb = statpascal::TStdType::scalarTypeSizes [tcb];
+    const char *p = &av.get<char> (0), *q = &bv.get<char> (0);
+    for (std::size_t i = start; i < n; ++i)
+        if (op (loadScalar<T> (p + (i % na) * sa, tca), loadScalar<T> (q + (i % nb) * sb, tcb)) == value)
+            return i;
+    return n;
+}
+
+template<template<typename T> class TOp> std::size_t findComparison (statpascal::TAnyValue &a, statpascal::TAnyValue &b, std::int64_t tca, std::int64_t tcb, bool value, std::size_t start) {
+    using enum statpascal::TStdType::TScalarTypeCode;
+    const std::size_t n = comparisonCount (a, b);
+    if (start >= n)
+        return n;
+    const statpascal::TVectorData &av = a.get<statpascal::TVectorData> (), &bv = b.get<statpascal::TVectorData> ();
+    if (tca == tcb)
+        switch (tca) {
+            case s64:
+                return findTypedComparison<std::int64_t, TOp<std::int64_t>> (av, bv, n, value, start);
+            case s32:
+                return findTypedComparison<std::int32_t, TOp<std::int32_t>> (av, bv, n, value, start);
+            case s16:
+                return findTypedComparison<std::int16_t, TOp<std::int16_t>> (av, bv, n, value, start);
+            case s8:
+                return findTypedComparison<std::int8_t, TOp<std::int8_t>> (av, bv, n, value, start);
+            case u8:
+                return findTypedComparison<std::uint8_t, TOp<std::uint8_t>> (av, bv, n, value, start);
+            case u16:
+                return findTypedComparison<std::uint16_t, TOp<std::uint16_t>> (av, bv, n, value, start);
+            case u32:
+                return findTypedComparison<std::uint32_t, TOp<std::uint32_t>> (av, bv, n, value, start);
+            case single:
+                return findTypedComparison<float, TOp<float>> (av, bv, n, value, start);
+            case real:
+                return findTypedComparison<double, TOp<double>> (av, bv, n, value, start);
+            default:
+                break;
+        }
+    if (tca == real || tcb == real || tca == single || tcb == single)
+        return findMixedComparison<double, TOp<double>> (av, bv, tca, tcb, n, value, start);
+    else
+        return findMixedComparison<std::int64_t, TOp<std::int64_t>> (av, bv, tca, tcb, n, value, start);
+}
+
+template<template<typename T> class TOp> std::int64_t firstComparison (statpascal::TAnyValue &a, statpascal::TAnyValue &b, std::int64_t tca, std::int64_t tcb, bool value) {
+    const std::size_t i = findComparison<TOp> (a, b, tca, tcb, value, 0);
+    return i == comparisonCount (a, b) ? 0 : i + 1;
+}
+
+template<template<typename T> class TOp> statpascal::TAnyValue whichComparison (statpascal::TAnyValue &a, statpascal::TAnyValue &b, std::int64_t tca, std::int64_t tcb) {
+    const std::size_t n = comparisonCount (a, b);
+    std::vector<std::int64_t> positions;
+    for (std::size_t i = findComparison<TOp> (a, b, tca, tcb, true, 0); i < n; i = findComparison<TOp> (a, b, tca, tcb, true, i + 1))
+        positions.push_back (i + 1);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (sizeof (std::int64_t), positions.size (), nullptr, false);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
+    std::copy (positions.begin (), positions.end (), &out.get<std::int64_t> (0));
+    return outValue;
+}
+
+} // anonymous namespace
+
+extern "C" std::int64_t rt_vec_equal_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::equal_to> (a, b, tca, tcb, value);
+}
+
+extern "C" std::int64_t rt_vec_not_equal_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::not_equal_to> (a, b, tca, tcb, value);
+}
+
+extern "C" std::int64_t rt_vec_less_equal_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::less_equal> (a, b, tca, tcb, value);
+}
+
+extern "C" std::int64_t rt_vec_greater_equal_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::greater_equal> (a, b, tca, tcb, value);
+}
+
+extern "C" std::int64_t rt_vec_less_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::less> (a, b, tca, tcb, value);
+}
+
+extern "C" std::int64_t rt_vec_greater_first (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb, sp_bool value) {
+    return firstComparison<std::greater> (a, b, tca, tcb, value);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_equal_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::equal_to> (a, b, tca, tcb);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_not_equal_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::not_equal_to> (a, b, tca, tcb);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_less_equal_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::less_equal> (a, b, tca, tcb);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_greater_equal_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::greater_equal> (a, b, tca, tcb);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_less_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::less> (a, b, tca, tcb);
+}
+
+extern "C" statpascal::TAnyValue rt_vec_greater_which (statpascal::TAnyValue a, statpascal::TAnyValue b, std::int64_t tca, std::int64_t tcb) {
+    return whichComparison<std::greater> (a, b, tca, tcb);
+}
+
 extern "C" statpascal::TAnyValue rt_vec_conv (statpascal::TAnyValue a, std::int64_t tcs, std::int64_t tcd) {
     using enum statpascal::TStdType::TScalarTypeCode;
     
@@ -818,7 +1455,8 @@ extern "C" statpascal::TAnyValue rt_vec_conv (statpascal::TAnyValue a, std::int6
         srcSize = statpascal::TStdType::scalarTypeSizes [tcs],
         dstSize = statpascal::TStdType::scalarTypeSizes [tcd],
         n = a.get<statpascal::TVectorData> ().getElementCount ();
-    statpascal::TVectorData out (dstSize, n);
+    statpascal::TAnyValue outValue = statpascal::TVectorData::create (dstSize, n);
+    statpascal::TVectorData &out = outValue.get<statpascal::TVectorData> ();
     const bool srcint = tcs != single && tcs != real;
     const char *srcit = &a.get<statpascal::TVectorData> ().get<char> (0);
     char *dstit = &out.get<char> (0);
@@ -897,7 +1535,7 @@ extern "C" statpascal::TAnyValue rt_vec_conv (statpascal::TAnyValue a, std::int6
         }
         dstit += dstSize;        
     }    
-    return std::move (out);
+    return outValue;
 }
 
 // text files
@@ -906,7 +1544,7 @@ namespace {
 
 void openTextFile (TFileStruct *f, void (statpascal::TFileHandler::*op) (), statpascal::TRuntimeData *runtimeData) {
     f->binary = false;
-    const std::string s = getString (f->fn);
+    const std::string s (getString (f->fn));
     statpascal::TTextFileBaseHandler *fh;
     if (s.empty ())
         fh = new statpascal::TStdioHandler ();
@@ -920,7 +1558,7 @@ void openTextFile (TFileStruct *f, void (statpascal::TFileHandler::*op) (), stat
 void openBinFile (TFileStruct *f, std::size_t recordSize, void (statpascal::TFileHandler::*op) (), statpascal::TRuntimeData *runtimeData) {
     f->binary = true;
     f->blksize = recordSize;
-    const std::string s = getString (f->fn);
+    const std::string s (getString (f->fn));
     statpascal::TBinaryFileHandler *fh;
     fh = new statpascal::TBinaryFileHandler (s);
     f->idx = runtimeData->registerFileHandler (fh);
@@ -972,7 +1610,7 @@ extern "C" void rt_close (TFileStruct *f, statpascal::TRuntimeData *runtimeData)
 }
 
 extern "C" void rt_erase (TFileStruct *f) {
-    const std::string fn = getString (f->fn);
+    const std::string fn (getString (f->fn));
     if (!fn.empty ())
         // TODO: Runtime error if file is open !!!!
         std::filesystem::remove (fn);
@@ -1031,6 +1669,14 @@ template<typename T> void rt_write_val (TFileStruct *f, T v, std::int64_t length
     os << v << std::setprecision (prec);
 }
 
+template<typename T> T getVectorElement (const statpascal::TVectorData &v, std::size_t index) {
+    return v.get<T> (index);
+}
+
+template<> std::string_view getVectorElement<std::string_view> (const statpascal::TVectorData &v, std::size_t index) {
+    return v.getString (index);
+}
+
 template<typename T> void rt_write_vector (TFileStruct *f, statpascal::TAnyValue v, std::int64_t length, std::int64_t precision, statpascal::TRuntimeData *runtimeData) {
     std::ostream &os = runtimeData->getTextFileBaseHandler (f->idx).getOutputStream ();
     std::streamsize prec = os.precision ();
@@ -1039,7 +1685,7 @@ template<typename T> void rt_write_vector (TFileStruct *f, statpascal::TAnyValue
     for (std::size_t i = 0, ei = v.get<statpascal::TVectorData> ().getElementCount (); i < ei; ++i) {
         if (length >= 0)
             os << std::setw (length);
-        os << v.get<statpascal::TVectorData> ().get<T> (i);
+        os << getVectorElement<T> (v.get<statpascal::TVectorData> (), i);
         if (length < 0)
             os << ' ';
     }
@@ -1057,7 +1703,7 @@ extern "C" void rt_write_char (TFileStruct *f, char ch, std::int64_t length, std
 }
 
 extern "C" void rt_write_string (TFileStruct *f, statpascal::TAnyValue s, std::int64_t length, std::int64_t precision, statpascal::TRuntimeData *runtimeData) {
-    rt_write_val<std::string> (f, getString (s), length, precision, runtimeData);
+    rt_write_val<std::string_view> (f, getString (s), length, precision, runtimeData);
 }
 
 extern "C" void rt_write_bool (TFileStruct *f, bool b, std::int64_t length, std::int64_t precision, statpascal::TRuntimeData *runtimeData) {
@@ -1077,7 +1723,7 @@ extern "C" void rt_write_vchar (TFileStruct *f, statpascal::TAnyValue v, std::in
 }
 
 extern "C" void rt_write_vstring (TFileStruct *f, statpascal::TAnyValue v, std::int64_t length, std::int64_t precision, statpascal::TRuntimeData *runtimeData) {
-    rt_write_vector<std::string> (f, v, length, precision, runtimeData);
+    rt_write_vector<std::string_view> (f, v, length, precision, runtimeData);
 }
 
 extern "C" void rt_write_vbool (TFileStruct *f, statpascal::TAnyValue v, std::int64_t length, std::int64_t precision, statpascal::TRuntimeData *runtimeData) {
@@ -1214,6 +1860,7 @@ extern "C" sp_bool rt_set_super_not_equal (TSet *s, TSet *t) {
 
 extern "C" void rt_thread_create (void *(*p) (void *), void *arg, std::int64_t *threadId) {
     pthread_t tid;
+    statpascal::TAnyValue::enableThreadSafety ();
     pthread_create (&tid, nullptr, p, arg);
     *threadId = tid;
 }
@@ -1221,6 +1868,7 @@ extern "C" void rt_thread_create (void *(*p) (void *), void *arg, std::int64_t *
 extern "C" void rt_thread_join (std::int64_t threadId, std::int64_t timeout) {
     pthread_t tid = threadId;
     pthread_join (tid, nullptr);
+    statpascal::TAnyValue::processQueuedReleases ();
 }
 
 extern "C" void rt_mutex_init (void **p) {
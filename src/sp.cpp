@@ -13,6 +13,7 @@
 #include "a64gen.hpp"
 #include "tms9900gen.hpp"
 #include "runtime.hpp"
+#include "heapprofile.hpp"
 
 namespace sp = statpascal;
 
@@ -27,6 +28,21 @@ bool haveParameter (const char *s, int &argc, char **argv) {
     return false;
 }
 
+// option of the form name=value
+
+bool getSizeParameter (const char *s, std::size_t &value, int &argc, char **argv) {
+    const std::size_t len = std::strlen (s);
+    for (int i = 1; i < argc; ++i)
+        if (!std::strncmp (s, argv [i], len) && argv [i][len] == '=') {
+            value = std::strtoul (argv [i] + len + 1, nullptr, 10);
+            for (; i + 1 < argc; ++i)
+                argv [i] = argv [i + 1];
+            --argc;
+            return true;
+        }
+    return false;
+}
+
 std::int64_t getSystemMemory () {
     return static_cast<std::int64_t> (sysconf (_SC_PHYS_PAGES)) * sysconf (_SC_PAGE_SIZE);
 }
@@ -52,10 +68,15 @@ private:
     std::chrono::high_resolution_clock::time_point t1, t2;
 };
 
+void showStatistics (const sp::TCompiler &compiler) {
+    const sp::TCompiler::TStatistics &statistics = compiler.getStatistics ();
+    std::cout << "Routines_ " << statistics.routines << " generated, " << statistics.unusedRoutines << " unused, "
+              << statistics.unreachableRoutines << " unreachable after optimization" << std::endl;
+}
 
 void compile9900 (int argc, char **argv) {
     namespace po = boost::program_options;
-    bool buildCart = false, buildEA5 = false;
+    bool buildCart = false, buildEA5 = false, noLoopOptimization = false, noCommonSubexpressions = false, stats = false;
     std::string inputFile, outputFile;
     po::options_description desc ("StatPascal cross compiler for TMS9900 version " __DATE__ " " __TIME__);
     desc.add_options ()
@@ -64,6 +85,12 @@ void compile9900 (int argc, char **argv) {
         ("ea5",  po::bool_switch (&buildEA5), "Build EA5 program")
         ("no-header", po::bool_switch (&sp::TConfig::omitHeader), "Omit standard header")
         ("bank", po::value<std::uint16_t> (&sp::TConfig::startBank)->default_value (0), "First bank used in cart")
+        ("inline-size", po::value<std::size_t> (&sp::TConfig::inlineSize)->default_value (sp::TConfig::inlineSize), "Max. size of inlined routines, 0 disables inlining")
+        ("inline-argument-size", po::value<std::size_t> (&sp::TConfig::inlineArgumentSize)->default_value (sp::TConfig::inlineArgumentSize), "Max. size of arguments evaluated more than once by inlined routines")
+        ("no-loop-optimization", po::bool_switch (&noLoopOptimization), "Do not move invariant computations out of for loops")
+        ("no-common-subexpressions", po::bool_switch (&noCommonSubexpressions), "Do not evaluate repeated expressions once")
+        ("stats", po::bool_switch (&stats), "Show number of generated and removed routines")
+        ("dump-tree", po::bool_switch (&sp::TConfig::dumpSyntaxTree), "Write the optimized syntax tree")
         ("input-file,i", po::value<std::string> (&inputFile), "Input file")
         ("output-file,o", po::value<std::string> (&outputFile)->default_value ("out.a99"), "Output file")
     ;
@@ -95,6 +122,8 @@ void compile9900 (int argc, char **argv) {
         sp::TConfig::target = sp::TConfig::TTarget::TI_CART;
     if (buildEA5)
         sp::TConfig::target = sp::TConfig::TTarget::TI_EA5;
+    sp::TConfig::optimizeLoops = !noLoopOptimization;
+    sp::TConfig::optimizeCommonSubexpressions = !noCommonSubexpressions;
 
     sp::TRuntimeData runtimeData;
     sp::T9900Generator generator (runtimeData);
@@ -107,6 +136,8 @@ void compile9900 (int argc, char **argv) {
     
     if (compiler.compile () == sp::TCompiler::TCompileResult::Error)
         exit (1);
+    if (stats)
+        showStatistics (compiler);
     
     std::vector<std::string> listing;
     std::vector<std::uint8_t> opcodes;
@@ -116,6 +147,23 @@ void compile9900 (int argc, char **argv) {
     std::copy (listing.begin (), listing.end (), std::ostream_iterator<std::string> (f, "\n"));
 }
 
+std::string getTokenCacheDirectory () {
+    if (const char *s = getenv ("XDG_CACHE_HOME"); s && *s)
+        return std::string (s) + "/statpascal";
+    if (const char *s = getenv ("HOME"); s && *s)
+        return std::string (s) + "/.cache/statpascal";
+    return std::string ();
+}
+
+// size and time of the executable identify the build
+
+std::string getCompilerVersion (const std::filesystem::path &exepath) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size (exepath, ec);
+    const std::filesystem::file_time_type time = std::filesystem::last_write_time (exepath, ec);
+    return std::to_string (size) + '-' + std::to_string (time.time_since_epoch ().count ());
+}
+
 void compile (int argc, char **argv) {
 #ifdef CREATE_9900
         sp::TConfig::target = sp::TConfig::TTarget::TI_EA5;
@@ -124,7 +172,16 @@ void compile (int argc, char **argv) {
 #endif        
 
     bool createListing = haveParameter ("--listing", argc, argv),
-         showTimes = haveParameter ("--time", argc, argv);
+         showTimes = haveParameter ("--time", argc, argv),
+         showStats = haveParameter ("--stats", argc, argv),
+         heapProfile = haveParameter ("--heap-profile", argc, argv),
+         tokenCache = !haveParameter ("--no-token-cache", argc, argv),
+         serialCodegen = haveParameter ("--serial-codegen", argc, argv);
+    getSizeParameter ("--inline-size", sp::TConfig::inlineSize, argc, argv);
+    getSizeParameter ("--inline-argument-size", sp::TConfig::inlineArgumentSize, argc, argv);
+    sp::TConfig::optimizeLoops = !haveParameter ("--no-loop-optimization", argc, argv);
+    sp::TConfig::optimizeCommonSubexpressions = !haveParameter ("--no-common-subexpressions", argc, argv);
+    sp::TConfig::dumpSyntaxTree = haveParameter ("--dump-tree", argc, argv);
     
     sp::TRuntimeData runtimeData;
 //    printf ("Runtime is at %p\n", &runtimeData);
@@ -135,6 +192,8 @@ void compile (int argc, char **argv) {
 #ifdef CREATE_X64
     sp::TConfig::target = sp::TConfig::TTarget::X64;
     sp::TX64Generator generator (runtimeData);
+    if (serialCodegen)
+        generator.setCodegenThreads (1);
 #else
     sp::TConfig::target = sp::TConfig::TTarget::AARCH64;
     createListing = true;	// asm source required
@@ -146,11 +205,15 @@ void compile (int argc, char **argv) {
     
     std::filesystem::path exepath = std::filesystem::read_symlink ("/proc/self/exe");
     compiler.setUnitSearchPathes ({".", exepath.parent_path ().string () + "/../units"});
+    if (tokenCache)
+        compiler.setTokenCacheDirectory (getTokenCacheDirectory (), getCompilerVersion (exepath));
     
     {
         TTimer t (showTimes ? "Compile time" : "");
         compiler.compile ();
     }
+    if (showStats)
+        showStatistics (compiler);
     
     std::vector<std::string> listing;
     std::vector<std::uint8_t> opcodes;
@@ -189,6 +252,12 @@ void compile (int argc, char **argv) {
         perror ("SP mprotect");
         exit (1);
     }
+    if (heapProfile)
+#ifdef CREATE_X64
+        sp::THeapProfile::enable (p, opcodes.size (), generator.getRoutineLabels ());
+#else
+        sp::THeapProfile::enable (p, opcodes.size (), {});
+#endif
     reinterpret_cast<void (*)()> (p) ();
     mprotect (p, opcodes.size (), PROT_READ | PROT_WRITE);
     munmap (p, opcodes.size ());
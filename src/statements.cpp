@@ -112,6 +112,39 @@ void TRoutineCall::acceptCodeGenerator (TCodeGenerator &codeGenerator) {
 }
 
 
+TStatement *TSimpleStatement::createStringAppend (TExpressionBase *left, TExpressionBase *right, TBlock &declarations) {
+    auto isConcat = [] (TExpressionBase *expr) {
+        if (expr->isFunctionCall ())
+            if (TRoutineValue *routine = dynamic_cast<TRoutineValue *> (static_cast<TFunctionCall *> (expr)->getFunction ()))
+                return routine->getSymbol ()->getName () == "__str_concat";
+        return false;
+    };
+    TVariable *variable = dynamic_cast<TVariable *> (left);
+    if (!variable || left->getType () != &stdType.String || !isConcat (right))
+        return nullptr;
+        
+    // find the leftmost operand of the concatenation
+    std::vector<TExpressionBase *> parts;
+    TExpressionBase *base = right;
+    while (isConcat (base)) {
+        const std::vector<TExpressionBase *> &args = static_cast<TFunctionCall *> (base)->getArguments ();
+        parts.push_back (args [1]);
+        base = args [0];
+    }
+    if (!base->isLValueDereference ())
+        return nullptr;
+    TVariable *baseVariable = dynamic_cast<TVariable *> (static_cast<TLValueDereference *> (base)->getLValue ());
+    if (!baseVariable || baseVariable->getSymbol () != variable->getSymbol ())
+        return nullptr;
+
+    // the remaining parts are concatenated before s is changed as they may refer to s
+    TExpressionBase *appended = parts.back ();
+    for (std::size_t i = parts.size () - 1; i > 0; --i)
+        appended = TExpressionBase::createRuntimeCall ("__str_concat", &stdType.String, {appended, parts [i - 1]}, declarations, false);
+    return declarations.getCompiler ().createMemoryPoolObject<TRoutineCall> (
+        TExpressionBase::createRuntimeCall ("__str_append", nullptr, {left, appended}, declarations, false));
+}
+
 TStatement *TSimpleStatement::parse (TBlock &declarations) {
     TCompilerImpl &compiler = declarations.getCompiler ();
     TLexer &lexer = compiler.getLexer ();
@@ -133,6 +166,8 @@ TStatement *TSimpleStatement::parse (TBlock &declarations) {
                     compiler.errorMessage (TCompilerImpl::InvalidUseOfSymbol, "Cannot assign to function result");
                 else if (!left->isVectorIndex ()) {	// handled as function call
                     TExpressionBase::performTypeConversion (left->getType (), right, declarations);
+                    if (TStatement *append = createStringAppend (left, right, declarations))
+                        return append;
                     if (right->isFunctionCall () && (
                             left->getType () == right->getType () || 
                             left->getType ()->isVector () || 
@@ -49,6 +49,7 @@ public:
     TStatement *getStatement () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     void parse (TBlock &);
 
     TSymbol *label;
@@ -76,6 +77,7 @@ public:
     TExpressionBase *getExpression () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *lValue, *expr;
 };
 
@@ -103,6 +105,7 @@ public:
     TExpressionBase *getRoutineCall () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     TExpressionBase *routineCall;
 };
 
@@ -118,6 +121,10 @@ inline TExpressionBase *TRoutineCall::getRoutineCall () const {
 class TSimpleStatement: public TStatement {
 public:
     static TStatement *parse (TBlock &declarations);
+    
+private:
+    // s := s + t [+ ...] becomes an in place append to s; returns nullptr for other assignments
+    static TStatement *createStringAppend (TExpressionBase *left, TExpressionBase *right, TBlock &declarations);
 };
 
 
@@ -161,7 +168,8 @@ public:
     TStatement *getStatement1 () const;
     TStatement *getStatement2 () const;
     
-private:    
+private:
+    friend class TSyntaxTreeRewriter;    
     void parse (TBlock &);
     
     TExpressionBase *condition;
@@ -195,7 +203,8 @@ public:
     void appendFront (TStatement *);
     void appendBack (TStatement *);
     
-private:    
+private:
+    friend class TSyntaxTreeRewriter;    
     void parse (TBlock &);
     
     std::vector<TStatement *> statements;
@@ -242,6 +251,7 @@ public:
     std::int64_t getMaxLabel () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
     void parse (TBlock &);
 
     TExpressionBase *expression;
@@ -295,6 +305,7 @@ public:
     TExpressionBase *getCondition () const;
     
 private:
+    friend class TSyntaxTreeRewriter;
      void parse (TBlock &);
 
      TSymbol *label;
@@ -2,6 +2,7 @@
 #include "anyvalue.hpp"
 
 #include <limits>
+#include <algorithm>
 
 #include <iostream>
 
@@ -10,7 +11,7 @@ namespace statpascal {
 const ssize_t TSymbol::LabelDefined, TSymbol::UndefinedLabelUsed, TSymbol::InvalidRegister;
 
 TSymbol::TSymbol (const std::string &name, TType *type, std::size_t level, TFlags flags, TSymbol *alias):
-  name (name), level (level), tempBlock (0), bankNumber (0), flags (flags), alias (alias), block (nullptr), offset (0), parameterPosition (0), assignedRegister (InvalidRegister), aliased (false), used (false), constantValue (nullptr) {
+  name (name), level (level), tempBlock (0), bankNumber (0), flags (flags), alias (alias), block (nullptr), offset (0), parameterPosition (0), assignedRegister (InvalidRegister), aliased (false), borrowed (false), used (false), constantValue (nullptr) {
     setType (type);
 }
 
@@ -103,9 +104,9 @@ TSymbolList::TAddSymbolResult TSymbolList::addNamedType (const std::string &name
 }
 
 TSymbolList::TAddSymbolResult TSymbolList::addSymbol (const std::string &name, TType *type, TSymbol::TFlags flags, TSymbol *alias) {
-    std::vector<TSymbol *> results;
-    std::copy_if (symbols.begin (), symbols.end (), std::back_inserter (results), [&name] (TSymbol *s) { return s->getName () == name; });
-    if (!results.empty ()) {
+    std::unordered_map<std::string, TBaseContainer>::const_iterator it = index.find (name);
+    if (it != index.end ()) {
+        const TBaseContainer &results = it->second;
         if (type && type->isRoutine () && results.front ()->getType ()->isRoutine ()) {
             for (TSymbol *s: results)
                 if (static_cast<TRoutineType *> (s->getType ())->matchesOverload (static_cast<TRoutineType *> (type)))
@@ -115,50 +116,60 @@ TSymbolList::TAddSymbolResult TSymbolList::addSymbol (const std::string &name, T
     }
         
     TSymbol *s = memoryPoolFactory.create<TSymbol> (name, type, level, flags, alias);
-    symbols.push_back (s);
+    appendSymbol (s);
     return {s, false};
 }
 
+void TSymbolList::appendSymbol (TSymbol *s) {
+    symbols.push_back (s);
+    index [s->getName ()].push_back (s);
+}
+
+void TSymbolList::removeFromIndex (const TSymbol *s) {
+    std::unordered_map<std::string, TBaseContainer>::iterator it = index.find (s->getName ());
+    if (it != index.end ()) {
+        it->second.erase (std::remove (it->second.begin (), it->second.end (), s), it->second.end ());
+        if (it->second.empty ())
+            index.erase (it);
+    }
+}
+
+bool TSymbolList::contains (const TSymbol *s) const {
+    std::unordered_map<std::string, TBaseContainer>::const_iterator it = index.find (s->getName ());
+    return it != index.end () && std::find (it->second.begin (), it->second.end (), s) != it->second.end ();
+}
+
 TSymbol *TSymbolList::makeLocalLabel (char c) {
-    symbols.push_back (memoryPoolFactory.create<TSymbol> (std::string ("__") + c, nullptr, level, TSymbol::Label, nullptr));
+    appendSymbol (memoryPoolFactory.create<TSymbol> (std::string ("__") + c, nullptr, level, TSymbol::Label, nullptr));
     return symbols.back ();
 }
 
 TSymbol *TSymbolList::searchSymbol (const std::string &name, TSymbol::TFlags flags) const {
-    std::vector<TSymbol *> result = searchSymbols (name, flags);
-    if (result.empty ())
-        return nullptr;
-    else
-        return result.front ();
-}
-
-std::vector<TSymbol *> TSymbolList::searchSymbols (const std::string &name, TSymbol::TFlags flags) const {
-    std::vector<TSymbol *> result; // = search (name);
-    const TSymbolList *searchLevel = this;
-    do {
-        std::copy_if (searchLevel->symbols.begin (), searchLevel->symbols.end (), std::back_inserter (result), [&name] (TSymbol *s) { return s->getName () == name; });
-        searchLevel = searchLevel->previousLevel;
-    } while (result.empty () && searchLevel);
-        
-    result.erase (
-        std::remove_if (result.begin (), result.end (), [flags] (const TSymbol *s) {return !(s->getSymbolFlags () & flags);}),
-        result.end ());
-    return result;
-    /*
-    std::vector<TSymbol *> result; // = search (name);
-    std::copy_if (symbols.begin (), symbols.end (), std::back_inserter (result), [&name] (TSymbol *s) { return s->getName () == name; });
-    if (result.empty () && previousLevel)
-        return previousLevel->searchSymbols (name, flags);
-        
-    result.erase (
-        std::remove_if (result.begin (), result.end (), [flags] (const TSymbol *s) {return !(s->getSymbolFlags () & flags);}),
-        result.end ());
-    return result;
-    */
+    for (TSymbol *s: searchSymbols (name))
+        if (s->getSymbolFlags () & flags)
+            return s;
+    return nullptr;
+}
+
+const TSymbolList::TBaseContainer &TSymbolList::searchSymbols (const std::string &name) const {
+    static const TBaseContainer notFound;
+    for (const TSymbolList *searchLevel = this; searchLevel; searchLevel = searchLevel->previousLevel) {
+        std::unordered_map<std::string, TBaseContainer>::const_iterator it = searchLevel->index.find (name);
+        if (it != searchLevel->index.end ())
+            return it->second;
+    }
+    return notFound;
 }
 
 void TSymbolList::removeSymbol (const TSymbol *symbol) {
     symbols.erase (std::remove (symbols.begin (), symbols.end (), symbol), symbols.end ());
+    removeFromIndex (symbol);
+}
+
+void TSymbolList::renameSymbol (TSymbol *symbol, const std::string &name) {
+    removeFromIndex (symbol);
+    symbol->name = name;
+    index [name].push_back (symbol);
 }
 
 void TSymbolList::beginNewTempBlock () {
@@ -168,28 +179,32 @@ void TSymbolList::beginNewTempBlock () {
     }
 }
 
-void TSymbolList::removeUnusedSymbols () {
+std::size_t TSymbolList::removeUnusedSymbols () {
     TBaseContainer::iterator start = std::stable_partition (symbols.begin (), symbols.end (), [] (TSymbol *s) { return s->isUsed (); });
 //    for (TBaseContainer::iterator it = start; it != symbols.end (); ++it)
 //        std::cout << "Unused: " << (*it)->getName () <<  std::endl;
+    for (TBaseContainer::iterator it = start; it != symbols.end (); ++it)
+        removeFromIndex (*it);
+    const std::size_t count = symbols.end () - start;
     symbols.erase (start, symbols.end ());    
+    return count;
 }
 
 void TSymbolList::moveSymbols (TSymbol::TFlags flags, TSymbolList &dest) {
-    for (TBaseContainer::iterator it = symbols.begin (); it != symbols.end (); )
-        if ((*it)->getSymbolFlags () & flags) {
-            dest.symbols.push_back (*it);
-            it = symbols.erase (it);
-        } else
-            ++it;
+    TBaseContainer::iterator start = std::stable_partition (symbols.begin (), symbols.end (), [flags] (TSymbol *s) { return !(s->getSymbolFlags () & flags); });
+    for (TBaseContainer::iterator it = start; it != symbols.end (); ++it) {
+        removeFromIndex (*it);
+        dest.appendSymbol (*it);
+    }
+    symbols.erase (start, symbols.end ());
 }
 
 void TSymbolList::copySymbols (TSymbol::TFlags flags, TSymbolList &dest) {
     for (TSymbol *s: symbols) {
         if (s->getSymbolFlags () & flags)
             // TODO: !!!! check for duplicates when importing units multiple times (system.sp!)
-            if (std::find (dest.begin (), dest.end (), s) == dest.end ()) 
-                dest.symbols.push_back (s);
+            if (!dest.contains (s))
+                dest.appendSymbol (s);
     }
 }
 
@@ -217,4 +232,12 @@ TSymbolList *TSymbolList::getPreviousLevel () const {
     return previousLevel;
 }
 
+void TSymbolList::addInlinedCall (const std::string &routineName) {
+    ++inlinedCalls [routineName];
+}
+
+const std::map<std::string, std::size_t> &TSymbolList::getInlinedCalls () const {
+    return inlinedCalls;
+}
+
 }
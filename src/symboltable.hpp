@@ -4,6 +4,7 @@
 #pragma once
 
 #include <array>
+#include <map>
 #include <vector>
 #include <unordered_map>
 
@@ -37,7 +38,6 @@ public:
     TSymbol (const std::string &name, TType *type, std::size_t level, TFlags flags, TSymbol *alias);
     ~TSymbol () = default;
 
-    void setName (const std::string &s);    
     const std::string &getName () const;
     TSymbol *getAlias () const;
     
@@ -63,6 +63,10 @@ public:
     void setAliased ();
     bool isAliased () const;
     
+    /** set for value parameters the routine may use without copying the caller's object */
+    void setBorrowed ();
+    bool isBorrowed () const;
+    
     void setUsed (bool f = true);
     bool isUsed () const;
 
@@ -91,13 +95,15 @@ public:
     
     static const ssize_t LabelDefined = -1, UndefinedLabelUsed = -2, InvalidRegister = -1;
 private:
+    friend class TSymbolList;	// renames symbols
+    
     std::string name, libName, extSymbolName;
     std::size_t level, tempBlock, bankNumber;
     TFlags flags;
     TSymbol *alias;
     TBlock *block;
     ssize_t offset, parameterPosition, assignedRegister;
-    bool aliased, used;
+    bool aliased, borrowed, used;
     TType *type;
     const TConstant *constantValue;
 };
@@ -125,12 +131,17 @@ public:
     TAddSymbolResult addLabel (const std::string &name);
     TAddSymbolResult addNamedType (const std::string &name, TType *type);
     
+    using TBaseContainer = std::vector<TSymbol *>;
+    
     TSymbol *searchSymbol (const std::string &name, TSymbol::TFlags = TSymbol::AllSymbols) const;
-    std::vector<TSymbol *> searchSymbols (const std::string &name, TSymbol::TFlags = TSymbol::AllSymbols) const;
+    /** returns all symbols with the name in the innermost level declaring it, overloads in order of declaration */
+    const TBaseContainer &searchSymbols (const std::string &name) const;
     void removeSymbol (const TSymbol *);
+    void renameSymbol (TSymbol *, const std::string &name);
     
     void beginNewTempBlock ();
-    void removeUnusedSymbols ();
+    /** returns the number of symbols removed */
+    std::size_t removeUnusedSymbols ();
     
     TSymbol *makeLocalLabel (char c);	// -> yields --c - makeUniqueLabelNames in TBaseGenerator provides distinct names. 
                                         // Labels with c = 'l' are removed by optimzier if not referenced in block (case jump tables are outside)
@@ -148,7 +159,10 @@ public:
     void setPreviousLevel (TSymbolList *);
     TSymbolList *getPreviousLevel () const;
     
-    using TBaseContainer = std::vector<TSymbol *>;
+    /** routines inlined into the block with number of calls, shown in the listing */
+    void addInlinedCall (const std::string &routineName);
+    const std::map<std::string, std::size_t> &getInlinedCalls () const;
+    
     std::size_t size () const;
     bool empty () const;
     TBaseContainer::iterator begin (), end ();
@@ -156,11 +170,18 @@ public:
     
 private:
     TAddSymbolResult addSymbol (const std::string &name, TType *type, TSymbol::TFlags flags, TSymbol *alias);
+    void appendSymbol (TSymbol *);
+    void removeFromIndex (const TSymbol *);
+    bool contains (const TSymbol *) const;
+    
     TSymbolList *previousLevel;    
     TMemoryPoolFactory &memoryPoolFactory;
     TBaseContainer symbols;    
+    // symbols by name; names without symbols are removed
+    std::unordered_map<std::string, TBaseContainer> index;
     std::size_t parameterSize, localSize, level, tempBlock;
     bool tempPresent;
+    std::map<std::string, std::size_t> inlinedCalls;
 };
 
 // ---
@@ -194,10 +215,6 @@ inline TSymbolList::TBaseContainer::const_iterator TSymbolList::end () const {
 }
 
 
-inline void TSymbol::setName (const std::string &s) {
-    name = s;
-}
-
 inline const std::string &TSymbol::getName () const {
     return name;
 }
@@ -262,6 +279,14 @@ inline bool TSymbol::isAliased () const {
     return aliased || !!alias;
 }
 
+inline void TSymbol::setBorrowed () {
+    borrowed = true;
+}
+
+inline bool TSymbol::isBorrowed () const {
+    return borrowed;
+}
+
 inline void TSymbol::setBlock (TBlock *b) {
     block = b;
 }
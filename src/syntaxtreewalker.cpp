@@ -0,0 +1,268 @@
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+
+namespace statpascal {
+
+void TSyntaxTreeWalker::generateCode (TTypeCast &typeCast) {
+    visit (typeCast.getExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TExpression &expression) {
+    visit (expression.getLeftExpression ());
+    visit (expression.getRightExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TPrefixedExpression &prefixedExpression) {
+    visit (prefixedExpression.getExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TSimpleExpression &simpleExpression) {
+    visit (simpleExpression.getLeftExpression ());
+    visit (simpleExpression.getRightExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TTerm &term) {
+    visit (term.getLeftExpression ());
+    visit (term.getRightExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TFunctionCall &functionCall) {
+    visit (functionCall.getFunction ());
+    for (TExpressionBase *arg: functionCall.getArguments ())
+        visit (arg);
+    visit (functionCall.getReturnStorage ());
+}
+
+void TSyntaxTreeWalker::generateCode (TConstantValue &) {
+}
+
+void TSyntaxTreeWalker::generateCode (TRoutineValue &) {
+}
+
+void TSyntaxTreeWalker::generateCode (TVariable &) {
+}
+
+void TSyntaxTreeWalker::generateCode (TReferenceVariable &) {
+}
+
+void TSyntaxTreeWalker::generateCode (TLValueDereference &lValueDereference) {
+    visit (lValueDereference.getLValue ());
+}
+
+void TSyntaxTreeWalker::generateCode (TArrayIndex &arrayIndex) {
+    visit (arrayIndex.getBaseExpression ());
+    visit (arrayIndex.getIndexExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TRecordComponent &recordComponent) {
+    visit (recordComponent.getExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TPointerDereference &pointerDereference) {
+    visit (pointerDereference.getExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TPredefinedRoutine &predefinedRoutine) {
+    for (TExpressionBase *arg: predefinedRoutine.getArguments ())
+        visit (arg);
+}
+
+void TSyntaxTreeWalker::generateCode (TAssignment &assignment) {
+    visit (assignment.getLValue ());
+    visit (assignment.getExpression ());
+}
+
+void TSyntaxTreeWalker::generateCode (TRoutineCall &routineCall) {
+    visit (routineCall.getRoutineCall ());
+}
+
+void TSyntaxTreeWalker::generateCode (TIfStatement &ifStatement) {
+    visit (ifStatement.getCondition ());
+    visit (ifStatement.getStatement1 ());
+    visit (ifStatement.getStatement2 ());
+}
+
+void TSyntaxTreeWalker::generateCode (TCaseStatement &caseStatement) {
+    visit (caseStatement.getExpression ());
+    for (const TCaseStatement::TCase &c: caseStatement.getCaseList ())
+        visit (c.statement);
+    visit (caseStatement.getDefaultStatement ());
+}
+
+void TSyntaxTreeWalker::generateCode (TStatementSequence &statementSequence) {
+    for (TStatement *statement: statementSequence.getStatements ())
+        visit (statement);
+}
+
+void TSyntaxTreeWalker::generateCode (TLabeledStatement &labeledStatement) {
+    visit (labeledStatement.getStatement ());
+}
+
+void TSyntaxTreeWalker::generateCode (TGotoStatement &gotoStatement) {
+    visit (gotoStatement.getCondition ());
+}
+
+void TSyntaxTreeWalker::generateCode (TBlock &block) {
+    visit (block.getStatements ());
+}
+
+void TSyntaxTreeWalker::generateCode (TUnit &) {
+}
+
+void TSyntaxTreeWalker::generateCode (TProgram &) {
+}
+
+void TSyntaxTreeWalker::alignType (TType *) {
+}
+
+TCodeGenerator::TParameterLocation TSyntaxTreeWalker::classifyType (const TType *) {
+    return TParameterLocation::Stack;
+}
+
+TCodeGenerator::TReturnLocation TSyntaxTreeWalker::classifyReturnType (const TType *) {
+    return TReturnLocation::Reference;
+}
+
+bool TSyntaxTreeWalker::isFunctionCallInlined (TFunctionCall &) {
+    return false;
+}
+
+bool TSyntaxTreeWalker::isReferenceCallerCopy (const TType *) {
+    return false;
+}
+
+
+void TSyntaxTreeRewriter::rewrite (TExpressionBase *&expression) {
+    if (expression) {
+        visit (expression);
+        expression = rewriteExpression (expression);
+    }
+}
+
+void TSyntaxTreeRewriter::rewrite (TStatement *&statement) {
+    if (statement) {
+        visit (statement);
+        statement = rewriteStatement (statement);
+    }
+}
+
+TExpressionBase *TSyntaxTreeRewriter::rewriteExpression (TExpressionBase *expression) {
+    return expression;
+}
+
+TStatement *TSyntaxTreeRewriter::rewriteStatement (TStatement *statement) {
+    return statement;
+}
+
+std::vector<TStatement *> &TSyntaxTreeRewriter::getStatements (TStatementSequence &statementSequence) {
+    return statementSequence.statements;
+}
+
+TExpressionBase *&TSyntaxTreeRewriter::getCondition (TIfStatement &ifStatement) {
+    return ifStatement.condition;
+}
+
+TExpressionBase *&TSyntaxTreeRewriter::getCondition (TGotoStatement &gotoStatement) {
+    return gotoStatement.condition;
+}
+
+TExpressionBase *&TSyntaxTreeRewriter::getExpression (TCaseStatement &caseStatement) {
+    return caseStatement.expression;
+}
+
+void TSyntaxTreeRewriter::generateCode (TTypeCast &typeCast) {
+    rewrite (typeCast.base);
+}
+
+void TSyntaxTreeRewriter::generateCode (TExpression &expression) {
+    rewrite (expression.left);
+    rewrite (expression.right);
+}
+
+void TSyntaxTreeRewriter::generateCode (TPrefixedExpression &prefixedExpression) {
+    rewrite (prefixedExpression.base);
+}
+
+void TSyntaxTreeRewriter::generateCode (TSimpleExpression &simpleExpression) {
+    rewrite (simpleExpression.left);
+    rewrite (simpleExpression.right);
+}
+
+void TSyntaxTreeRewriter::generateCode (TTerm &term) {
+    rewrite (term.left);
+    rewrite (term.right);
+}
+
+void TSyntaxTreeRewriter::generateCode (TFunctionCall &functionCall) {
+    rewrite (functionCall.function);
+    for (TExpressionBase *&arg: functionCall.args)
+        rewrite (arg);
+    rewrite (functionCall.returnStorage);
+}
+
+void TSyntaxTreeRewriter::generateCode (TLValueDereference &lValueDereference) {
+    rewrite (lValueDereference.base);
+}
+
+void TSyntaxTreeRewriter::generateCode (TArrayIndex &arrayIndex) {
+    rewrite (arrayIndex.base);
+    rewrite (arrayIndex.index);
+}
+
+void TSyntaxTreeRewriter::generateCode (TRecordComponent &recordComponent) {
+    rewrite (recordComponent.base);
+}
+
+void TSyntaxTreeRewriter::generateCode (TPointerDereference &pointerDereference) {
+    rewrite (pointerDereference.expr);
+}
+
+void TSyntaxTreeRewriter::generateCode (TPredefinedRoutine &predefinedRoutine) {
+    for (TExpressionBase *&arg: predefinedRoutine.arguments)
+        rewrite (arg);
+}
+
+void TSyntaxTreeRewriter::generateCode (TAssignment &assignment) {
+    rewrite (assignment.lValue);
+    rewrite (assignment.expr);
+}
+
+void TSyntaxTreeRewriter::generateCode (TRoutineCall &routineCall) {
+    rewrite (routineCall.routineCall);
+}
+
+void TSyntaxTreeRewriter::generateCode (TIfStatement &ifStatement) {
+    rewrite (ifStatement.condition);
+    rewrite (ifStatement.statement1);
+    rewrite (ifStatement.statement2);
+}
+
+void TSyntaxTreeRewriter::generateCode (TCaseStatement &caseStatement) {
+    rewrite (caseStatement.expression);
+    for (TCaseStatement::TCase &c: caseStatement.caseList)
+        rewrite (c.statement);
+    rewrite (caseStatement.defaultStatement);
+}
+
+void TSyntaxTreeRewriter::generateCode (TStatementSequence &statementSequence) {
+    for (TStatement *&statement: statementSequence.statements)
+        rewrite (statement);
+}
+
+void TSyntaxTreeRewriter::generateCode (TLabeledStatement &labeledStatement) {
+    rewrite (labeledStatement.statement);
+}
+
+void TSyntaxTreeRewriter::generateCode (TGotoStatement &gotoStatement) {
+    rewrite (gotoStatement.condition);
+}
+
+
+void TSharedExpressionCollector::generateCode (TRecordComponent &recordComponent) {
+    if (visited.insert (recordComponent.getExpression ()).second)
+        inherited::generateCode (recordComponent);
+    else
+        shared.insert (recordComponent.getExpression ());
+}
+
+}
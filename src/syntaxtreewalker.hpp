@@ -0,0 +1,117 @@
+/** \file syntaxtreewalker.hpp
+
+    Visitor traversing the statements and expressions of a routine body. Derived
+    classes override the generateCode methods of the nodes they are interested in
+    and call the inherited method to continue into the children. Nested routines
+    are not entered.
+*/
+
+#pragma once
+
+#include "codegenerator.hpp"
+
+#include <set>
+
+namespace statpascal {
+
+class TSyntaxTreeWalker: public TCodeGenerator {
+using inherited = TCodeGenerator;
+public:
+    virtual ~TSyntaxTreeWalker () = default;
+
+    virtual void generateCode (TTypeCast &) override;
+    virtual void generateCode (TExpression &) override;
+    virtual void generateCode (TPrefixedExpression &) override;
+    virtual void generateCode (TSimpleExpression &) override;
+    virtual void generateCode (TTerm &) override;
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TConstantValue &) override;
+    virtual void generateCode (TRoutineValue &) override;
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TReferenceVariable &) override;
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TPointerDereference &) override;
+
+    virtual void generateCode (TPredefinedRoutine &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TRoutineCall &) override;
+    virtual void generateCode (TIfStatement &) override;
+    virtual void generateCode (TCaseStatement &) override;
+    virtual void generateCode (TStatementSequence &) override;
+    virtual void generateCode (TLabeledStatement &) override;
+    virtual void generateCode (TGotoStatement &) override;
+
+    virtual void generateCode (TBlock &) override;
+    virtual void generateCode (TUnit &) override;
+    virtual void generateCode (TProgram &) override;
+
+    // queries of the target ABI are not answered by a walker
+    virtual void alignType (TType *) override;
+    virtual TParameterLocation classifyType (const TType *) override;
+    virtual TReturnLocation classifyReturnType (const TType *) override;
+    virtual bool isFunctionCallInlined (TFunctionCall &) override;
+    virtual bool isReferenceCallerCopy (const TType *type) override;
+};
+
+/** Walker replacing nodes: the children of a node are rewritten first, then
+    rewriteExpression or rewriteStatement may return a replacement for the node
+    itself. Nodes created by predefined routines are entered but not replaced.
+*/
+
+class TSyntaxTreeRewriter: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    void rewrite (TExpressionBase *&);
+    void rewrite (TStatement *&);
+
+    virtual void generateCode (TTypeCast &) override;
+    virtual void generateCode (TExpression &) override;
+    virtual void generateCode (TPrefixedExpression &) override;
+    virtual void generateCode (TSimpleExpression &) override;
+    virtual void generateCode (TTerm &) override;
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TPointerDereference &) override;
+
+    virtual void generateCode (TPredefinedRoutine &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TRoutineCall &) override;
+    virtual void generateCode (TIfStatement &) override;
+    virtual void generateCode (TCaseStatement &) override;
+    virtual void generateCode (TStatementSequence &) override;
+    virtual void generateCode (TLabeledStatement &) override;
+    virtual void generateCode (TGotoStatement &) override;
+
+protected:
+    // return the node to keep it
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *);
+    virtual TStatement *rewriteStatement (TStatement *);
+
+    static std::vector<TStatement *> &getStatements (TStatementSequence &);
+    // the expressions deciding the branch taken; rewrite them without the nested statements
+    static TExpressionBase *&getCondition (TIfStatement &);
+    static TExpressionBase *&getCondition (TGotoStatement &);
+    static TExpressionBase *&getExpression (TCaseStatement &);
+};
+
+/** Collects the expressions referenced by more than one node: the record of a with-statement
+    is shared by the accesses of its fields. A rewriter replacing parts of an expression by
+    values valid at one place only must not enter them.
+*/
+
+class TSharedExpressionCollector: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    virtual void generateCode (TRecordComponent &) override;
+
+    std::set<const TExpressionBase *> shared;
+
+private:
+    std::set<const TExpressionBase *> visited;
+};
+
+}
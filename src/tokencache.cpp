@@ -0,0 +1,115 @@
+#include "tokencache.hpp"
+#include "config.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <type_traits>
+#include <unistd.h>
+
+namespace statpascal {
+
+namespace {
+
+const char magic [] = "SPTOKEN1";
+
+static_assert (std::is_trivially_copyable<TTokenImage::TTokenRecord>::value);
+
+std::uint64_t hashBytes (std::uint64_t hash, const std::string &s) {
+    // FNV-1a
+    for (unsigned char c: s) {
+        hash ^= c;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+void writeSize (std::ostream &os, std::uint64_t n) {
+    os.write (reinterpret_cast<const char *> (&n), sizeof (n));
+}
+
+bool readSize (std::istream &is, std::uint64_t &n) {
+    return static_cast<bool> (is.read (reinterpret_cast<char *> (&n), sizeof (n)));
+}
+
+}
+
+void TTokenCache::setDirectory (const std::string &directory, const std::string &compilerVersion) {
+    this->directory = directory;
+    this->compilerVersion = compilerVersion + '/' + std::to_string (static_cast<int> (TConfig::target));
+}
+
+bool TTokenCache::isEnabled () const {
+    return !directory.empty ();
+}
+
+std::string TTokenCache::getEntryFilename (const std::string &sourceFilename) const {
+    std::ifstream f (sourceFilename, std::ios::binary);
+    if (!f)
+        return std::string ();
+    std::stringstream buf;
+    buf << f.rdbuf ();
+    const std::uint64_t hash = hashBytes (hashBytes (0xcbf29ce484222325, compilerVersion), buf.str ());
+    char hex [17];
+    snprintf (hex, sizeof (hex), "%016llx", static_cast<unsigned long long> (hash));
+    return directory + '/' + std::filesystem::path (sourceFilename).stem ().string () + '-' + hex + ".spt";
+}
+
+bool TTokenCache::load (const std::string &entryFilename, TTokenImage &image) const {
+    std::ifstream f (entryFilename, std::ios::binary);
+    char header [sizeof (magic)];
+    std::uint64_t versionLength, tokenCount, stringCount;
+    if (!f.read (header, sizeof (header)) || std::string (header, sizeof (header)) != std::string (magic, sizeof (magic)) || !readSize (f, versionLength))
+        return false;
+    std::string version (versionLength, ' ');
+    if (!f.read (version.data (), versionLength) || version != compilerVersion || !readSize (f, tokenCount) || !readSize (f, stringCount))
+        return false;
+    image.tokens.resize (tokenCount);
+    if (!f.read (reinterpret_cast<char *> (image.tokens.data ()), tokenCount * sizeof (TTokenImage::TTokenRecord)))
+        return false;
+    image.strings.resize (stringCount);
+    for (std::string &s: image.strings) {
+        std::uint64_t length;
+        if (!readSize (f, length))
+            return false;
+        s.resize (length);
+        if (!f.read (s.data (), length))
+            return false;
+    }
+    for (const TTokenImage::TTokenRecord &record: image.tokens)
+        if (record.string >= stringCount || record.identifier >= stringCount)
+            return false;
+    return true;
+}
+
+// concurrent compiler runs may write the same entry: it is renamed into place when complete
+
+void TTokenCache::save (const std::string &entryFilename, const TTokenImage &image) const {
+    std::error_code ec;
+    std::filesystem::create_directories (directory, ec);
+    const std::string tempFilename = entryFilename + '.' + std::to_string (getpid ());
+    {
+        std::ofstream f (tempFilename, std::ios::binary);
+        f.write (magic, sizeof (magic));
+        writeSize (f, compilerVersion.length ());
+        f.write (compilerVersion.data (), compilerVersion.length ());
+        writeSize (f, image.tokens.size ());
+        writeSize (f, image.strings.size ());
+        f.write (reinterpret_cast<const char *> (image.tokens.data ()), image.tokens.size () * sizeof (TTokenImage::TTokenRecord));
+        for (const std::string &s: image.strings) {
+            writeSize (f, s.length ());
+            f.write (s.data (), s.length ());
+        }
+        if (!f) {
+            f.close ();
+            std::filesystem::remove (tempFilename, ec);
+            return;
+        }
+    }
+    std::filesystem::rename (tempFilename, entryFilename, ec);
+    if (ec)
+        std::filesystem::remove (tempFilename, ec);
+}
+
+}
@@ -0,0 +1,34 @@
+/** \file tokencache.hpp
+
+    Cache of the token images of units: it saves lexing only, the interface of a unit
+    is parsed on each run. An entry is keyed by the source of the unit, the compiler
+    version and the target; a unit which was changed or a new compiler build leads to
+    a different entry, so stale entries are never read.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "lexer.hpp"
+
+namespace statpascal {
+
+class TTokenCache final {
+public:
+    /** caching is disabled while no directory is set */
+    void setDirectory (const std::string &directory, const std::string &compilerVersion);
+    bool isEnabled () const;
+    
+    /** returns the name of the cache entry for the source file; empty if the source cannot be read */
+    std::string getEntryFilename (const std::string &sourceFilename) const;
+    
+    bool load (const std::string &entryFilename, TTokenImage &) const;
+    /** errors are ignored as the cache is optional */
+    void save (const std::string &entryFilename, const TTokenImage &) const;
+    
+private:
+    std::string directory, compilerVersion;
+};
+
+}
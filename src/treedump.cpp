@@ -0,0 +1,343 @@
+#include "treedump.hpp"
+#include "syntaxtreewalker.hpp"
+#include "compilerimpl.hpp"
+#include "predefined.hpp"
+
+#include <ostream>
+#include <map>
+
+namespace statpascal {
+
+namespace {
+
+const std::size_t indentSize = 4;
+
+const std::string &getOperationName (TToken operation) {
+    static const std::map<TToken, std::string> names {
+        {TToken::In, "in"}, {TToken::And, "and"}, {TToken::Or, "or"}, {TToken::Xor, "xor"}, {TToken::Not, "not "},
+        {TToken::Shl, "shl"}, {TToken::Shr, "shr"}, {TToken::DivInt, "div"}, {TToken::Mod, "mod"},
+        {TToken::Add, "+"}, {TToken::Sub, "-"}, {TToken::Mul, "*"}, {TToken::Div, "/"},
+        {TToken::Equal, "="}, {TToken::GreaterThan, ">"}, {TToken::LessThan, "<"},
+        {TToken::GreaterEqual, ">="}, {TToken::LessEqual, "<="}, {TToken::NotEqual, "<>"}
+    };
+    static const std::string unknown = "?";
+    std::map<TToken, std::string>::const_iterator it = names.find (operation);
+    return it == names.end () ? unknown : it->second;
+}
+
+const std::string &getPredefinedName (TPredefinedRoutine::TRoutine routine) {
+    static const std::map<TPredefinedRoutine::TRoutine, std::string> names {
+        {TPredefinedRoutine::Odd, "odd"}, {TPredefinedRoutine::Succ, "succ"}, {TPredefinedRoutine::Pred, "pred"},
+        {TPredefinedRoutine::Inc, "inc"}, {TPredefinedRoutine::Dec, "dec"}, {TPredefinedRoutine::Exit, "exit"}
+    };
+    return names.at (routine);
+}
+
+// statements are written on lines of their own, expressions within the line of their statement
+
+class TTreePrinter: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    explicit TTreePrinter (std::ostream &);
+
+    void print (TBlock &);
+
+    virtual void generateCode (TTypeCast &) override;
+    virtual void generateCode (TExpression &) override;
+    virtual void generateCode (TPrefixedExpression &) override;
+    virtual void generateCode (TSimpleExpression &) override;
+    virtual void generateCode (TTerm &) override;
+    virtual void generateCode (TFunctionCall &) override;
+    virtual void generateCode (TConstantValue &) override;
+    virtual void generateCode (TRoutineValue &) override;
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TReferenceVariable &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TPointerDereference &) override;
+
+    virtual void generateCode (TPredefinedRoutine &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TRoutineCall &) override;
+    virtual void generateCode (TIfStatement &) override;
+    virtual void generateCode (TCaseStatement &) override;
+    virtual void generateCode (TLabeledStatement &) override;
+    virtual void generateCode (TGotoStatement &) override;
+
+private:
+    void printOperation (TExpressionBase *left, TExpressionBase *right, TToken operation);
+    void printArguments (const std::vector<TExpressionBase *> &);
+    void printIndented (TStatement *);
+    std::ostream &beginLine ();
+    void beginStatement (bool callsSeparated);
+    void endStatement ();
+    bool beginPart ();
+    std::string getLabelName (const TSymbol *);
+
+    std::ostream &os;
+    std::size_t indent;
+    // predefined routines like write are lowered to several calls and assignments
+    // which are written on the line of their statement, separated by semicolons
+    bool inStatement, separated;
+    std::size_t parts;
+    // labels created by the compiler share their names
+    std::map<const TSymbol *, std::size_t> labels;
+};
+
+TTreePrinter::TTreePrinter (std::ostream &os):
+  os (os), indent (0), inStatement (false), separated (false), parts (0) {
+}
+
+void TTreePrinter::print (TBlock &block) {
+    if (const TSymbol *s = block.getSymbol ())
+        os << "routine " << s->getName ();
+    else
+        os << "program";
+    os << ", level " << block.getSymbols ().getLevel () << std::endl;
+    labels.clear ();
+    printIndented (block.getStatements ());
+    os << std::endl;
+}
+
+std::ostream &TTreePrinter::beginLine () {
+    return os << std::string (indent, ' ');
+}
+
+void TTreePrinter::beginStatement (bool callsSeparated) {
+    beginLine ();
+    inStatement = true;
+    separated = callsSeparated;
+    parts = 0;
+}
+
+void TTreePrinter::endStatement () {
+    inStatement = separated = false;
+}
+
+// returns true if a call or assignment is a part of its own
+
+bool TTreePrinter::beginPart () {
+    if (!separated)
+        return false;
+    if (parts++)
+        os << "; ";
+    separated = false;
+    return true;
+}
+
+std::string TTreePrinter::getLabelName (const TSymbol *label) {
+    if (label->getName ().compare (0, 2, "__"))
+        return label->getName ();
+    return label->getName () + std::to_string (labels.try_emplace (label, labels.size () + 1).first->second);
+}
+
+void TTreePrinter::printIndented (TStatement *statement) {
+    indent += indentSize;
+    visit (statement);
+    indent -= indentSize;
+}
+
+void TTreePrinter::printOperation (TExpressionBase *left, TExpressionBase *right, TToken operation) {
+    os << '(';
+    if (left) {
+        visit (left);
+        os << ' ' << getOperationName (operation) << ' ';
+    } else
+        os << getOperationName (operation);
+    visit (right);
+    os << ')';
+}
+
+void TTreePrinter::printArguments (const std::vector<TExpressionBase *> &args) {
+    os << " (";
+    for (std::size_t i = 0; i < args.size (); ++i) {
+        if (i)
+            os << ", ";
+        visit (args [i]);
+    }
+    os << ')';
+}
+
+void TTreePrinter::generateCode (TTypeCast &typeCast) {
+    const std::string &name = typeCast.getType ()->getName ();
+    os << (name.empty () ? "cast" : name) << " (";
+    visit (typeCast.getExpression ());
+    os << ')';
+}
+
+void TTreePrinter::generateCode (TExpression &expression) {
+    printOperation (expression.getLeftExpression (), expression.getRightExpression (), expression.getOperation ());
+}
+
+void TTreePrinter::generateCode (TPrefixedExpression &prefixedExpression) {
+    printOperation (nullptr, prefixedExpression.getExpression (), prefixedExpression.getOperation ());
+}
+
+void TTreePrinter::generateCode (TSimpleExpression &simpleExpression) {
+    printOperation (simpleExpression.getLeftExpression (), simpleExpression.getRightExpression (), simpleExpression.getOperation ());
+}
+
+void TTreePrinter::generateCode (TTerm &term) {
+    printOperation (term.getLeftExpression (), term.getRightExpression (), term.getOperation ());
+}
+
+void TTreePrinter::generateCode (TFunctionCall &functionCall) {
+    const bool part = beginPart ();
+    visit (functionCall.getFunction ());
+    printArguments (functionCall.getArguments ());
+    separated = part;
+}
+
+void TTreePrinter::generateCode (TConstantValue &constantValue) {
+    const TSimpleConstant *constant = constantValue.getConstant ();
+    const TType *type = constantValue.getType ();
+    if (!constant)
+        os << "const";
+    else if (type == &stdType.Boolean)
+        os << (constant->getInteger () ? "true" : "false");
+    else if (type == &stdType.Char)
+        os << '#' << static_cast<int> (constant->getChar ());
+    else if (type->isEnumerated () || type->isPointer ())
+        os << constant->getInteger ();
+    else if (type->isReal () || type->isSingle ())
+        os << constant->getDouble ();
+    else if (type->isString () || type->isShortString ())
+        os << '\'' << constant->getString () << '\'';
+    else if (type->isRoutine () && constant->getRoutineValue ())
+        visit (constant->getRoutineValue ());
+    else
+        os << "const";
+}
+
+void TTreePrinter::generateCode (TRoutineValue &routineValue) {
+    os << (routineValue.getSymbol () ? routineValue.getSymbol ()->getName () : "?");
+}
+
+void TTreePrinter::generateCode (TVariable &variable) {
+    os << variable.getSymbol ()->getName ();
+}
+
+void TTreePrinter::generateCode (TReferenceVariable &referenceVariable) {
+    os << referenceVariable.getSymbol ()->getName ();
+}
+
+void TTreePrinter::generateCode (TArrayIndex &arrayIndex) {
+    visit (arrayIndex.getBaseExpression ());
+    os << " [";
+    visit (arrayIndex.getIndexExpression ());
+    os << ']';
+}
+
+void TTreePrinter::generateCode (TRecordComponent &recordComponent) {
+    visit (recordComponent.getExpression ());
+    os << '.' << recordComponent.getComponent ();
+}
+
+void TTreePrinter::generateCode (TPointerDereference &pointerDereference) {
+    visit (pointerDereference.getExpression ());
+    os << '^';
+}
+
+void TTreePrinter::generateCode (TPredefinedRoutine &predefinedRoutine) {
+    os << getPredefinedName (predefinedRoutine.getRoutine ());
+    if (!predefinedRoutine.getArguments ().empty ())
+        printArguments (predefinedRoutine.getArguments ());
+}
+
+void TTreePrinter::generateCode (TAssignment &assignment) {
+    if (inStatement) {
+        const bool part = beginPart ();
+        visit (assignment.getLValue ());
+        os << " := ";
+        visit (assignment.getExpression ());
+        separated = part;
+    } else {
+        beginStatement (false);
+        visit (assignment.getLValue ());
+        os << " := ";
+        visit (assignment.getExpression ());
+        endStatement ();
+        os << std::endl;
+    }
+}
+
+void TTreePrinter::generateCode (TRoutineCall &routineCall) {
+    beginStatement (true);
+    visit (routineCall.getRoutineCall ());
+    endStatement ();
+    os << std::endl;
+}
+
+void TTreePrinter::generateCode (TIfStatement &ifStatement) {
+    beginStatement (false);
+    os << "if ";
+    visit (ifStatement.getCondition ());
+    endStatement ();
+    os << " then" << std::endl;
+    printIndented (ifStatement.getStatement1 ());
+    if (ifStatement.getStatement2 ()) {
+        beginLine () << "else" << std::endl;
+        printIndented (ifStatement.getStatement2 ());
+    }
+}
+
+void TTreePrinter::generateCode (TCaseStatement &caseStatement) {
+    beginStatement (false);
+    os << "case ";
+    visit (caseStatement.getExpression ());
+    endStatement ();
+    os << " of" << std::endl;
+    indent += indentSize;
+    for (const TCaseStatement::TCase &c: caseStatement.getCaseList ()) {
+        beginLine ();
+        for (std::size_t i = 0; i < c.labels.size (); ++i) {
+            os << (i ? ", " : "") << c.labels [i].a;
+            if (c.labels [i].b != c.labels [i].a)
+                os << ".." << c.labels [i].b;
+        }
+        os << ':' << std::endl;
+        printIndented (c.statement);
+    }
+    if (caseStatement.getDefaultStatement ()) {
+        beginLine () << "else" << std::endl;
+        printIndented (caseStatement.getDefaultStatement ());
+    }
+    indent -= indentSize;
+    beginLine () << "end" << std::endl;
+}
+
+void TTreePrinter::generateCode (TLabeledStatement &labeledStatement) {
+    os << std::string (indent - std::min (indent, indentSize), ' ') << getLabelName (labeledStatement.getLabel ()) << ':' << std::endl;
+    visit (labeledStatement.getStatement ());
+}
+
+void TTreePrinter::generateCode (TGotoStatement &gotoStatement) {
+    beginStatement (false);
+    if (gotoStatement.getCondition ()) {
+        os << "if ";
+        visit (gotoStatement.getCondition ());
+        os << ' ';
+    }
+    endStatement ();
+    os << "goto " << getLabelName (gotoStatement.getLabel ()) << std::endl;
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ()) {
+            blocks.push_back (s->getBlock ());
+            collectBlocks (*s->getBlock (), blocks);
+        }
+}
+
+}
+
+void TTreeDump::dump (TBlock &programBlock, std::ostream &os) {
+    std::vector<TBlock *> blocks {&programBlock};
+    collectBlocks (programBlock, blocks);
+    TTreePrinter printer (os);
+    for (TBlock *block: blocks)
+        printer.print (*block);
+}
+
+}
@@ -0,0 +1,24 @@
+/** \file treedump.hpp
+
+    Writes the syntax tree passed to the code generators in a Pascal like notation,
+    after all optimizations of the tree. Loops are shown as the labels and conditional
+    gotos they are lowered to; temporary variables have the names given by the pass
+    creating them. The tree is the same for all targets except for the folding of real
+    arithmetic and the size of integers.
+*/
+
+#pragma once
+
+#include <iosfwd>
+
+namespace statpascal {
+
+class TBlock;
+
+class TTreeDump final {
+public:
+    /** writes the program block and all routines */
+    static void dump (TBlock &programBlock, std::ostream &);
+};
+
+}
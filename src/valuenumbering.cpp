@@ -0,0 +1,422 @@
+#include "valuenumbering.hpp"
+#include "syntaxtreewalker.hpp"
+#include "expressionkey.hpp"
+#include "compilerimpl.hpp"
+#include "predefined.hpp"
+#include "config.hpp"
+
+#include <map>
+#include <set>
+
+namespace statpascal {
+
+namespace {
+
+const std::size_t minOperations = 2;
+
+class TCallFinder: public TSyntaxTreeWalker {
+public:
+    virtual void generateCode (TFunctionCall &) override;
+
+    bool hasCalls = false;
+};
+
+void TCallFinder::generateCode (TFunctionCall &) {
+    hasCalls = true;
+}
+
+std::size_t countOperations (TExpressionBase *expression) {
+    if (TSimpleExpression *simpleExpression = dynamic_cast<TSimpleExpression *> (expression))
+        return 1 + countOperations (simpleExpression->getLeftExpression ()) + countOperations (simpleExpression->getRightExpression ());
+    if (TTerm *term = dynamic_cast<TTerm *> (expression))
+        return 1 + countOperations (term->getLeftExpression ()) + countOperations (term->getRightExpression ());
+    if (TPrefixedExpression *prefixedExpression = dynamic_cast<TPrefixedExpression *> (expression))
+        return 1 + countOperations (prefixedExpression->getExpression ());
+    if (TTypeCast *typeCast = dynamic_cast<TTypeCast *> (expression))
+        return countOperations (typeCast->getExpression ());
+    return 0;
+}
+
+// the variable containing an array element or record component
+
+TExpressionBase *getBaseVariable (TExpressionBase *lValue) {
+    for (;;)
+        if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (lValue))
+            lValue = arrayIndex->getBaseExpression ();
+        else if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (lValue))
+            lValue = recordComponent->getExpression ();
+        else
+            return lValue;
+}
+
+// Variables with an address used other than to load or store them or one of their components
+// (e.g. with addr or as var argument): a store to them may change loads through pointers.
+
+class TAddressFinder: public TSyntaxTreeWalker {
+using inherited = TSyntaxTreeWalker;
+public:
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TAssignment &) override;
+    virtual void generateCode (TVariable &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+
+    std::set<const TSymbol *> exposed;
+
+private:
+    void addAccess (TExpressionBase *lValue);
+    void checkExposed (TExpressionBase *lValue);
+
+    std::set<const TExpressionBase *> accessed;
+};
+
+void TAddressFinder::generateCode (TLValueDereference &lValueDereference) {
+    addAccess (lValueDereference.getLValue ());
+    inherited::generateCode (lValueDereference);
+}
+
+void TAddressFinder::generateCode (TAssignment &assignment) {
+    addAccess (assignment.getLValue ());
+    inherited::generateCode (assignment);
+}
+
+void TAddressFinder::generateCode (TVariable &variable) {
+    checkExposed (&variable);
+    inherited::generateCode (variable);
+}
+
+void TAddressFinder::generateCode (TArrayIndex &arrayIndex) {
+    checkExposed (&arrayIndex);
+    inherited::generateCode (arrayIndex);
+}
+
+void TAddressFinder::generateCode (TRecordComponent &recordComponent) {
+    checkExposed (&recordComponent);
+    inherited::generateCode (recordComponent);
+}
+
+void TAddressFinder::addAccess (TExpressionBase *lValue) {
+    for (;;) {
+        accessed.insert (lValue);
+        if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (lValue))
+            lValue = arrayIndex->getBaseExpression ();
+        else if (TRecordComponent *recordComponent = dynamic_cast<TRecordComponent *> (lValue))
+            lValue = recordComponent->getExpression ();
+        else
+            return;
+    }
+}
+
+void TAddressFinder::checkExposed (TExpressionBase *lValue) {
+    if (!accessed.count (lValue)) {
+        TExpressionBase *base = getBaseVariable (lValue);
+        if (base->isSymbol ())
+            exposed.insert (static_cast<TVariable *> (base)->getSymbol ());
+    }
+}
+
+// The right operand of a short-circuit boolean operation may not be evaluated; a load moved
+// out of it might fail.
+
+bool isShortCircuit (TExpressionBase *expression, TToken operation) {
+    return expression->getType () == &stdType.Boolean && (operation == TToken::And || operation == TToken::Or);
+}
+
+
+// The expressions of a basic block are visited twice with the same keys: the first pass counts
+// them, the second replaces those occurring more than once. The children of a repeated
+// expression are counted for its first occurrence only.
+
+class TBlockRewriter: public TSyntaxTreeRewriter, public TExpressionKey {
+using inherited = TSyntaxTreeRewriter;
+public:
+    TBlockRewriter (TBlock &block);
+
+    void optimize ();
+
+    virtual void generateCode (TSimpleExpression &) override;
+    virtual void generateCode (TTerm &) override;
+    virtual void generateCode (TPrefixedExpression &) override;
+    virtual void generateCode (TLValueDereference &) override;
+    virtual void generateCode (TArrayIndex &) override;
+    virtual void generateCode (TRecordComponent &) override;
+    virtual void generateCode (TPointerDereference &) override;
+    virtual void generateCode (TStatementSequence &) override;
+
+protected:
+    virtual TExpressionBase *rewriteExpression (TExpressionBase *) override;
+    virtual std::string getVariableKey (const TSymbol *) override;
+    virtual std::string getLoadKey (TExpressionBase *) override;
+
+private:
+    void optimizeBlock (std::vector<TStatement *> &, std::size_t begin, std::size_t end);
+    bool isBlockStatement (TStatement *);
+    TExpressionBase *getAssignedVariable (TStatement *);
+    void visitStatement (TStatement *&);
+    bool isPrivate (const TSymbol *) const;
+
+    std::string getKey (TExpressionBase *);
+    bool isFirstOccurrence (TExpressionBase *);
+    TVariable *createVariable (TSymbol *);
+
+    enum class TPass { None, Count, Rewrite };
+
+    TBlock &block;
+    TSharedExpressionCollector sharedExpressions;
+    TAddressFinder addressFinder;
+    TPass pass;
+    std::map<const TSymbol *, std::size_t> versions;
+    std::size_t memoryVersion;
+    std::map<std::string, std::size_t> occurrences;
+    std::map<const TExpressionBase *, std::string> keys;
+    std::map<std::string, TSymbol *> temporaries;
+    std::vector<TStatement *> definitions;
+};
+
+TBlockRewriter::TBlockRewriter (TBlock &block):
+  block (block), pass (TPass::None), memoryVersion (0) {
+}
+
+void TBlockRewriter::optimize () {
+    TStatement *statements = block.getStatements ();
+    sharedExpressions.visit (statements);
+    addressFinder.visit (statements);
+    rewrite (statements);
+}
+
+// Nested statements are optimized before the basic blocks of the sequence. The blocks are
+// optimized from the last one as definitions are inserted.
+
+void TBlockRewriter::generateCode (TStatementSequence &statementSequence) {
+    inherited::generateCode (statementSequence);
+
+    std::vector<TStatement *> &statements = getStatements (statementSequence);
+    std::vector<std::pair<std::size_t, std::size_t>> blocks;
+    std::size_t begin = 0;
+    for (std::size_t pos = 0; pos < statements.size (); ++pos)
+        if (!isBlockStatement (statements [pos])) {
+            blocks.push_back ({begin, pos});
+            begin = pos + 1;
+        } else if (pos > begin && dynamic_cast<TLabeledStatement *> (statements [pos])) {
+            blocks.push_back ({begin, pos});
+            begin = pos;
+        }
+    blocks.push_back ({begin, statements.size ()});
+    for (std::vector<std::pair<std::size_t, std::size_t>>::reverse_iterator it = blocks.rbegin (); it != blocks.rend (); ++it)
+        if (it->first < it->second)
+            optimizeBlock (statements, it->first, it->second);
+}
+
+void TBlockRewriter::generateCode (TSimpleExpression &simpleExpression) {
+    if (!isShortCircuit (&simpleExpression, simpleExpression.getOperation ()) && isFirstOccurrence (&simpleExpression))
+        inherited::generateCode (simpleExpression);
+}
+
+void TBlockRewriter::generateCode (TTerm &term) {
+    if (!isShortCircuit (&term, term.getOperation ()) && isFirstOccurrence (&term))
+        inherited::generateCode (term);
+}
+
+void TBlockRewriter::generateCode (TPrefixedExpression &prefixedExpression) {
+    if (isFirstOccurrence (&prefixedExpression))
+        inherited::generateCode (prefixedExpression);
+}
+
+void TBlockRewriter::generateCode (TLValueDereference &lValueDereference) {
+    if (isFirstOccurrence (&lValueDereference))
+        inherited::generateCode (lValueDereference);
+}
+
+// The record of a with-statement is shared by the accesses of its fields: it is replaced
+// as a whole but not entered.
+
+void TBlockRewriter::generateCode (TArrayIndex &arrayIndex) {
+    if (isFirstOccurrence (&arrayIndex) && !sharedExpressions.shared.count (&arrayIndex))
+        inherited::generateCode (arrayIndex);
+}
+
+void TBlockRewriter::generateCode (TRecordComponent &recordComponent) {
+    if (!sharedExpressions.shared.count (&recordComponent))
+        inherited::generateCode (recordComponent);
+}
+
+void TBlockRewriter::generateCode (TPointerDereference &pointerDereference) {
+    if (!sharedExpressions.shared.count (&pointerDereference))
+        inherited::generateCode (pointerDereference);
+}
+
+TExpressionBase *TBlockRewriter::rewriteExpression (TExpressionBase *expression) {
+    std::map<const TExpressionBase *, std::string>::iterator it = keys.find (expression);
+    if (pass != TPass::Rewrite || it == keys.end ())
+        return expression;
+
+    TCompilerImpl &compiler = block.getCompiler ();
+    TSymbol *&temporary = temporaries [it->second];
+    if (!temporary) {
+        TSymbolList &symbols = block.getSymbols ();
+        const std::string name = "$cse" + std::to_string (symbols.size ());
+        if (expression->isLValue ()) {
+            TType *pointerType = compiler.createMemoryPoolObject<TPointerType> (expression->getType ());
+            temporary = symbols.addVariable (name, pointerType).symbol;
+            definitions.push_back (compiler.createMemoryPoolObject<TAssignment> (createVariable (temporary), compiler.createMemoryPoolObject<TTypeCast> (pointerType, expression)));
+        } else {
+            temporary = symbols.addVariable (name, expression->getType ()).symbol;
+            definitions.push_back (compiler.createMemoryPoolObject<TAssignment> (createVariable (temporary), expression));
+        }
+    }
+    if (expression->isLValue ())
+        return compiler.createMemoryPoolObject<TPointerDereference> (createVariable (temporary));
+    return compiler.createMemoryPoolObject<TLValueDereference> (createVariable (temporary));
+}
+
+// A variable keeps its value until it is assigned. Variables other than local ones whose
+// address is not taken may also be changed through a pointer or var parameter.
+
+std::string TBlockRewriter::getVariableKey (const TSymbol *s) {
+    if (!(s->checkSymbolFlag (TSymbol::Variable) || s->checkSymbolFlag (TSymbol::Parameter)) ||
+        s->checkSymbolFlag (TSymbol::Alias) || s->checkSymbolFlag (TSymbol::Absolute) || !isScalarType (s->getType ()))
+        return std::string ();
+    const std::string key = getSymbolKey ('s', s) + '@' + std::to_string (versions [s]);
+    return isPrivate (s) ? key : key + '@' + std::to_string (memoryVersion);
+}
+
+// An element is valid until its array is assigned or a store may change memory accessed
+// through a pointer or var parameter (see visitStatement).
+
+std::string TBlockRewriter::getLoadKey (TExpressionBase *lValue) {
+    const std::string key = getAddressKey (lValue);
+    if (key.empty ())
+        return key;
+    TExpressionBase *base = getBaseVariable (lValue);
+    if (base->isSymbol () && !base->isReference ())
+        return key + '@' + std::to_string (versions [static_cast<TVariable *> (base)->getSymbol ()]) + '@' + std::to_string (memoryVersion);
+    return key + '@' + std::to_string (memoryVersion);
+}
+
+bool TBlockRewriter::isPrivate (const TSymbol *s) const {
+    return s->getLevel () == block.getSymbols ().getLevel () && !s->isAliased () && !addressFinder.exposed.count (s) &&
+        !s->checkSymbolFlag (TSymbol::Alias) && !s->checkSymbolFlag (TSymbol::Absolute);
+}
+
+void TBlockRewriter::optimizeBlock (std::vector<TStatement *> &statements, std::size_t begin, std::size_t end) {
+    occurrences.clear ();
+    versions.clear ();
+    memoryVersion = 0;
+    pass = TPass::Count;
+    for (std::size_t pos = begin; pos < end; ++pos)
+        visitStatement (statements [pos]);
+
+    keys.clear ();
+    temporaries.clear ();
+    versions.clear ();
+    memoryVersion = 0;
+    pass = TPass::Rewrite;
+    std::vector<TStatement *> result;
+    for (std::size_t pos = begin; pos < end; ++pos) {
+        TStatement *statement = statements [pos];
+        visitStatement (statement);
+        if (TLabeledStatement *labeledStatement = dynamic_cast<TLabeledStatement *> (statement); labeledStatement && !definitions.empty ()) {
+            // the temporaries are set after the label
+            TCompilerImpl &compiler = block.getCompiler ();
+            definitions.push_back (labeledStatement->getStatement ());
+            statement = compiler.createMemoryPoolObject<TLabeledStatement> (labeledStatement->getLabel (), compiler.createMemoryPoolObject<TStatementSequence> (std::move (definitions)));
+        } else
+            result.insert (result.end (), definitions.begin (), definitions.end ());
+        definitions.clear ();
+        result.push_back (statement);
+    }
+    pass = TPass::None;
+    keys.clear ();
+    statements.erase (statements.begin () + begin, statements.begin () + end);
+    statements.insert (statements.begin () + begin, result.begin (), result.end ());
+}
+
+// an assignment or increment without calls, possibly labeled
+
+bool TBlockRewriter::isBlockStatement (TStatement *statement) {
+    if (TLabeledStatement *labeledStatement = dynamic_cast<TLabeledStatement *> (statement))
+        statement = labeledStatement->getStatement ();
+    if (!getAssignedVariable (statement))
+        return false;
+    TCallFinder callFinder;
+    callFinder.visit (statement);
+    return !callFinder.hasCalls;
+}
+
+TExpressionBase *TBlockRewriter::getAssignedVariable (TStatement *statement) {
+    if (TLabeledStatement *labeledStatement = dynamic_cast<TLabeledStatement *> (statement))
+        statement = labeledStatement->getStatement ();
+    TExpressionBase *lValue = nullptr;
+    if (TAssignment *assignment = dynamic_cast<TAssignment *> (statement))
+        lValue = assignment->getLValue ();
+    else if (TRoutineCall *routineCall = dynamic_cast<TRoutineCall *> (statement))
+        if (TPredefinedRoutine *predefinedRoutine = dynamic_cast<TPredefinedRoutine *> (routineCall->getRoutineCall ()))
+            if (predefinedRoutine->getRoutine () == TPredefinedRoutine::Inc || predefinedRoutine->getRoutine () == TPredefinedRoutine::Dec)
+                lValue = predefinedRoutine->getArguments () [0];
+    return lValue ? getBaseVariable (lValue) : nullptr;
+}
+
+// The assigned variable is determined before the statement is rewritten: the assignment
+// to an array element may become one through a pointer. Only stores to private variables
+// cannot change memory seen through pointers or var parameters.
+
+void TBlockRewriter::visitStatement (TStatement *&statement) {
+    TExpressionBase *lValue = getAssignedVariable (statement);
+    rewrite (statement);
+    if (lValue->isSymbol () && !lValue->isReference ()) {
+        const TSymbol *s = static_cast<TVariable *> (lValue)->getSymbol ();
+        ++versions [s];
+        if (!isPrivate (s))
+            ++memoryVersion;
+    } else
+        ++memoryVersion;
+}
+
+std::string TBlockRewriter::getKey (TExpressionBase *expression) {
+    if (TArrayIndex *arrayIndex = dynamic_cast<TArrayIndex *> (expression))
+        // the conversion of a string to a pointer gives its characters
+        return arrayIndex->getType () != &stdType.String && getAddressCost (arrayIndex) >= 2 ? getAddressKey (arrayIndex) : std::string ();
+    if (expression->isLValueDereference ()) {
+        TExpressionBase *lValue = static_cast<TLValueDereference *> (expression)->getLValue ();
+        return !lValue->isSymbol () && getAddressCost (lValue) ? getValueKey (expression) : std::string ();
+    }
+    return countOperations (expression) >= minOperations ? getValueKey (expression) : std::string ();
+}
+
+bool TBlockRewriter::isFirstOccurrence (TExpressionBase *expression) {
+    if (pass == TPass::None)
+        return true;
+    const std::string key = getKey (expression);
+    if (key.empty ())
+        return true;
+    if (pass == TPass::Count)
+        return occurrences [key]++ == 0;
+    if (occurrences [key] < 2)
+        return true;
+    keys [expression] = key;
+    return !temporaries.count (key);
+}
+
+TVariable *TBlockRewriter::createVariable (TSymbol *s) {
+    return block.getCompiler ().createMemoryPoolObject<TVariable> (s, block);
+}
+
+void collectBlocks (TBlock &block, std::vector<TBlock *> &blocks) {
+    blocks.push_back (&block);
+    for (TSymbol *s: block.getSymbols ())
+        if (s->checkSymbolFlag (TSymbol::Routine) && !s->checkSymbolFlag (TSymbol::External) && s->getBlock ())
+            collectBlocks (*s->getBlock (), blocks);
+}
+
+}
+
+void TValueNumbering::optimize (TBlock &programBlock) {
+    if (!TConfig::optimizeCommonSubexpressions)
+        return;
+    std::vector<TBlock *> blocks;
+    collectBlocks (programBlock, blocks);
+    for (TBlock *block: blocks)
+        TBlockRewriter (*block).optimize ();
+}
+
+}
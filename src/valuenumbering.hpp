@@ -0,0 +1,28 @@
+/** \file valuenumbering.hpp
+
+    Evaluates repeated expressions of a basic block once. A basic block is a sequence
+    of assignments and increments without calls; a labeled statement starts a new one.
+    An integer or real expression with at least two operations, an array element with an
+    index not constant or the address of an array element needing more than a scaled
+    index is computed into a temporary variable before the statement using it first if
+    it occurs again with the same value.
+
+    The value of a variable is valid until it is assigned. An assignment through a
+    pointer or var parameter invalidates all array elements and all variables except
+    local ones whose address is not taken. The right operands of short-circuit boolean
+    operations are not entered.
+*/
+
+#pragma once
+
+namespace statpascal {
+
+class TBlock;
+
+class TValueNumbering final {
+public:
+    /** optimizes the program block and all routines */
+    static void optimize (TBlock &programBlock);
+};
+
+}
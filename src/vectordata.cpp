@@ -1,11 +1,22 @@
 #include "vectordata.hpp"
 #include "anymanager.hpp"
+#include "anyvalue.hpp"
 
 namespace statpascal {
 
 TVectorData::TVectorData (const TVectorData &other):
-  size (other.size), count (other.count), anyManager (other.anyManager) {
-    data = static_cast<char *> (operator new (size * count));
+  TVectorData (other.arena ? nullptr : operator new (other.getStorageSize ()), other) {
+    ownsData = true;
+}
+
+TVectorData::TVectorData (void *storage, const TVectorData &other):
+  size (other.size), count (other.count), anyManager (other.anyManager), arena (nullptr), data (nullptr), ownsData (false) {
+    if (other.arena) {
+        arena = new TStringArena (*other.arena);
+        ownsData = true;
+        return;
+    }
+    data = static_cast<char *> (storage);
     if (anyManager)
         for (std::size_t i = 0; i < count; ++i)
             setElement (i, &other.get<unsigned char> (i));
@@ -13,13 +24,57 @@ TVectorData::TVectorData (const TVectorData &other):
         memcpy (data, other.data, size * count);
 }
 
+TVectorData::TVectorData (TVectorData &&other):
+  size (other.size), count (other.count), anyManager (other.anyManager), arena (other.arena), data (other.data), ownsData (true) {
+    if (!other.ownsData) {
+        data = static_cast<char *> (operator new (size * count));
+        memcpy (data, other.data, size * count);
+    } else
+        other.data = nullptr;
+    // element values now belong to this vector
+    other.arena = nullptr;
+    other.count = 0;
+}
+
 void TVectorData::setElement (std::size_t index, const void *src) {
+    if (arena)
+        materialize ();
     char *dest = &data [index * size];
     std::memcpy (dest, src, size);
     if (anyManager)
         anyManager->copy (src, dest);
 }
 
+void TVectorData::copyElement (std::size_t index, const TVectorData &src, std::size_t srcIndex) {
+    if (src.arena) {
+        const std::string_view s = src.getString (srcIndex);
+        const TAnyValue value = s.empty () ? TAnyValue () : TAnyValue (std::string (s));
+        setElement (index, &value);
+    } else
+        setElement (index, src.getElement (srcIndex));
+}
+
+std::string_view TVectorData::getString (std::size_t index) const {
+    if (arena)
+        return (*arena) [index];
+    return reinterpret_cast<const TAnyValue *> (&data [index * size])->getString ();
+}
+
+void TVectorData::materialize () const {
+    if (arena) {
+        data = static_cast<char *> (operator new (size * count));
+        ownsData = true;
+        std::fill (data, data + size * count, 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::string_view s = (*arena) [i];
+            if (!s.empty ())
+                new (&data [i * size]) TAnyValue (std::string (s));
+        }
+        delete arena;
+        arena = nullptr;
+    }
+}
+
 void TVectorData::deleteData () {
     if (anyManager)        
         for (std::size_t i = 0; i < count; ++i)
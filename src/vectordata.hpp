@@ -8,21 +8,66 @@
 #include <cstdlib>
 #include <new>
 #include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "anyvalue.hpp"
 
 namespace statpascal {
 
 class TAnyManager;
 
+/** Contiguous storage for the elements of a string vector: element i occupies
+    chars [offsets [i] .. offsets [i + 1]). */
+
+class TStringArena {
+public:
+    TStringArena ();
+    
+    void reserve (std::size_t count, std::size_t length);
+    void append (std::string_view);
+    
+    /** replaces the contents with elements of the given lengths to be filled via getBuffer */
+    void assignLengths (const std::vector<std::size_t> &lengths);
+    char *getBuffer (std::size_t index);
+    
+    std::size_t size () const;
+    std::size_t length () const;
+    std::string_view operator [] (std::size_t index) const;
+    
+private:
+    std::string chars;
+    std::vector<std::size_t> offsets;
+};
+
 class TVectorData {
 public:
     TVectorData (std::size_t elementSize, std::size_t elementCount, TAnyManager *elementAnyManager = nullptr, bool zeroMemory = true);
     
+    /** creates a string vector held in an arena. The elements are converted to individual
+        string values when they are accessed by getElement/setElement. */
+    TVectorData (TStringArena &&, TAnyManager *elementAnyManager);
+    
+    /** constructors using storage provided by the caller (see create) */
+    TVectorData (void *storage, std::size_t elementSize, std::size_t elementCount, TAnyManager *elementAnyManager, bool zeroMemory);
+    TVectorData (void *storage, const TVectorData &);
+    
     TVectorData (const TVectorData &);
+    TVectorData (TVectorData &&);
     ~TVectorData ();
     
+    /** creates a vector value with the elements stored in the same allocation */
+    static TAnyValue create (std::size_t elementSize, std::size_t elementCount, TAnyManager *elementAnyManager = nullptr, bool zeroMemory = true);
+    
+    /** size of the storage required by the constructors above */
+    std::size_t getStorageSize () const;
+    
     TVectorData &operator = (TVectorData) = delete;
     
     void setElement (std::size_t index, const void *src);
+    /** sets the element to the element srcIndex of src in either representation */
+    void copyElement (std::size_t index, const TVectorData &src, std::size_t srcIndex);
     const void *getElement (std::size_t index) const;
     void *getElement (std::size_t index);
     
@@ -32,27 +77,98 @@ public:
     TAnyManager *getElementAnyManager () const;
     std::size_t getElementSize () const;
     std::size_t getElementCount () const;
+    
+    bool isStringArena () const;
+    const TStringArena &getStringArena () const;
+    
+    /** element of a string vector in either representation */
+    std::string_view getString (std::size_t index) const;
+    
+    /** converts arena storage to individual string values; this does not change the
+        elements and is therefore also done for const access */
+    void materialize () const;
 
 private:
     void deleteData ();
 
     std::size_t size, count;
     TAnyManager *anyManager;
-    char *data;
+    mutable TStringArena *arena;
+    mutable char *data;
+    mutable bool ownsData;
 };
 
 
+inline TStringArena::TStringArena ():
+  offsets (1, 0) {
+}
+
+inline void TStringArena::reserve (std::size_t count, std::size_t length) {
+    offsets.reserve (count + 1);
+    chars.reserve (length);
+}
+
+inline void TStringArena::append (std::string_view s) {
+    chars.append (s);
+    offsets.push_back (chars.length ());
+}
+
+inline void TStringArena::assignLengths (const std::vector<std::size_t> &lengths) {
+    offsets.resize (lengths.size () + 1);
+    for (std::size_t i = 0; i < lengths.size (); ++i)
+        offsets [i + 1] = offsets [i] + lengths [i];
+    chars.resize (offsets.back ());
+}
+
+inline char *TStringArena::getBuffer (std::size_t index) {
+    return chars.data () + offsets [index];
+}
+
+inline std::size_t TStringArena::size () const {
+    return offsets.size () - 1;
+}
+
+inline std::size_t TStringArena::length () const {
+    return chars.length ();
+}
+
+inline std::string_view TStringArena::operator [] (std::size_t index) const {
+    return std::string_view (chars.data () + offsets [index], offsets [index + 1] - offsets [index]);
+}
+
+
 inline TVectorData::TVectorData (std::size_t size, std::size_t count, TAnyManager *anyManager, bool zeroMemory):
-  size (size), count (count), anyManager (anyManager) {
+  size (size), count (count), anyManager (anyManager), arena (nullptr), ownsData (true) {
     data = static_cast<char *> (operator new (size * count));
     if (zeroMemory)
         std::fill (data, data + size * count, 0);
 }
 
+inline TVectorData::TVectorData (TStringArena &&stringArena, TAnyManager *anyManager):
+  size (sizeof (void *)), count (stringArena.size ()), anyManager (anyManager), arena (new TStringArena (std::move (stringArena))), data (nullptr), ownsData (true) {
+}
+
+inline TVectorData::TVectorData (void *storage, std::size_t size, std::size_t count, TAnyManager *anyManager, bool zeroMemory):
+  size (size), count (count), anyManager (anyManager), arena (nullptr), data (static_cast<char *> (storage)), ownsData (false) {
+    if (zeroMemory)
+        std::fill (data, data + size * count, 0);
+}
+
 inline TVectorData::~TVectorData () {
-    if (anyManager)
+    if (arena)
+        delete arena;
+    else if (anyManager)
         deleteData ();
-    operator delete (data);
+    if (ownsData)
+        operator delete (data);
+}
+
+inline TAnyValue TVectorData::create (std::size_t size, std::size_t count, TAnyManager *anyManager, bool zeroMemory) {
+    return TAnyValue::createWithStorage<TVectorData> (size * count, size, count, anyManager, zeroMemory);
+}
+
+inline std::size_t TVectorData::getStorageSize () const {
+    return arena ? 0 : size * count;
 }
 
 inline TAnyManager *TVectorData::getElementAnyManager () const {
@@ -67,11 +183,23 @@ inline std::size_t TVectorData::getElementCount () const {
     return count;
 }
 
+inline bool TVectorData::isStringArena () const {
+    return !!arena;
+}
+
+inline const TStringArena &TVectorData::getStringArena () const {
+    return *arena;
+}
+
 inline const void *TVectorData::getElement (std::size_t index) const {
+    if (arena)
+        materialize ();
     return &data [index * size];
 }
 
 inline void *TVectorData::getElement (std::size_t index) {
+    if (arena)
+        materialize ();
     return &data [index * size];
 }
 
@@ -80,7 +208,7 @@ template<typename T> inline const T &TVectorData::get (std::size_t index) const
 }
 
 template<typename T> inline T &TVectorData::get (std::size_t index) {
-    return const_cast<T &> (static_cast<const TVectorData *> (this)->get<T> (index));
+    return *static_cast<T *> (getElement (index));
 }
 
 }
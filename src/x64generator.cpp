@@ -1,5 +1,6 @@
 #include "x64generator.hpp"
 #include "runtime.hpp"
+#include "borrowanalysis.hpp"
 
 #include <dlfcn.h>
 #include <unistd.h>
@@ -9,6 +10,8 @@
 #include <algorithm>
 #include <limits>
 #include <iostream>
+#include <atomic>
+#include <thread>
 
 /*
 
@@ -79,7 +82,12 @@ TX64Generator::TX64Generator (TRuntimeData &runtimeData, bool codeRangeCheck, bo
   currentLevel (0),
   intStackCount (0),
   xmmStackCount (0),
-  dblConstCount (0) {
+  dblConstCount (0),
+  codegenThreads (0) {
+}
+
+void TX64Generator::setCodegenThreads (std::size_t n) {
+    codegenThreads = n;
 }
 
 bool TX64Generator::isCalleeSavedReg (const TX64Reg reg) {
@@ -776,6 +784,21 @@ void TX64Generator::getAssemblerCode (std::vector<std::uint8_t> &opcodes, bool g
         assemblePass (pass, opcodes, generateListing, listing);
 }
 
+std::vector<THeapProfile::TRoutineLabel> TX64Generator::getRoutineLabels () const {
+    std::vector<THeapProfile::TRoutineLabel> result;
+    for (const std::string &name: routineNames) {
+        std::unordered_map<std::string, std::size_t>::const_iterator it = relLabelDefinitions.find (name);
+        if (it != relLabelDefinitions.end ())
+            result.push_back ({it->second, name});
+    }
+    for (const TAnyRoutine &routine: anyRoutines) {
+        std::unordered_map<std::string, std::size_t>::const_iterator it = relLabelDefinitions.find (routine.label);
+        if (it != relLabelDefinitions.end ())
+            result.push_back ({it->second, routine.label});
+    }
+    return result;
+}
+
 void TX64Generator::setOutput (TCodeSequence *output) {
     currentOutput = output;
 }
@@ -800,15 +823,14 @@ void TX64Generator::outputComment (const std::string &s) {
     outputCode (TX64Operation (TX64Op::comment, TX64Operand (), TX64Operand (), s));
 }
 
-void TX64Generator::outputLocalJumpTables () {
-    if (!jumpTableDefinitions.empty ()) {
-        outputComment ("jump tables for case statements");
-        for (const TJumpTable &it: jumpTableDefinitions) {
-            outputLabel (it.tableLabel);
+void TX64Generator::outputLocalJumpTables (const std::vector<TJumpTable> &jumpTables, TCodeSequence &code) {
+    if (!jumpTables.empty ()) {
+        code.emplace_back (TX64Op::comment, TX64Operand (), TX64Operand (), "jump tables for case statements");
+        for (const TJumpTable &it: jumpTables) {
+            code.emplace_back (TX64Op::def_label, it.tableLabel);
             for (const std::string &s: it.jumpLabels)
-                outputCode (TX64Op::data_diff_dq, (s.empty () ? it.defaultLabel : s), it.tableLabel);
+                code.emplace_back (TX64Op::data_diff_dq, (s.empty () ? it.defaultLabel : s), it.tableLabel);
         }
-        jumpTableDefinitions.clear ();
     }
 }
 
@@ -1569,6 +1591,96 @@ void TX64Generator::codeRuntimeCall (const std::string &funcname, const TX64Reg
     outputCode (TX64Op::call, TX64Reg::rax);
 }
 
+std::string TX64Generator::lookupAnyRoutine (const TType *type, TAnyRoutineKind kind) {
+    const std::pair<const TType *, TAnyRoutineKind> key (type, kind);
+    std::map<std::pair<const TType *, TAnyRoutineKind>, std::string>::iterator it = anyRoutineLabels.find (key);
+    if (it != anyRoutineLabels.end ())
+        return it->second;
+    TAnySlots slots;
+    collectAnySlots (type, 0, slots);
+    return anyRoutineLabels [key] = slots.specialized ? createAnyRoutine (kind, type->getSize (), std::move (slots)) : std::string ();
+}
+
+std::string TX64Generator::createAnyRoutine (TAnyRoutineKind kind, std::size_t size, TAnySlots &&slots) {
+    const std::string label = "$any_" + std::to_string (anyRoutines.size ());
+    anyRoutines.push_back ({label, kind, size, std::move (slots)});
+    return label;
+}
+
+// copy: rdi = uninitialized destination, rsi = source; assign: rdi = destination, rsi = source;
+// destroy: rdi = base address
+
+void TX64Generator::outputAnyRoutines () {
+    const std::size_t counterOffset = TAnyValue::getCounterOffset ();
+    for (const TAnyRoutine &routine: anyRoutines) {
+        outputLabel (routine.label);
+        for (TX64Reg reg: {TX64Reg::rbx, TX64Reg::r12, TX64Reg::r13, TX64Reg::r14, TX64Reg::r15})
+            outputCode (TX64Op::push, reg);
+        outputCode (TX64Op::mov, TX64Reg::rbx, TX64Reg::rdi);
+        outputCode (TX64Op::mov, TX64Reg::r12, TX64Reg::rsi);
+        outputCode (TX64Op::mov, TX64Reg::r13, reinterpret_cast<std::int64_t> (TAnyValue::getThreadSafeFlag ()));
+        // references of the source are taken before those of the destination are dropped for self assignment
+        if (routine.kind != TAnyRoutineKind::Destroy)
+            codeAnySlots (routine.slots, TX64Reg::r12, true, counterOffset);
+        if (routine.kind != TAnyRoutineKind::Copy)
+            codeAnySlots (routine.slots, TX64Reg::rbx, false, counterOffset);
+        if (routine.kind != TAnyRoutineKind::Destroy) {
+            outputCode (TX64Op::mov, TX64Reg::rdi, TX64Reg::rbx);
+            outputCode (TX64Op::mov, TX64Reg::rsi, TX64Reg::r12);
+            outputCode (TX64Op::mov, TX64Reg::rcx, routine.size);
+            outputCode (TX64Op::rep_movsb);
+        }
+        for (TX64Reg reg: {TX64Reg::r15, TX64Reg::r14, TX64Reg::r13, TX64Reg::r12, TX64Reg::rbx})
+            outputCode (TX64Op::pop, reg);
+        outputCode (TX64Op::ret);
+    }
+}
+
+void TX64Generator::codeAnySlots (const TAnySlots &slots, TX64Reg base, bool retain, std::size_t counterOffset) {
+    for (ssize_t offset: slots.offsets)
+        codeAnySlot (TX64Operand (base, offset, TX64OpSize::bit64), retain, counterOffset);
+    for (const TAnySlots::TLoop &loop: slots.loops) {
+        const std::string next = getNextLocalLabel ();
+        outputCode (TX64Op::lea, TX64Reg::r14, TX64Operand (base, loop.offset));
+        outputCode (TX64Op::mov, TX64Reg::r15, loop.count);
+        outputLabel (next);
+        for (ssize_t offset: loop.offsets)
+            codeAnySlot (TX64Operand (TX64Reg::r14, offset, TX64OpSize::bit64), retain, counterOffset);
+        outputCode (TX64Op::add, TX64Reg::r14, loop.size);
+        outputCode (TX64Op::dec, TX64Reg::r15);
+        outputCode (TX64Op::jne, next);
+    }
+}
+
+// nil and inline strings (bit 0 set) are not counted; r13 points to the thread safety flag
+
+void TX64Generator::codeAnySlot (const TX64Operand &slot, bool retain, std::size_t counterOffset) {
+    const std::string slowPath = getNextLocalLabel (), done = getNextLocalLabel ();
+    outputCode (TX64Op::mov, TX64Reg::rax, slot);
+    outputCode (TX64Op::test, TX64Reg::rax, TX64Reg::rax);
+    outputCode (TX64Op::je, done);
+    outputCode (TX64Op::test, TX64Operand (TX64Reg::rax, TX64OpSize::bit8), 1);
+    outputCode (TX64Op::jne, done);
+    outputCode (TX64Op::cmp, TX64Operand (TX64Reg::r13, 0, TX64OpSize::bit8), 0);
+    outputCode (TX64Op::jne, slowPath);
+    if (retain) {
+        outputCode (TX64Op::inc, TX64Operand (TX64Reg::rax, counterOffset, TX64OpSize::bit64));
+        outputCode (TX64Op::jmp, done);
+    } else {
+        outputCode (TX64Op::dec, TX64Operand (TX64Reg::rax, counterOffset, TX64OpSize::bit64));
+        outputCode (TX64Op::jne, done);
+        outputCode (TX64Op::mov, TX64Reg::rdi, TX64Reg::rax);
+        outputCode (TX64Op::mov, TX64Reg::rax, std::string ("rt_any_delete"));
+        outputCode (TX64Op::call, TX64Reg::rax);
+        outputCode (TX64Op::jmp, done);
+    }
+    outputLabel (slowPath);
+    outputCode (TX64Op::mov, TX64Reg::rdi, TX64Reg::rax);
+    outputCode (TX64Op::mov, TX64Reg::rax, std::string (retain ? "rt_any_retain" : "rt_any_release"));
+    outputCode (TX64Op::call, TX64Reg::rax);
+    outputLabel (done);
+}
+
 void TX64Generator::codePush (const TX64Operand op) {
     stackPositions += 8;
     outputCode (TX64Op::push, op);
@@ -1921,9 +2033,13 @@ void TX64Generator::generateCode (TAssignment &assignment) {
         TTypeAnyManager typeAnyManager = lookupAnyManager (type);
         loadReg (TX64Reg::rdi);
         loadReg (TX64Reg::rsi);
-        if (typeAnyManager.anyManager)
-            codeRuntimeCall ("rt_copy_mem", TX64Reg::r9, {{TX64Reg::rdx, type->getSize ()}, {TX64Reg::rcx, typeAnyManager.runtimeIndex}, {TX64Reg::r8, 1}});
-        else 
+        if (typeAnyManager.anyManager) {
+            const std::string routine = lookupAnyRoutine (type, TAnyRoutineKind::Assign);
+            if (!routine.empty ())
+                outputCode (TX64Op::call, TX64Operand (routine));
+            else
+                codeRuntimeCall ("rt_copy_mem", TX64Reg::r9, {{TX64Reg::rdx, type->getSize ()}, {TX64Reg::rcx, typeAnyManager.runtimeIndex}, {TX64Reg::r8, 1}});
+        } else 
             codeMove (type->getSize ());
     }
 }
@@ -2067,9 +2183,12 @@ void TX64Generator::generateCode (TProgram &program) {
     globalRuntimeDataSymbol = globalSymbols.searchSymbol ("__globalruntimedata");
     
     // TODO: error if not found !!!!
+    TBorrowAnalysis::analyze (*program.getBlock ());
     generateBlock (*program.getBlock ());
+    finishRoutines ();
     
     setOutput (&this->program);
+    outputAnyRoutines ();
     outputGlobalConstants ();
 //    std::cout << "Data size is: " << globalSymbols.getLocalSize () << std::endl;
     
@@ -2099,63 +2218,28 @@ void TX64Generator::externalRoutine (TSymbol &s) {
     outputLabelDefinition (s.getExtSymbolName (), reinterpret_cast<std::uint64_t> (f));
 }
 
-void TX64Generator::beginRoutineBody (const std::string &routineName, std::size_t level, TSymbolList &symbolList, const std::set<TX64Reg> &saveRegs, bool hasStackFrame) {
-    if (level > 1) {    
-        outputComment (std::string ());
-        for (const std::string &s: createSymbolList (routineName, level, symbolList, x64RegName))
-            outputComment (s);
-        outputComment (std::string ());
-    }
-    
-//    outputCode (TX64Op::aligncode);
-    if (!routineName.empty ())
-        outputLabel (routineName);
+void TX64Generator::beginRoutineBody (TRoutineCode &code, TSymbolList &symbolList) {
+    if (code.level > 1)
+        code.symbolComments = createSymbolList (code.name, code.level, symbolList, x64RegName);
+    else
+        code.symbolComments = createInlinedList (symbolList);
     
-    if (hasStackFrame) {    
-        codePush (TX64Reg::rbp);
-        if (level > 2)
-            outputCode (TX64Op::mov, TX64Reg::rax, TX64Reg::rbp);
-        outputCode (TX64Op::mov, TX64Reg::rbp, TX64Reg::rsp);
-        
-        std::size_t offsetRequired = level > 1 ? symbolList.getLocalSize () : 0;
-        if (level > 1) {
-            for (std::size_t i = 1; i < level - 1; ++i)
-                codePush (TX64Operand (TX64Reg::rax, -8 * i, TX64OpSize::bit64));
-            codePush (TX64Reg::rbp);
+    code.localSize = symbolList.getLocalSize ();
+    code.zeroCount = 0;
+    if (code.hasStackFrame && code.level > 1 && code.localSize) 
+        if (TAnyManager *anyManager = buildAnyManager (symbolList)) {
+            runtimeData.registerAnyManager (anyManager);
+            code.zeroCount = code.localSize / 8;
+            if (code.zeroCount > 3)
+                code.zeroStackLabel = getNextLocalLabel ();
         }
-        if ((stackPositions + 8 * saveRegs.size () + offsetRequired) % 16 == 0)
-            offsetRequired += 8;
-        if (offsetRequired)
-            codeModifySP (-offsetRequired);
-        if (level > 1 && symbolList.getLocalSize ()) 
-            if (TAnyManager *anyManager = buildAnyManager (symbolList)) {
-            
-                const ssize_t count = symbolList.getLocalSize () / 8;
-                const ssize_t localOffset = 8 * (count + level - 1);	
-                // TODO: get this from the symbol table
-            
-                runtimeData.registerAnyManager (anyManager);
-                
-                if (count > 3) {
-                    outputCode (TX64Op::mov, TX64Reg::rax, count);
-                    const std::string zeroStackLabel = getNextLocalLabel ();
-                    outputLabel (zeroStackLabel);
-                    outputCode (TX64Op::dec, TX64Reg::rax);
-                    outputCode (TX64Op::mov, TX64Operand (TX64Reg::rbp, TX64Reg::rax, 8, -localOffset, TX64OpSize::bit64), 0);
-                    outputCode (TX64Op::jne, zeroStackLabel);
-                } else {
-                    for (ssize_t i = 0; i < count; ++i)
-                        outputCode (TX64Op::mov, TX64Operand (TX64Reg::rbp, -(localOffset  - 8 * i), TX64OpSize::bit64), 0);
-                }
-            } 
-    }
     
-    for (TX64Reg reg: saveRegs)
-        codePush (reg);
+    setOutput (&code.parameterCode);
     
     struct TDeepCopy {
         ssize_t stackOffset;
-        std::size_t size, runtimeIndex;
+        const TType *type;
+        bool borrowed;
     };
     std::vector<TDeepCopy> deepCopies;
     
@@ -2183,7 +2267,7 @@ void TX64Generator::beginRoutineBody (const std::string &routineName, std::size_
                 }
             } else if (classifyType (type) == TParameterLocation::ObjectByValue) {
                 // TODO: das kopiert einen Return-Value erstmal auf sich selbst !!!!
-                deepCopies.push_back ({s->getOffset (), type->getSize (), lookupAnyManager (type).runtimeIndex});
+                deepCopies.push_back ({s->getOffset (), type, s->isBorrowed ()});
                 if (intCount < intParaRegs)
                     outputCode (TX64Op::mov, TX64Operand (TX64Reg::rbp, s->getOffset ()), intParaReg [intCount++]);
                 else {
@@ -2195,32 +2279,95 @@ void TX64Generator::beginRoutineBody (const std::string &routineName, std::size_
             }
         }            
     for (const TDeepCopy &deepCopy: deepCopies) {
+        if (deepCopy.borrowed) {
+            // take the caller's value without counting the reference
+            outputCode (TX64Op::mov, TX64Reg::rax, TX64Operand (TX64Reg::rbp, deepCopy.stackOffset));
+            outputCode (TX64Op::mov, TX64Reg::rax, TX64Operand (TX64Reg::rax, 0));
+            outputCode (TX64Op::mov, TX64Operand (TX64Reg::rbp, deepCopy.stackOffset), TX64Reg::rax);
+            continue;
+        }
         outputCode (TX64Op::lea, TX64Reg::rdi, TX64Operand (TX64Reg::rbp, deepCopy.stackOffset));
         outputCode (TX64Op::mov, TX64Reg::rsi, TX64Operand (TX64Reg::rdi, 0));
-        codeRuntimeCall ("rt_copy_mem", TX64Reg::r9, {{TX64Reg::rdx, deepCopy.size}, {TX64Reg::rcx, deepCopy.runtimeIndex}, {TX64Reg::r8, 0}});
+        const std::string routine = lookupAnyRoutine (deepCopy.type, TAnyRoutineKind::Copy);
+        if (!routine.empty ())
+            outputCode (TX64Op::call, TX64Operand (routine));
+        else
+            codeRuntimeCall ("rt_copy_mem", TX64Reg::r9, {{TX64Reg::rdx, deepCopy.type->getSize ()}, {TX64Reg::rcx, lookupAnyManager (deepCopy.type).runtimeIndex}, {TX64Reg::r8, 0}});
     }
 }
 
+// the stack frame depends on the callee saved registers used by the optimized routine
+
+void TX64Generator::codeStackFrame (const TRoutineCode &code, const std::set<TX64Reg> &saveRegs, TCodeSequence &prologue) {
+    if (!code.symbolComments.empty ()) {    
+        prologue.emplace_back (TX64Op::comment);
+        for (const std::string &s: code.symbolComments)
+            prologue.emplace_back (TX64Op::comment, TX64Operand (), TX64Operand (), s);
+        prologue.emplace_back (TX64Op::comment);
+    }
+    
+    if (!code.name.empty ())
+        prologue.emplace_back (TX64Op::def_label, code.name);
+    
+    if (code.hasStackFrame) {    
+        std::size_t stackPositions = 8;
+        prologue.emplace_back (TX64Op::push, TX64Reg::rbp);
+        if (code.level > 2)
+            prologue.emplace_back (TX64Op::mov, TX64Reg::rax, TX64Reg::rbp);
+        prologue.emplace_back (TX64Op::mov, TX64Reg::rbp, TX64Reg::rsp);
+        
+        std::size_t offsetRequired = code.level > 1 ? code.localSize : 0;
+        if (code.level > 1) {
+            for (std::size_t i = 1; i < code.level - 1; ++i)
+                prologue.emplace_back (TX64Op::push, TX64Operand (TX64Reg::rax, -8 * i, TX64OpSize::bit64));
+            prologue.emplace_back (TX64Op::push, TX64Reg::rbp);
+            stackPositions += 8 * (code.level - 1);
+        }
+        if ((stackPositions + 8 * saveRegs.size () + offsetRequired) % 16 == 0)
+            offsetRequired += 8;
+        if (offsetRequired)
+            prologue.emplace_back (TX64Op::sub, TX64Reg::rsp, static_cast<ssize_t> (offsetRequired));
+        if (code.zeroCount) {
+            const ssize_t count = code.zeroCount;
+            const ssize_t localOffset = 8 * (count + code.level - 1);	
+            // TODO: get this from the symbol table
+            if (count > 3) {
+                prologue.emplace_back (TX64Op::mov, TX64Reg::rax, count);
+                prologue.emplace_back (TX64Op::def_label, code.zeroStackLabel);
+                prologue.emplace_back (TX64Op::dec, TX64Reg::rax);
+                prologue.emplace_back (TX64Op::mov, TX64Operand (TX64Reg::rbp, TX64Reg::rax, 8, -localOffset, TX64OpSize::bit64), 0);
+                prologue.emplace_back (TX64Op::jne, code.zeroStackLabel);
+            } else {
+                for (ssize_t i = 0; i < count; ++i)
+                    prologue.emplace_back (TX64Op::mov, TX64Operand (TX64Reg::rbp, -(localOffset  - 8 * i), TX64OpSize::bit64), 0);
+            }
+        } 
+    }
+    
+    for (TX64Reg reg: saveRegs)
+        prologue.emplace_back (TX64Op::push, reg);
+}
+
 #define USE_LEAVE
 
-void TX64Generator::endRoutineBody (std::size_t level, TSymbolList &symbolList, const std::set<TX64Reg> &saveRegs, bool hasStackFrame) {
+void TX64Generator::endRoutineBody (const TRoutineCode &code, const std::set<TX64Reg> &saveRegs, TCodeSequence &epilogue) {
     std::size_t regCount = 0;
-    if (hasStackFrame)
+    if (code.hasStackFrame)
         for (TX64Reg reg: saveRegs)
-            outputCode (TX64Op::mov, reg, TX64Operand (TX64Reg::rsp, 8 * (saveRegs.size () - 1 - regCount++)));
+            epilogue.emplace_back (TX64Op::mov, reg, TX64Operand (TX64Reg::rsp, 8 * (saveRegs.size () - 1 - regCount++)));
     else
         for (std::set<TX64Reg>::reverse_iterator it = saveRegs.rbegin (); it != saveRegs.rend (); ++it)
-            outputCode (TX64Op::pop, *it);
+            epilogue.emplace_back (TX64Op::pop, *it);
 
-    if (hasStackFrame) {
+    if (code.hasStackFrame) {
         #ifdef USE_LEAVE    
-            outputCode (TX64Op::leave);
+            epilogue.emplace_back (TX64Op::leave);
         #else
-            outputCode (TX64Op::mov, TX64Reg::rsp, TX64Reg::rbp);
-            outputCode (TX64Op::pop, TX64Reg::rbp);
+            epilogue.emplace_back (TX64Op::mov, TX64Reg::rsp, TX64Reg::rbp);
+            epilogue.emplace_back (TX64Op::pop, TX64Reg::rbp);
         #endif
     }
-    outputCode (TX64Op::ret);
+    epilogue.emplace_back (TX64Op::ret);
 }
 
 TCodeGenerator::TParameterLocation TX64Generator::classifyType (const TType *type) {
@@ -2337,11 +2484,14 @@ void TX64Generator::assignRegisters (TSymbolList &blockSymbols) {
         }
 }
 
-void TX64Generator::codeBlock (TBlock &block, bool hasStackFrame, TCodeSequence &blockStatements) {
+TX64Generator::TRoutineCode TX64Generator::codeBlock (TBlock &block, bool hasStackFrame) {
     TSymbolList &blockSymbols = block.getSymbols ();
     const std::size_t level = blockSymbols.getLevel ();
     
-    TCodeSequence blockPrologue, blockEpilogue, blockCode, globalInits;
+    TRoutineCode code;
+    code.name = block.getSymbol ()->getName ();
+    code.level = level;
+    code.hasStackFrame = hasStackFrame;
 
     stackPositions = 0;
     intStackCount = 0;
@@ -2349,24 +2499,28 @@ void TX64Generator::codeBlock (TBlock &block, bool hasStackFrame, TCodeSequence
     currentLevel =  blockSymbols.getLevel ();
     endOfRoutineLabel = getNextLocalLabel ();
 
-    setOutput (&globalInits);
+    setOutput (&code.globalInits);
     if (blockSymbols.getLevel () == 1) {
         assignGlobals (blockSymbols);
         initStaticGlobals (blockSymbols);
     }
     
-    setOutput (&blockCode);
+    setOutput (&code.blockCode);
     
-    if (!globalInits.empty ()) 
+    if (!code.globalInits.empty ()) 
         outputCode (TX64Op::call, TX64Operand ("$init_static"));
     visit (block.getStatements ());
     
     outputLabel (endOfRoutineLabel);
     if (level > 1) {
-        if (TAnyManager *anyManager = buildAnyManager (blockSymbols)) {
-            std::size_t index = registerAnyManager (anyManager);
+        TAnySlots slots;
+        collectAnySlots (blockSymbols, 0, slots);
+        if (!slots.offsets.empty () || !slots.loops.empty ()) {
             outputCode (TX64Op::mov, TX64Reg::rdi, TX64Reg::rbp);
-            codeRuntimeCall ("rt_destroy_mem", TX64Reg::rdx, {{TX64Reg::rsi, index}});
+            if (slots.specialized)
+                outputCode (TX64Op::call, TX64Operand (createAnyRoutine (TAnyRoutineKind::Destroy, 0, std::move (slots))));
+            else if (TAnyManager *anyManager = buildAnyManager (blockSymbols)) 
+                codeRuntimeCall ("rt_destroy_mem", TX64Reg::rdx, {{TX64Reg::rsi, registerAnyManager (anyManager)}});
         }
         if (TExpressionBase *returnLValueDeref = block.returnLValueDeref) {
             visit (returnLValueDeref);
@@ -2380,7 +2534,16 @@ void TX64Generator::codeBlock (TBlock &block, bool hasStackFrame, TCodeSequence
     }
     // TODO: destory global variables !!!!
     
-//    logOptimizer = block.getSymbol ()->getName () == "gettapeinput_$182";
+    beginRoutineBody (code, blockSymbols);
+    code.jumpTables = std::move (jumpTableDefinitions);
+    jumpTableDefinitions.clear ();
+    return code;
+}
+
+void TX64Generator::finishRoutine (TRoutineCode &code, TCodeSequence &result) {
+    TCodeSequence &blockCode = code.blockCode;
+    
+//    logOptimizer = code.name == "gettapeinput_$182";
     
     removeUnusedLocalLabels (blockCode);
     optimizePeepHole (blockCode);
@@ -2395,30 +2558,48 @@ void TX64Generator::codeBlock (TBlock &block, bool hasStackFrame, TCodeSequence
             saveRegs.insert (op.operand2.reg);
     }
     
-    stackPositions = 0;    
-    
-    setOutput (&blockPrologue);    
-    beginRoutineBody (block.getSymbol ()->getName (), blockSymbols.getLevel (), blockSymbols, saveRegs, hasStackFrame);
+    TCodeSequence blockPrologue, blockEpilogue;
+    codeStackFrame (code, saveRegs, blockPrologue);
+    blockPrologue.splice (blockPrologue.end (), code.parameterCode);
     optimizePeepHole (blockPrologue);
     
-    setOutput (&blockEpilogue);
-    endRoutineBody (blockSymbols.getLevel (), blockSymbols, saveRegs, hasStackFrame);
+    endRoutineBody (code, saveRegs, blockEpilogue);
     optimizePeepHole (blockEpilogue);
-    outputLocalJumpTables ();
+    outputLocalJumpTables (code.jumpTables, blockEpilogue);
     
-    if (!globalInits.empty ()) {
-        optimizePeepHole (globalInits);
-        outputLabel ("$init_static");
-        std::move (globalInits.begin (), globalInits.end (), std::back_inserter (blockEpilogue));
-        outputCode (TX64Op::ret);
+    if (!code.globalInits.empty ()) {
+        optimizePeepHole (code.globalInits);
+        blockEpilogue.emplace_back (TX64Op::def_label, TX64Operand ("$init_static"));
+        blockEpilogue.splice (blockEpilogue.end (), code.globalInits);
+        blockEpilogue.emplace_back (TX64Op::ret);
     }
     
-    blockStatements.clear ();    
-//    blockStatements.reserve (blockPrologue.size () + blockCode.size () + blockEpilogue.size ());
-    std::move (blockPrologue.begin (), blockPrologue.end (), std::back_inserter (blockStatements));
-    std::move (blockCode.begin (), blockCode.end (), std::back_inserter (blockStatements));
-    std::move (blockEpilogue.begin (), blockEpilogue.end (), std::back_inserter (blockStatements));
+    result.clear ();
+    result.splice (result.end (), blockPrologue);
+    result.splice (result.end (), blockCode);
+    result.splice (result.end (), blockEpilogue);
+    trySingleReplacements (result);
+}
+
+void TX64Generator::finishRoutines () {
+    std::vector<TCodeSequence> results (routineCode.size ());
+    std::atomic<std::size_t> next = 0;
+    const auto worker = [this, &results, &next] () {
+        for (std::size_t i = next++; i < routineCode.size (); i = next++)
+            finishRoutine (routineCode [i], results [i]);
+    };
     
+    const std::size_t threadCount = std::min (codegenThreads ? codegenThreads : std::max<std::size_t> (std::thread::hardware_concurrency (), 1), routineCode.size ());
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back (worker);
+    worker ();
+    for (std::thread &thread: threads)
+        thread.join ();
+        
+    for (TCodeSequence &code: results)
+        program.splice (program.end (), code);
+    routineCode.clear ();
 }
 
 void TX64Generator::generateBlock (TBlock &block) {
@@ -2426,26 +2607,27 @@ void TX64Generator::generateBlock (TBlock &block) {
 
     TSymbolList &blockSymbols = block.getSymbols ();
     makeUniqueLabelNames (blockSymbols);
-    TCodeSequence blockStatements;
+    routineNames.push_back (block.getSymbol ()->getName ());
     
     assignStackOffsets (block);
     clearRegsUsed ();
-    codeBlock (block, true, blockStatements);
+    TRoutineCode code = codeBlock (block, true);
     if (blockSymbols.getLevel () > 1) {
-        bool functionCalled = std::find_if (blockStatements.begin (), blockStatements.end (), [] (const TX64Operation &op) { return op.operation == TX64Op::call; }) != blockStatements.end ();
+        // the peep hole optimizer keeps all calls
+        const auto isCall = [] (const TX64Operation &op) { return op.operation == TX64Op::call; };
+        bool functionCalled = std::find_if (code.blockCode.begin (), code.blockCode.end (), isCall) != code.blockCode.end () ||
+                              std::find_if (code.parameterCode.begin (), code.parameterCode.end (), isCall) != code.parameterCode.end ();
         if (!functionCalled) {
             assignRegisters (blockSymbols);
             assignStackOffsets (block);
             bool stackFrameNeeded = std::find_if (blockSymbols.begin (), blockSymbols.end (), [] (const TSymbol *s) {
                 return (s->checkSymbolFlag (TSymbol::Parameter) || s->checkSymbolFlag (TSymbol::Variable)) && s->getRegister () == TSymbol::InvalidRegister; }) != blockSymbols.end ();
-            codeBlock (block, stackFrameNeeded || block.isDisplayNeeded (), blockStatements);
+            code = codeBlock (block, stackFrameNeeded || block.isDisplayNeeded ());
 //            std::cout << "Leave function: " << block.getSymbol ()->getName () << std::endl;
 //            std::cout << "  RCX/RDX/REP MOVSB used = " << isRegUsed (TX64Reg::rcx) << ' ' << isRegUsed (TX64Reg::rdx) << ' ' << moveUsed << std::endl;
         }
     }
-    
-    trySingleReplacements (blockStatements);
-    std::move (blockStatements.begin (), blockStatements.end (), std::back_inserter (program));
+    routineCode.push_back (std::move (code));
     
     for (TSymbol *s: blockSymbols) 
         if (s->checkSymbolFlag (TSymbol::Routine)) {
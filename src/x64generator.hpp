@@ -8,6 +8,7 @@
 
 #include "codegenerator.hpp"
 #include "x64asm.hpp"
+#include "heapprofile.hpp"
 
 namespace statpascal {
 
@@ -17,6 +18,10 @@ public:
     TX64Generator (TRuntimeData &, bool codeRangeCheck = true, bool createCompilerListing = false);
     
     void getAssemblerCode (std::vector<std::uint8_t> &, bool generateListing, std::vector<std::string> &);
+    // code offsets of the routines after assembly
+    std::vector<THeapProfile::TRoutineLabel> getRoutineLabels () const;
+    // number of threads finishing the code of the routines, 0 uses all cores
+    void setCodegenThreads (std::size_t);
 
     virtual void generateCode (TTypeCast &) override;
     virtual void generateCode (TExpression &) override;
@@ -77,11 +82,8 @@ private:
     void assignParameterOffsets (ssize_t &pos, TBlock &, std::vector<TSymbol *> &registerParameters);
     void assignStackOffsets (TBlock &);    
     void assignRegisters (TSymbolList &);
-    void codeBlock (TBlock &block, bool hasStackFrame, TCodeSequence &blockStatements);
     void generateBlock (TBlock &);
     void externalRoutine (TSymbol &);
-    void beginRoutineBody (const std::string &routineName, std::size_t level, TSymbolList &, const std::set<TX64Reg> &saveRegs, bool hasStackFrame);
-    void endRoutineBody (std::size_t level, TSymbolList &, const std::set<TX64Reg> &saveRegs, bool hasStackFrame);
 
     void outputBooleanCheck (TExpressionBase *, const std::string &label, bool branchOnFalse = true);
     void outputBooleanShortcut (TToken operation, TExpressionBase *left, TExpressionBase *right);
@@ -140,6 +142,7 @@ private:
     
     std::size_t dblConstCount;
     std::unordered_map<std::string, std::size_t> labelDefinitions, relLabelDefinitions;
+    std::vector<std::string> routineNames;
     std::vector<TGlobalDefinition> globalDefinitions;
     std::vector<TConstantDefinition> constantDefinitions;
     std::vector<TSetDefinition> setDefinitions;
@@ -150,6 +153,46 @@ private:
         std::vector<std::string> jumpLabels;
     };
     std::vector<TJumpTable> jumpTableDefinitions;
+    
+    // The code of a routine is emitted serially as this registers constants, labels and any managers.
+    // Optimizing it and adding prologue and epilogue depends on the routine only and is done by
+    // worker threads; the results are appended to the program in routine order.
+    struct TRoutineCode {
+        std::string name;
+        std::size_t level, localSize;
+        bool hasStackFrame;
+        std::vector<std::string> symbolComments;
+        std::size_t zeroCount;			// managed locals to be cleared
+        std::string zeroStackLabel;
+        TCodeSequence parameterCode, blockCode, globalInits;
+        std::vector<TJumpTable> jumpTables;
+    };
+    std::vector<TRoutineCode> routineCode;
+    std::size_t codegenThreads;
+    
+    TRoutineCode codeBlock (TBlock &block, bool hasStackFrame);
+    void beginRoutineBody (TRoutineCode &, TSymbolList &);
+    void codeStackFrame (const TRoutineCode &, const std::set<TX64Reg> &saveRegs, TCodeSequence &);
+    void endRoutineBody (const TRoutineCode &, const std::set<TX64Reg> &saveRegs, TCodeSequence &);
+    void finishRoutine (TRoutineCode &, TCodeSequence &);
+    void finishRoutines ();
+    
+    // specialized copy and destroy routines for managed types, output after the program
+    enum class TAnyRoutineKind {Copy, Assign, Destroy};
+    struct TAnyRoutine {
+        std::string label;
+        TAnyRoutineKind kind;
+        std::size_t size;
+        TAnySlots slots;
+    };
+    std::vector<TAnyRoutine> anyRoutines;
+    std::map<std::pair<const TType *, TAnyRoutineKind>, std::string> anyRoutineLabels;
+    
+    std::string lookupAnyRoutine (const TType *, TAnyRoutineKind);
+    std::string createAnyRoutine (TAnyRoutineKind, std::size_t size, TAnySlots &&);
+    void outputAnyRoutines ();
+    void codeAnySlots (const TAnySlots &, TX64Reg base, bool retain, std::size_t counterOffset);
+    void codeAnySlot (const TX64Operand &slot, bool retain, std::size_t counterOffset);
 
     void setOutput (TCodeSequence *);
     void outputCode (const TX64Operation &);
@@ -158,7 +201,7 @@ private:
     void outputGlobal (const std::string &name, std::size_t size);
     void outputComment (const std::string &);
     
-    void outputLocalJumpTables ();
+    void outputLocalJumpTables (const std::vector<TJumpTable> &, TCodeSequence &);
     void outputGlobalConstants ();
     
     std::string registerConstant (double);
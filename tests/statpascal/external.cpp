@@ -61,6 +61,14 @@ void setstring (statpascal::TAnyValue *p) {
     *p = statpascal::TAnyValue (std::move (s));
 }
 
+void printstringvector (statpascal::TAnyValue p) {
+    if (p.hasValue ()) {
+        const statpascal::TVectorData &v = p.get<statpascal::TVectorData> ();
+        for (std::size_t i = 0; i < v.getElementCount (); ++i)
+            std::cout << v.get<statpascal::TAnyValue> (i).getString () << ' ';
+    }
+}
+
 void modifystring (statpascal::TAnyValue *p) {
     if (p->hasValue ()) {
         p->copyOnWrite ();
@@ -80,6 +80,17 @@ function random (n: int64): int64; external name 'rt_int_random';
 procedure getmem (var p: pointer; n: int64); external name 'rt_dyn_alloc';
 procedure freemem (p: pointer; n: int64); external name 'rt_dyn_free';
 
+(* Arenas: new (p, arena) allocates from an arena; release frees everything
+   allocated after the mark, or the whole arena for a mark of nil *)
+
+type
+    TArena = pointer;
+
+function createarena: TArena; external name 'rt_arena_create';
+procedure freearena (a: TArena);
+procedure mark (a: TArena; var p: pointer); external name 'rt_arena_mark';
+procedure release (a: TArena; p: pointer);
+
 procedure fillchar (var x; count: int64; value: uint8); external name 'rt_fillchar';
 procedure fillchar (var x; count: int64; value: boolean); external name 'rt_fillchar';
 procedure fillchar (var x; count: int64; value: char); external name 'rt_fillchar';
@@ -152,9 +163,26 @@ function __vec_greater_equal (a, b: __generic_vector; tca, tcb: int64): __generi
 function __vec_less (a, b: __generic_vector; tca, tcb: int64): __generic_vector; external name 'rt_vec_less';
 function __vec_greater (a, b: __generic_vector; tca, tcb: int64): __generic_vector; external name 'rt_vec_greater';
 
+function __vec_equal_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_equal_first';
+function __vec_not_equal_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_not_equal_first';
+function __vec_less_equal_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_less_equal_first';
+function __vec_greater_equal_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_greater_equal_first';
+function __vec_less_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_less_first';
+function __vec_greater_first (a, b: __generic_vector; tca, tcb: int64; value: boolean): int64; external name 'rt_vec_greater_first';
+function __vbool_first (a: boolvector; value: boolean): int64; external name 'rt_vbool_first';
+
+function __vec_equal_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_equal_which';
+function __vec_not_equal_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_not_equal_which';
+function __vec_less_equal_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_less_equal_which';
+function __vec_greater_equal_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_greater_equal_which';
+function __vec_less_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_less_which';
+function __vec_greater_which (a, b: __generic_vector; tca, tcb: int64): int64vector; external name 'rt_vec_greater_which';
+function __vbool_which (a: boolvector): int64vector; external name 'rt_vbool_which';
+
 function __vec_conv (a: __generic_vector; tcs, tcd: int64): __generic_vector; external name 'rt_vec_conv';
 
 function __vec_index_int (a: __generic_vector; index: int64): pointer; external name 'rt_vec_index_int';
+function __vec_element_str (a: __generic_vector; index: int64): string; external name 'rt_vec_element_str';
 function __vec_index_vint (a, index: __generic_vector): __generic_vector; external name 'rt_vec_index_vint';
 function __vec_index_vbool (a, index: __generic_vector): __generic_vector; external name 'rt_vec_index_vbool';
 
@@ -202,6 +230,7 @@ procedure __close (var f; runtimeData: pointer); external name 'rt_close';
 
 procedure __new (var p: pointer; count, size, anymanagerindex: int64; runtimeData: pointer); external name 'rt_alloc_mem';
 procedure __dispose (p: pointer; runtimeData: pointer); external name 'rt_free_mem';
+procedure __new_arena (var p: pointer; count, size, anymanagerindex: int64; runtimeData: pointer; arena: TArena); external name 'rt_alloc_arena';
 
 procedure __exit (status: int32); external name 'exit';
 
@@ -231,8 +260,8 @@ function __read_string (var f: text; runtimeData: pointer): string; external nam
 function __read_dbl (var f: text; runtimeData: pointer): real; external name 'rt_read_dbl';
 
 procedure __write_vint64 (var f: text; n: int64vector; length, precision: int64; runtimeData: pointer); external name 'rt_write_vint';
-procedure __write_vchar (var f: text; ch: charvector; length, precision: int64); external name 'rt_write_vchar';
-procedure __write_vstring (var f: text; s: stringvector; length, precision: int64); external name 'rt_write_vstring';
+procedure __write_vchar (var f: text; ch: charvector; length, precision: int64; runtimeData: pointer); external name 'rt_write_vchar';
+procedure __write_vstring (var f: text; s: stringvector; length, precision: int64; runtimeData: pointer); external name 'rt_write_vstring';
 procedure __write_vboolean (var f: text; b: boolvector; length, precision: int64; runtimeData: pointer); external name 'rt_write_vbool';
 procedure __write_vdbl (var f: text; a: realvector; length, precision: int64; runtimeData: pointer); external name 'rt_write_vdbl';
 
@@ -267,6 +296,7 @@ function __str_greater (s, t: string): boolean; external name 'rt_str_greater';
 
 function __str_make (index: int64; runtimeData: pointer): string; external  name 'rt_str_make';
 function __str_concat (a, b: string): string; external  name 'rt_str_concat';
+procedure __str_append (var s: string; t: string); external name 'rt_str_append';
 function __str_char (a: char): string; external name 'rt_str_char';
 function __str_index (s: string; index: int64): pointer; external  name 'rt_str_index';
 
@@ -276,6 +306,9 @@ function __alloc_mem (count, size, anyManagerIndex: int64; runtimeData: pointer)
 procedure __free_mem (p, runtimeData: pointer); external name 'rt_free_mem';
 procedure __init_mem (p: pointer; anyManagerIndex: int64; runtimeData: pointer); external name 'rt_init_mem';
 procedure __destroy_mem (p: pointer; anyManagerIndex: int64; runtimeData: pointer); external name 'rt_destroy_mem';
+procedure __any_retain (p: pointer); external name 'rt_any_retain';
+procedure __any_release (p: pointer); external name 'rt_any_release';
+procedure __any_delete (p: pointer); external name 'rt_any_delete';
 
 (* String handling *)
 
@@ -286,6 +319,13 @@ function copy (s: string; pos, length: int64): string; external  name 'rt_str_co
 procedure delete (var s: string; pos, length: int64); external name 'rt_str_delete';
 function stringofchar (ch: char; count: int64): string; external  name 'rt_str_of_char';
 
+function length (s: stringvector): int64vector; external name 'rt_vstr_length';
+function upcase (s: stringvector): stringvector; external name 'rt_vstr_upcase';
+function pos (needle: string; haystack: stringvector): int64vector; external name 'rt_vstr_pos';
+function copy (s: stringvector; pos, length: int64): stringvector; external name 'rt_vstr_copy';
+function paste (s: stringvector; sep: string): string; external name 'rt_vstr_paste';
+function split (s, sep: string): stringvector; external name 'rt_str_split';
+
 (* Command line parameters *)
 
 function ParamCount: int64;
@@ -295,6 +335,8 @@ implementation
 
 function __argc (runtimeData: pointer): int64; external name 'rt_argc';
 procedure __argv (n: int64; runtimeData: pointer; var s: string); external name 'rt_argv';
+procedure __arena_free (a: TArena; runtimeData: pointer); external name 'rt_arena_free';
+procedure __arena_release (a: TArena; p: pointer; runtimeData: pointer); external name 'rt_arena_release';
 
 procedure __assign (var f; filename: string);
     begin
@@ -358,6 +400,16 @@ function ParamStr (n: int64): string;
         ParamStr := s
     end;
     
+procedure freearena (a: TArena);
+    begin
+        __arena_free (a, __GlobalRuntimeData)
+    end;
+
+procedure release (a: TArena; p: pointer);
+    begin
+        __arena_release (a, p, __GlobalRuntimeData)
+    end;
+    
 procedure halt;
     begin
         __exit (0)